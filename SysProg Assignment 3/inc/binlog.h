@@ -0,0 +1,104 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include "ipc_shared.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+
+//Binary event log for the headless server (decoded by logdump).
+//Every thread that logs gets its own byte ring; logging a record is a
+//clock read and a memcpy into that ring, with no lock and no system call.
+//A flusher thread per process drains every ring with one writev() once
+//BINLOG_CHUNK bytes are waiting or BINLOG_FLUSH_MS has passed, so the file
+//grows in large sequential appends. A thread whose ring fills up faster
+//than the flusher empties it drains the rings itself. Records are only
+//lost when a write fails; they are counted in the next BINLOG_DROPPED
+//record.
+//File: BinlogFileHeader, then records of 8-byte-aligned length starting
+//with a BinlogHeader. Workers append whole chunks to the same file
+//(O_APPEND, one flusher at a time under flock()), so records of different
+//workers interleave in chunks; a chunk whose write fails is cut back out.
+#define BINLOG_FILE "server.binlog"
+#define BINLOG_MAGIC 0x474f4c42             //"BLOG"
+#define BINLOG_VERSION 1
+#define BINLOG_RING_BYTES (4u << 20)        //Per logging thread, power of two
+#define BINLOG_CHUNK (256u << 10)           //Bytes that trigger a write
+#define BINLOG_FLUSH_MS 100                 //Longest a record waits
+#define BINLOG_MAIN 0xff                    //Worker id of the main process
+#define BINLOG_TEXT_MAX 200
+
+//Record types
+#define BINLOG_BOOKING   1
+#define BINLOG_BATCH     2
+#define BINLOG_CONNECT   3
+#define BINLOG_CLOSE     4
+#define BINLOG_TEXT      5
+#define BINLOG_DROPPED   6
+
+//File header (16 bytes)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t createdAt;             //time() when the file was started
+} BinlogFileHeader;
+
+//Record header (16 bytes)
+typedef struct {
+    uint16_t length;                //Record bytes, header included
+    uint8_t type;
+    uint8_t worker;                 //Worker id or BINLOG_MAIN
+    uint32_t reserved;
+    uint64_t timeNs;                //CLOCK_REALTIME
+} BinlogHeader;
+
+//Accepted booking (destination is destLength bytes, not terminated)
+typedef struct {
+    BinlogHeader hdr;
+    int32_t clientId;
+    int32_t numPeople;
+    int64_t priceCents;
+    uint8_t destLength;
+    char destination[MAX_NAME - 1];
+} BinlogBooking;
+
+//FRAME_BATCH result
+typedef struct {
+    BinlogHeader hdr;
+    int32_t clientId;
+    uint16_t count, accepted, rejected, reserved;
+    int64_t cents;
+} BinlogBatch;
+
+//Connection accepted (addr in network byte order) / closed
+typedef struct {
+    BinlogHeader hdr;
+    int32_t clientId;
+    uint32_t addr;
+} BinlogConnection;
+
+//Free-form message (text is hdr.length - sizeof(BinlogHeader) bytes,
+//padded with NULs) / records lost to full rings
+typedef struct {
+    BinlogHeader hdr;
+    char text[BINLOG_TEXT_MAX];
+} BinlogText;
+
+typedef struct {
+    BinlogHeader hdr;
+    uint64_t records;
+} BinlogDropped;
+
+//Lifetime
+int binlog_open(const char *path);
+int binlog_start(int worker);
+void binlog_stop(void);
+void binlog_flush(void);
+void binlog_close(void);
+
+//Records (hot path)
+void binlog_booking(const ClientMessage *msg);
+void binlog_batch(int clientId, int count, int accepted, int rejected, int64_t cents);
+void binlog_connection(int type, int clientId, uint32_t addr);
+void binlog_text(const char *fmt, va_list args);
+
+#endif //BINLOG_H
@@ -0,0 +1,171 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "ipc_shared.h"
+#include "histogram.h"
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+//Catalog segment (POSIX shared memory, grows online):
+//  CatalogHeader | padding | Trip[capacity] | uint32_t index[indexSlots] |
+//  int32_t prices[capacity] | uint64_t active[capacity/64] |
+//  uint32_t names[capacity] | uint32_t byName[capacity] |
+//  uint32_t byPrice[capacity] | uint32_t live[capacity] |
+//  uint32_t links[capacity]
+//The index is an open-addressing (linear probing) hash table from
+//destination to trip slot + 1 (0 = empty), at most half full.
+//prices (cents, capped at INT32_MAX), active (one bit per slot) and
+//names (segment offset of each destination string) repeat the Trip
+//fields column by column so price scans touch only the bytes they need
+//(see scan.h).
+//byName and byPrice list the active slots sorted by destination and by
+//price (then slot); search.c answers prefix, range and top-K queries
+//from them with binary search.
+//live lists the active slots densely (in no particular order) so readers
+//walk only live trips. links is intrusive per slot: for a live slot it is
+//its position in live, for a free slot the next free slot + 1, so insert
+//and delete find or free a slot in O(1) and deleted slots are reused
+//first. The edit as a whole is still O(n): catalog_write_end merges the
+//changed slots into byName and byPrice, moving up to every entry of both
+//orders once per write section, and that dominates the cost of an edit.
+//Seat inventory lives in each Trip record (the Trip array never moves
+//inside the segment) and is changed with compare-and-swap outside the
+//writer lock; see catalog_reserve.
+//Records are addressed by offsets from the start of the segment so every
+//process can map it at a different address. When a writer grows the
+//segment it bumps generation and size; attached processes notice on
+//their next read and remap.
+//A bulk import builds a whole new segment under CATALOG_STAGING_NAME and
+//publishes it by renaming it over the live name, then marks the old
+//segment retired and bumps its generation: readers finish with the old
+//catalog and reopen the new one by name on their next read (RCU-style;
+//the old segment is freed when its last mapping goes).
+//The header also keeps histograms of how long writers waited for the
+//lock and held it. They are only updated by the lock holder, so they need
+//no lock of their own, and any process can read them (server metrics).
+#define CATALOG_SHM_NAME "/sysprog_catalog"
+#define CATALOG_STAGING_NAME "/sysprog_catalog.staging"   //Bulk imports build here
+#define CATALOG_MAGIC 0x54524950        //"TRIP"
+#define CATALOG_LAYOUT 9                //Bumped when the segment layout changes
+#define CATALOG_INITIAL_CAPACITY 16     //Trip slots in a new catalog
+
+//Catalog file: CatalogFileHeader followed by a byte copy of the segment.
+//Written by shm_manager after each edit so the catalog survives reboots
+//and the rogue write; restoring it is a checksum check and a memcpy.
+#define CATALOG_FILE "trips.catalog"
+#define CATALOG_FILE_MAGIC 0x43544143   //"CATC"
+
+//Segment header
+typedef struct {
+    uint32_t magic;
+    uint32_t layout;
+    pthread_rwlock_t lock;              //Process-shared, taken by writers only
+    _Atomic unsigned int seq;           //Odd while a write is in progress
+    _Atomic unsigned int generation;    //Bumped whenever the segment is resized
+    _Atomic uint64_t size;              //Segment bytes
+    _Atomic unsigned int retired;       //Replaced by a newer published catalog
+    uint32_t capacity;                  //Trip slots allocated
+    uint32_t tripCount;                 //Slots in use
+    uint64_t tripsOffset;               //Byte offset of the Trip array
+    uint64_t indexOffset;               //Byte offset of the destination index
+    uint32_t indexSlots;                //Power of two, >= 2 * capacity
+    uint64_t pricesOffset;              //Column of prices in cents
+    uint64_t activeOffset;              //Active bitmap
+    uint64_t namesOffset;               //Column of destination offsets
+    uint64_t byNameOffset;              //Active slots sorted by destination
+    uint64_t byPriceOffset;             //Active slots sorted by price
+    uint32_t sortedCount;               //Entries in byName and byPrice
+    uint64_t liveOffset;                //Dense list of active slots
+    uint64_t linksOffset;               //Live position / next free, per slot
+    uint32_t liveCount;                 //Entries in live
+    uint32_t freeHead;                  //First free slot + 1 (0 = none)
+    Histogram lockWait;                 //catalog_write_lock until acquired, ns
+    Histogram lockHold;                 //Acquired until catalog_unlock, ns
+} CatalogHeader;
+
+//Catalog file header (64 bytes, so the image stays cache-line aligned)
+typedef struct {
+    uint32_t magic;
+    uint32_t layout;                    //CATALOG_LAYOUT of the image
+    uint64_t imageSize;                 //Bytes of segment image that follow
+    uint64_t checksum;                  //image_checksum() of the image
+    uint64_t savedAt;                   //time() of the save
+    uint8_t reserved[32];
+} CatalogFileHeader;
+
+//Column view of the catalog, valid inside one lock-free read
+typedef struct {
+    const int32_t *prices;
+    const uint64_t *active;
+    const uint32_t *names;
+    const uint32_t *byName;
+    const uint32_t *byPrice;
+    const uint32_t *live;
+    uint32_t count;         //Slots in use
+    uint32_t sortedCount;   //Entries in byName and byPrice
+    uint32_t liveCount;     //Entries in live
+} CatalogColumns;
+
+//A trip copied out of the catalog with its 0-based slot
+typedef struct {
+    uint32_t slot;
+    Trip trip;
+} TripMatch;
+
+//One process's attachment to the catalog
+typedef struct {
+    int fd;
+    CatalogHeader *hdr;     //Start of the local mapping
+    const char *name;       //shm_open name, reopened after a publish
+    size_t mapSize;         //Bytes mapped locally
+    unsigned int generation;  //Generation of the local mapping
+    int rebuild;            //Sorted orders must be rebuilt from scratch
+    uint32_t *pending;      //Slots changed in the current write section
+    uint32_t pendingCount, pendingCap;
+    uint64_t lockedAt;      //monotonic_ns() the writer lock was taken, 0 = not held
+} Catalog;
+
+//Lifetime
+int catalog_create(Catalog *cat, const char *name, uint32_t capacity);
+int catalog_open(Catalog *cat, const char *name);
+void catalog_close(Catalog *cat);
+int catalog_remove(const char *name);
+int catalog_refresh(Catalog *cat);
+int catalog_save(Catalog *cat, const char *path);
+int catalog_restore(Catalog *cat, const char *name, const char *path);
+
+//Lock primitives
+void catalog_read_lock(Catalog *cat);
+void catalog_write_lock(Catalog *cat);
+void catalog_unlock(Catalog *cat);
+
+//Writers (serialized by the lock; the sequence is odd in between)
+unsigned int catalog_write_begin(Catalog *cat);
+void catalog_write_end(Catalog *cat);
+int catalog_grow(Catalog *cat, uint32_t capacity);
+int catalog_insert(Catalog *cat, const Trip *trip, unsigned int version);
+int catalog_lookup(Catalog *cat, const char *destination);
+int catalog_publish(Catalog *staged, const char *stagingName, const char *name);
+int catalog_update(Catalog *cat, uint32_t slot, const Trip *trip, unsigned int version);
+int catalog_delete(Catalog *cat, uint32_t slot, unsigned int version);
+
+//Seat reservation results
+#define RESERVE_OK       1      //Seats taken
+#define RESERVE_SOLD_OUT 0      //Not enough seats left
+#define RESERVE_CHANGED -1      //Trip changed since it was read
+
+//Lock-free readers
+unsigned int catalog_read_begin(Catalog *cat);
+int catalog_read_retry(Catalog *cat, unsigned int seq);
+Trip *catalog_records(Catalog *cat, uint32_t count);
+unsigned int catalog_snapshot(Catalog *cat, TripMatch **trips, uint32_t *bufCap, uint32_t *count);
+int catalog_get_trip(Catalog *cat, uint32_t slot, Trip *trip);
+int catalog_find_trip(Catalog *cat, const char *destination, Trip *trip);
+int catalog_columns(Catalog *cat, CatalogColumns *cols);
+int catalog_reserve(Catalog *cat, uint32_t slot, unsigned int version, int seats, int *left);
+void catalog_release(Catalog *cat, uint32_t slot, unsigned int version, int seats);
+uint32_t catalog_under_budget(Catalog *cat, int32_t budgetCents, uint32_t *slots, uint32_t max);
+uint32_t catalog_price_range(Catalog *cat, int32_t *minCents, int32_t *maxCents);
+
+#endif //CATALOG_H
@@ -0,0 +1,58 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "ipc_shared.h"
+#include "journal.h"
+
+//Checkpoint file: CheckpointHeader followed by destCount
+//DestinationTotals. It summarizes the first journalOffset bytes of the
+//booking journal, so a restart maps it and replays only the journal
+//records after that offset. Written to a temporary file and renamed, so
+//a crash leaves either the old checkpoint or the new one.
+#define CHECKPOINT_FILE "bookings.checkpoint"
+#define CHECKPOINT_MAGIC 0x54504b43             //"CKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_DEFAULT_INTERVAL 10          //Seconds, override with --checkpoint
+
+//Server totals as of journalOffset (64 bytes)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t journalOffset;         //Journal bytes folded in
+    uint64_t lastBookingNumber;     //Highest booking number seen
+    uint64_t recordCount;           //Bookings
+    int64_t totalCents;             //Revenue
+    uint32_t destCount;             //DestinationTotals that follow
+    uint32_t reserved;
+    uint64_t savedAt;               //time() of the save
+    uint64_t checksum;              //Of the header up to here and the totals
+} CheckpointHeader;
+
+//Bookings of one destination
+typedef struct {
+    char destination[MAX_NAME];
+    uint8_t reserved[6];
+    int64_t bookings;
+    int64_t people;
+    int64_t cents;
+} DestinationTotal;
+
+//Totals being rebuilt or kept up to date from the journal
+typedef struct {
+    CheckpointHeader hdr;
+    DestinationTotal *dests;        //hdr.destCount in use
+    uint32_t destCap;
+    uint32_t *index;                //Hash of destination -> dests slot + 1
+    uint32_t indexSlots;            //Power of two, >= 2 * destCap
+} BookingTotals;
+
+void totals_init(BookingTotals *t);
+void totals_free(BookingTotals *t);
+int totals_add(BookingTotals *t, const JournalRecord *rec);
+int totals_merge(BookingTotals *t, const char *destination,
+                 int64_t bookings, int64_t people, int64_t cents);
+int checkpoint_load(BookingTotals *t, const char *path);
+int checkpoint_save(const BookingTotals *t, const char *path);
+long journal_replay(BookingTotals *t, const char *path, int truncate);
+
+#endif //CHECKPOINT_H
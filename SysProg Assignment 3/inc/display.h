@@ -0,0 +1,59 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "ipc_shared.h"
+#include <ncurses.h>
+#include <stdatomic.h>
+
+//[NCURSES] Server windows
+extern WINDOW *display_win;
+extern WINDOW *input_win;
+
+//Render thread: while it runs, the event loop never touches the terminal.
+//Bookings and messages are posted as DisplayEvents to a bounded
+//lock-free queue (a slot is claimed with compare-and-swap and published
+//through its sequence number); the thread drains it DISPLAY_FPS times a
+//second, draws at most DISPLAY_FRAME_LINES of the newest lines, sums up
+//the ones it skipped in a single line after them and refreshes the
+//screen once. A post that finds the queue full is dropped and counted,
+//so a slow terminal never blocks recv(). Before display_start and after
+//display_stop the display_* calls draw directly.
+//Headless (--headless) there is no terminal at all: the same calls log
+//binary records through binlog.h and display_start starts its flusher.
+#define DISPLAY_FPS 20
+#define DISPLAY_QUEUE 1024                      //Events between frames, power of two
+#define DISPLAY_FRAME_LINES (DISPLAY_HEIGHT - 2)
+#define DISPLAY_TEXT_MAX 160
+
+//Queued display events
+#define DISPLAY_EVENT_BOOKING 1     //display_client() line
+#define DISPLAY_EVENT_TEXT    2     //Message for display_win
+#define DISPLAY_EVENT_INPUT   3     //Message for input_win (never skipped)
+
+typedef struct {
+    _Atomic uint64_t seq;           //Queue position this slot is ready for
+    int type;
+    union {
+        ClientMessage booking;
+        char text[DISPLAY_TEXT_MAX];
+    };
+} DisplayEvent;
+
+void display_init(void);
+int display_init_headless(const char *logPath);
+void display_end(void);
+void display_create_windows(void);
+void display_client(const ClientMessage *msg);
+
+//Asynchronous rendering
+int display_start(int worker);
+void display_stop(void);
+void display_post_client(const ClientMessage *msg);
+void display_connected(int worker, int clientNum, struct in_addr addr);
+void display_closed(int clientNum);
+void display_batch(int clientNum, int count, int accepted, int rejected, int64_t cents);
+void display_printf(WINDOW *win, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void display_refresh(void);
+
+#endif //DISPLAY_H
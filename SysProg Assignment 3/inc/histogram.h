@@ -0,0 +1,33 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "ipc_shared.h"
+#include <stdatomic.h>
+
+//Latency histogram with HDR-style log-linear buckets: every power of two
+//is split into HIST_SUB equal sub-buckets, so any value is kept within
+//1/HIST_SUB (6.25%) of itself from 1 ns up to 2^HIST_MAX_BITS ns
+//(about 18 minutes; larger values go in the last bucket). A histogram is
+//a fixed array of counters and can live in shared memory.
+//Each histogram has one writer at a time (a thread, or whoever holds the
+//lock it measures); hist_record is then a few plain loads and stores, no
+//locked instruction. Readers (hist_merge) may run concurrently and see
+//each counter either before or after an update.
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    _Atomic uint64_t count;             //Values recorded
+    _Atomic uint64_t sum;               //Of the values, ns
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+void hist_record(Histogram *h, uint64_t value, uint64_t n);
+void hist_merge(Histogram *into, const Histogram *from);
+uint64_t hist_count_below(const Histogram *h, uint64_t limit);
+uint64_t hist_quantile(const Histogram *h, double q);
+
+#endif //HISTOGRAM_H
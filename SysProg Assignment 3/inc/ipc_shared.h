@@ -3,11 +3,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/sem.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -15,42 +14,40 @@
 #include <errno.h>
 #include <ctype.h>
 #include <sys/wait.h>
+#include <pthread.h>
 
 //Constants
 #define MAX_NAME 50
 #define MAX_AGE 150
 #define MIN_AGE 1
 #define MIN_PEOPLE 1
+#define MAX_PEOPLE 65535        //Party size travels as a u16 (protocol.h)
 #define MIN_TRIP 1
-#define MAX_TRIPS 10
 #define MAX_FULLNAME (MAX_NAME*2)
 #define MAX_ADDRESS 100
-#define SHM_KEY 0x1234
-#define SEM_KEY 0x5678
 #define PERMISSIONS 0666
 
 //Socket constants
 #define SERVER_PORT 8888
-#define MAX_CLIENTS 5
-#define BACKLOG 5
+#define DEFAULT_MAX_CLIENTS 4096   //Runtime limit, override with --max-clients
+#define DEFAULT_BACKLOG 1024       //Runtime limit, override with --backlog
+#define MAX_EVENTS 256             //epoll events handled per wakeup
+#define MAX_WORKERS 64             //Upper bound for --workers
 
 //Control signals
 #define SIGNAL_F1 1  //Exit
 #define SIGNAL_F2 2  //Show total
 
-//Trip structure for shared memory
+//Trip record stored in the catalog segment (see catalog.h)
 typedef struct {
     char destination[MAX_NAME];
-    float price;
+    int64_t priceCents;     //Price per person, in cents
     int active; //1 if trip is available, 0 if slot is empty
+    unsigned int version;   //Catalog sequence that last changed this trip
+    int seats;              //Seats per departure, 0 = unlimited
+    uint64_t inventory;     //version << 32 | seats left; reserved with CAS
 } Trip;
 
-//Shared memory structure
-typedef struct {
-    int tripCount;
-    Trip trips[MAX_TRIPS];
-} SharedMemory;
-
 //NCURSES window dimensions
 #define DISPLAY_HEIGHT 18
 #define INPUT_HEIGHT 6
@@ -58,29 +55,30 @@ typedef struct {
 //Client message structure for socket communication
 typedef struct {
     int clientId;           //Client identifier
+    unsigned int requestId; //Client-chosen id echoed in the server's ack
     char firstName[MAX_NAME];
     char lastName[MAX_NAME];
     int age;
     char address[MAX_ADDRESS];
     char destination[MAX_NAME];
+    int tripId;             //Catalog slot (1-based) quoted, 0 = by destination
+    unsigned int catalogVersion;  //Sequence of the quoted snapshot, 0 = none
     int numPeople;
-    float tripPrice;
+    int64_t priceCents;     //Total for all people, in cents
     int signal;             //Control signal (F1/F2)
 } ClientMessage;
 
-//Semaphore union for semctl
-union semun {
-    int val;
-    struct semid_ds *buf;
-    unsigned short *array;
-};
-
-//Semaphore operations
-void sem_lock(int semid);
-void sem_unlock(int semid);
-int create_semaphore(key_t key);
-int get_semaphore(key_t key);
-void remove_semaphore(int semid);
+//Client screen
 void reset_input_window(void);
 
+//Bulk input
+int parse_booking_csv(char *line, ClientMessage *msg);
+int parse_trip_csv(char *line, Trip *trip);
+int parse_cents(const char *text, int64_t *cents);
+int booking_total(int64_t unitCents, int numPeople, int64_t *total);
+int connect_server(const char *ip, int port);
+
+//Timing
+uint64_t monotonic_ns(void);
+
 #endif //IPC_SHARED_H
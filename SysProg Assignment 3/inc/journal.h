@@ -0,0 +1,64 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "ipc_shared.h"
+#include <stdatomic.h>
+
+//Booking journal: an append-only file of fixed-size JournalRecords, one
+//per accepted booking, in the order they were accounted. Every worker
+//appends to the same file (O_APPEND) from its own I/O thread.
+//Group commit: records are collected in memory and written + fdatasync'd
+//together once maxBatch records are waiting or the oldest has
+//waited maxDelayUs, whichever comes first. A larger delay or batch means
+//fewer syncs (throughput); a smaller one means acks wait less (latency).
+//Only records that were written and synced count as durable. A commit
+//that fails is cut back out of the file and retried; the acks waiting on
+//it (and on everything queued after it) are held until it succeeds.
+//Commits from different workers are serialized with flock() so cutting
+//back never touches another worker's records.
+#define JOURNAL_FILE "bookings.journal"
+#define JOURNAL_MAGIC 0x324e524a            //"JRN2" (64-bit prices)
+#define JOURNAL_DEFAULT_DELAY_US 2000       //Override with --commit-delay
+#define JOURNAL_DEFAULT_BATCH 256           //Override with --commit-batch
+#define JOURNAL_RETRY_MS 100                //Wait before retrying a failed commit
+
+//One accepted booking (96 bytes, host byte order)
+typedef struct {
+    uint32_t magic;
+    int32_t numPeople;
+    uint64_t bookingNumber;
+    uint64_t timeNs;                //CLOCK_REALTIME when it was accounted
+    int64_t priceCents;             //Total for all people
+    int32_t clientId;
+    char destination[MAX_NAME];
+    uint8_t reserved[6];
+    uint32_t checksum;              //journal_checksum() of the bytes above
+} JournalRecord;
+
+//One process's journal writer
+typedef struct {
+    int fd;
+    int eventFd;                    //Readable after every commit
+    pthread_t thread;               //I/O thread: writes and syncs
+    pthread_mutex_t lock;           //Guards fill*, appended and stop
+    pthread_cond_t wake;
+    JournalRecord *fill;            //Records waiting for the next commit
+    uint32_t fillCount, fillCap;
+    uint64_t fillSince;             //monotonic_ns() of the oldest waiting record
+    uint64_t appended;              //Records handed to journal_append
+    _Atomic uint64_t durable;       //Records written and synced
+    _Atomic uint64_t commits;       //fdatasync calls
+    _Atomic int error;              //errno of the last commit, 0 once one succeeds
+    long maxDelayUs;
+    uint32_t maxBatch;
+    int stop;
+} Journal;
+
+int journal_open(Journal *j, const char *path, long maxDelayUs, uint32_t maxBatch);
+uint64_t journal_append(Journal *j, const JournalRecord *rec);
+uint64_t journal_append_batch(Journal *j, JournalRecord *recs, uint32_t n);
+uint64_t journal_durable(Journal *j);
+void journal_close(Journal *j);
+uint32_t journal_checksum(const JournalRecord *rec);
+
+#endif //JOURNAL_H
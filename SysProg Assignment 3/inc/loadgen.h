@@ -0,0 +1,24 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include "ipc_shared.h"
+
+//Load generator defaults
+#define LOAD_DEFAULT_CONNS 8
+#define LOAD_DEFAULT_COUNT 100000
+#define LOAD_DEFAULT_WINDOW 64     //Frames in flight per connection
+
+//Load generator settings (client --load mode)
+typedef struct {
+    const char *serverIp;
+    const char *csvPath;    //Records to replay, NULL to generate them
+    int conns;              //Connections to open
+    long count;             //Bookings to send in total
+    long rate;              //Target bookings per second, 0 = unlimited
+    int batch;              //Records per frame, 1 = FRAME_BOOKING
+    int window;             //Max unacknowledged frames per connection
+} LoadConfig;
+
+int run_load(const LoadConfig *cfg);
+
+#endif //LOADGEN_H
@@ -0,0 +1,40 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "ipc_shared.h"
+#include "histogram.h"
+#include <stdatomic.h>
+
+//Local metrics endpoint: a thread in the main server process answers
+//HTTP GET /metrics on 127.0.0.1 with the Prometheus text format. Every
+//scrape calls the server's writer, which sums the counters and merges
+//the histograms that each worker keeps for itself (single writer, see
+//histogram.h), so the event loops never wait for a scrape.
+//Histograms are exported in seconds with a bucket per power of two
+//nanoseconds (le = 2^k - 1 ns, since le includes its bound), plus a
+//<name>_quantile gauge read at full HDR precision.
+#define METRICS_DEFAULT_PORT 9888           //Override with --metrics-port, 0 = off
+#define METRICS_MAX_TEXT (64 << 10)         //Bytes of one scrape
+
+//Prometheus text built for one scrape
+typedef struct {
+    char text[METRICS_MAX_TEXT];
+    size_t len;
+    int truncated;
+} MetricsText;
+
+typedef void (*MetricsWriter)(MetricsText *out);
+
+//Endpoint
+int metrics_start(int port, MetricsWriter writer);
+void metrics_stop(void);
+
+//Recording (owner of the counter only)
+void metrics_add(_Atomic uint64_t *counter, uint64_t n);
+
+//Exposition
+void metrics_family(MetricsText *out, const char *name, const char *type, const char *help);
+void metrics_value(MetricsText *out, const char *name, const char *labels, uint64_t value);
+void metrics_histogram(MetricsText *out, const char *name, const char *help, const Histogram *h);
+
+#endif //METRICS_H
@@ -0,0 +1,144 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "ipc_shared.h"
+#include <stdint.h>
+
+//Wire format (all integers big-endian):
+//  u32 length | u8 version | u8 type | payload[length]
+//Strings are sent as u8 length + bytes (no terminator) and prices as
+//u64 cents, so a booking costs ~60 bytes instead of sizeof(ClientMessage).
+#define PROTO_VERSION 6
+#define PROTO_HEADER_SIZE 6
+#define PROTO_MAX_FRAME 65536      //Largest frame accepted, header included
+#define PROTO_RECV_CHUNK 16384     //Minimum free space per recv() call
+#define PROTO_BUFFER_KEEP (2 * PROTO_RECV_CHUNK)   //Kept when empty; larger is freed
+
+//Frame types
+#define FRAME_BOOKING 1            //One ClientMessage record
+#define FRAME_SIGNAL  2            //u8 control signal (SIGNAL_F1/SIGNAL_F2)
+#define FRAME_BATCH   3            //u16 count + count booking records
+#define FRAME_BATCH_ACK 4          //Server reply to FRAME_BATCH
+#define FRAME_ACK     5            //Server reply to FRAME_BOOKING
+#define FRAME_STATS   6            //Server reply to SIGNAL_F2
+
+#define PROTO_MAX_BATCH 512        //Records per FRAME_BATCH
+#define STATS_WINDOWS 3            //Rolling windows in a FRAME_STATS (1, 5, 15 min)
+#define STATS_TOP 5                //Top destinations listed per window
+
+//Booking acknowledgement status
+#define ACK_OK      0              //Booking accepted and numbered
+#define ACK_INVALID 1              //Booking failed validation
+#define ACK_STALE   2              //Quoted price/version older than the catalog
+#define ACK_UNAVAILABLE 3          //Trip not in the catalog or no longer active
+#define ACK_SOLD_OUT 4             //Not enough seats left on the trip
+#define ACK_NOT_RECORDED 5         //Server could not journal it; nothing was booked
+
+//Largest encoded booking record, field by field in put_booking order:
+//requestId, firstName, lastName, age, address, destination, tripId,
+//catalogVersion, numPeople, priceCents. A string is a u8 length plus at
+//most max - 1 bytes.
+#define PROTO_STR_MAX(max) (1 + (max) - 1)
+#define PROTO_BOOKING_RECORD (4 + PROTO_STR_MAX(MAX_NAME) + PROTO_STR_MAX(MAX_NAME) + 1 + \
+                              PROTO_STR_MAX(MAX_ADDRESS) + PROTO_STR_MAX(MAX_NAME) + \
+                              4 + 4 + 2 + 8)
+
+//Largest encoded booking frame (every string at its maximum length)
+#define PROTO_MAX_BOOKING (PROTO_HEADER_SIZE + PROTO_BOOKING_RECORD)
+
+//Largest reply frames
+#define PROTO_MAX_ACK (PROTO_HEADER_SIZE + 4 + 1 + 8 + 8 + 4)
+#define PROTO_MAX_BATCH_ACK (PROTO_HEADER_SIZE + 2 + 2 + 8 + 8 + PROTO_MAX_BATCH * (4 + 1))
+#define PROTO_MAX_STATS (PROTO_HEADER_SIZE + 8 + 8 + 1 + STATS_WINDOWS * \
+                         (4 + 4 + 8 + 8 + 1 + STATS_TOP * (1 + (MAX_NAME - 1) + 8 + 8)))
+
+//Decoded frame header
+typedef struct {
+    uint32_t length;        //Payload bytes following the header
+    uint8_t version;
+    uint8_t type;
+} FrameHeader;
+
+//Server reply to one booking (ack or nack)
+typedef struct {
+    uint32_t requestId;     //Echo of ClientMessage.requestId
+    uint8_t status;         //ACK_OK or a rejection reason
+    uint64_t bookingNumber; //Server-assigned number, 0 when rejected
+    int64_t priceCents;     //Authoritative total price
+    int32_t seatsLeft;      //Seats left on the trip, -1 if not limited
+} BookingAck;
+
+//Server reply to one FRAME_BATCH. Accepted records are numbered
+//consecutively from firstBookingNumber in batch order; rejected records
+//are listed by request id with their status.
+typedef struct {
+    uint16_t accepted;      //Records accounted
+    uint16_t rejected;      //Records that failed validation
+    uint64_t totalCents;    //Revenue of the accepted records
+    uint64_t firstBookingNumber;
+} BatchAck;
+
+//Bookings of one destination inside a window (lower bounds, see rates.h)
+typedef struct {
+    char destination[MAX_NAME];
+    uint64_t bookings;
+    int64_t cents;
+} TopDestination;
+
+//Bookings accounted over the last `seconds`. coveredMs is the time the
+//window actually spans (shorter while the server is younger than the
+//window), so rates are bookings / coveredMs.
+typedef struct {
+    uint32_t seconds;       //Window length
+    uint32_t coveredMs;
+    uint64_t bookings;
+    int64_t cents;
+    uint8_t topCount;       //Entries in top, most bookings first
+    TopDestination top[STATS_TOP];
+} RateWindow;
+
+//Server reply to SIGNAL_F2: lifetime totals and the rolling windows
+typedef struct {
+    uint64_t bookings;      //Since the journal began
+    int64_t cents;
+    uint8_t windowCount;
+    RateWindow windows[STATS_WINDOWS];
+} StatsReport;
+
+//Per-connection receive/send buffer; frames are parsed in place
+typedef struct {
+    uint8_t *data;
+    size_t len;             //Bytes buffered
+    size_t cap;             //Bytes allocated
+} FrameBuffer;
+
+//Encoding
+int proto_encode_booking(const ClientMessage *msg, uint8_t *buf, size_t cap);
+int proto_encode_signal(int signal, uint8_t *buf, size_t cap);
+int proto_encode_batch(const ClientMessage *msgs, int count, uint8_t *buf, size_t cap,
+                       int *encoded);
+int proto_encode_batch_ack(const BatchAck *ack, const BookingAck *rejects,
+                           uint8_t *buf, size_t cap);
+int proto_encode_ack(const BookingAck *ack, uint8_t *buf, size_t cap);
+int proto_encode_stats(const StatsReport *report, uint8_t *buf, size_t cap);
+
+//Decoding
+int proto_parse_header(const uint8_t *buf, size_t len, FrameHeader *hdr);
+int proto_decode_booking(const uint8_t *payload, size_t len, ClientMessage *msg);
+int proto_decode_batch(const uint8_t *payload, size_t len, ClientMessage *msgs, int max);
+int proto_decode_batch_ack(const uint8_t *payload, size_t len, BatchAck *ack,
+                           BookingAck *rejects, int max);
+int proto_decode_ack(const uint8_t *payload, size_t len, BookingAck *ack);
+int proto_decode_stats(const uint8_t *payload, size_t len, StatsReport *report);
+
+const char *proto_status_text(int status);
+
+//Buffered I/O
+ssize_t proto_buffer_fill(FrameBuffer *fb, int fd);
+void proto_buffer_consume(FrameBuffer *fb, size_t used);
+int proto_buffer_append(FrameBuffer *fb, const uint8_t *data, size_t len);
+int proto_buffer_flush(FrameBuffer *fb, int fd);
+void proto_buffer_free(FrameBuffer *fb);
+int proto_send_all(int fd, const uint8_t *buf, size_t len);
+
+#endif //PROTOCOL_H
@@ -0,0 +1,63 @@
+#ifndef RATES_H
+#define RATES_H
+
+#include "ipc_shared.h"
+#include "protocol.h"
+#include <stdatomic.h>
+
+//Rolling booking windows: every worker keeps a ring of time buckets
+//(RATE_BUCKET_SECONDS each, 15 minutes of them) in a shared mapping
+//created before fork. A booking only touches the bucket for the current
+//time, which the worker resets when it first lands in it again, so an
+//update is O(1) and no bucket is ever shifted or scanned on the hot path.
+//Each bucket counts bookings and revenue and keeps RATE_TOP_SLOTS
+//destination counters (space-saving: when a bucket sees more
+//destinations than slots, the smallest counter is handed to the new
+//destination; the count it inherits is kept as its error, so
+//bookings - error is a guaranteed lower bound that reports rank by).
+//A query sums the buckets younger than each window across every ring.
+//Only the owning worker writes a ring; readers copy a bucket under its
+//sequence counter (odd while it is being written) and retry on a change.
+#define RATE_BUCKET_SECONDS 5
+#define RATE_WINDOW_BUCKETS (900 / RATE_BUCKET_SECONDS)   //Longest window
+#define RATE_BUCKETS (RATE_WINDOW_BUCKETS + 1)            //+ the bucket being filled
+#define RATE_TOP_SLOTS 32                                 //Destination counters per bucket
+
+//Destination counter (80 bytes)
+typedef struct {
+    uint32_t hash;                  //Of destination, checked before the name
+    char destination[MAX_NAME];
+    uint8_t reserved[2];
+    uint64_t bookings;              //Including the inherited error
+    uint64_t error;                 //Bookings inherited from an evicted destination
+    int64_t cents;                  //Revenue counted for this destination only
+} RateCounter;
+
+//Bookings accounted during one RATE_BUCKET_SECONDS interval
+typedef struct {
+    _Atomic uint32_t seq;           //Odd while the worker updates it
+    uint32_t topCount;              //Counters in use
+    uint64_t epoch;                 //Interval number + 1 (0 = never used)
+    uint64_t bookings;
+    int64_t cents;
+    RateCounter top[RATE_TOP_SLOTS];
+} RateBucket;
+
+//One worker's buckets, indexed by epoch % RATE_BUCKETS
+typedef struct {
+    RateBucket buckets[RATE_BUCKETS];
+} __attribute__((aligned(64))) RateRing;
+
+//Shared by every worker
+typedef struct {
+    uint64_t startNs;               //monotonic_ns() when the server started
+    int workers;
+    RateRing rings[];
+} RateWindows;
+
+RateWindows *rates_create(int workers);
+void rates_destroy(RateWindows *r);
+void rates_add(RateWindows *r, int worker, uint64_t nowNs, const char *destination, int64_t cents);
+int rates_report(RateWindows *r, uint64_t nowNs, StatsReport *report);
+
+#endif //RATES_H
@@ -0,0 +1,23 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+
+//Price/filter kernels over the catalog's column layout:
+//  int32_t prices[n]        price in cents per slot
+//  uint64_t active[(n+63)/64]  bit i set when slot i is an active trip
+//Each kernel has a scalar version and, on x86-64, SSE4.1 and AVX2
+//versions picked at run time from what the CPU supports.
+#define SCAN_SCALAR 0
+#define SCAN_SSE41  1
+#define SCAN_AVX2   2
+
+int scan_select(int isa);
+const char *scan_isa_name(int isa);
+
+uint32_t scan_under_budget(const int32_t *prices, const uint64_t *active, uint32_t n,
+                           int32_t budget, uint32_t *slots, uint32_t max);
+uint32_t scan_price_range(const int32_t *prices, const uint64_t *active, uint32_t n,
+                          int32_t *minPrice, int32_t *maxPrice);
+
+#endif //SCAN_H
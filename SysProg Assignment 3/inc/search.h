@@ -0,0 +1,21 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "catalog.h"
+
+//Trip queries answered from the catalog's sorted orders (byName, byPrice)
+//without locking: a binary search finds the first match, then the matches
+//are copied in order, so each query costs O(log n + k).
+//Every query returns the total number of matches (which may exceed max)
+//and the catalog version the results were read at, for quoting in a
+//booking.
+
+#define SEARCH_RESULTS 10       //Matches shown per search in the menus
+
+uint32_t search_prefix(Catalog *cat, const char *prefix, TripMatch *out, uint32_t max,
+                       unsigned int *version);
+uint32_t search_price_range(Catalog *cat, int32_t loCents, int32_t hiCents,
+                            TripMatch *out, uint32_t max, unsigned int *version);
+uint32_t search_cheapest(Catalog *cat, uint32_t k, TripMatch *out, unsigned int *version);
+
+#endif //SEARCH_H
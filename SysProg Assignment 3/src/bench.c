@@ -0,0 +1,1059 @@
+//
+//FILE               : bench.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Rodrigo P Gomes
+//FIRST VERSION      : 2025-11-29
+//DESCRIPTION        : Microbenchmarks for the IPC primitives: catalog lock
+//                     acquire/release (alone and contended by several
+//                     processes), catalog reads (locked and lock-free,
+//                     scaling with reader count), catalog growth and
+//                     lookups in a 100k-trip catalog, lock-free seat
+//                     reservations and revenue counters (shared
+//                     atomic vs per-process shards) from several
+//                     processes, SIMD price scans
+//                     (scalar/SSE4.1/AVX2) over the column layout, wire
+//                     protocol encode/decode, booking journal group
+//                     commit, crash recovery from checkpoint + journal,
+//                     rolling-window rate updates and reports and
+//                     display_client() rendering against posting to the
+//                     render thread, the binary event log against
+//                     one write() per text line and latency histogram
+//                     recording and merging. Results are printed as
+//                     JSON.
+//                     Usage: bench [iterations] [processes]
+//
+
+#include "ipc_shared.h"
+#include "protocol.h"
+#include "display.h"
+#include "catalog.h"
+#include "search.h"
+#include "scan.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "rates.h"
+#include "binlog.h"
+#include "histogram.h"
+#include <sys/mman.h>
+
+#define BENCH_DEFAULT_ITERATIONS 200000
+#define BENCH_DEFAULT_PROCS 4
+#define BENCH_CATALOG_TRIPS 10
+#define BENCH_LARGE_TRIPS 100000
+#define BENCH_SCAN_SLOTS (1 << 20)
+#define BENCH_SHM_NAME "/sysprog_catalog_bench"
+#define BENCH_CATALOG_FILE "/tmp/sysprog_catalog_bench.catalog"
+#define BENCH_JOURNAL_FILE "/tmp/sysprog_bench.journal"
+#define BENCH_CHECKPOINT_FILE "/tmp/sysprog_bench.checkpoint"
+#define BENCH_BINLOG_FILE "/tmp/sysprog_bench.binlog"
+#define BENCH_RECOVERY_BOOKINGS 1000000
+#define BENCH_RECOVERY_TAIL 10000
+
+static int results_printed = 0;
+
+//
+//FUNCTION     : report
+//DESCRIPTION  : Prints one benchmark result as a JSON object
+//PARAMETERS   : const char *name - benchmark name
+//              int procs - processes running it
+//              long ops - operations timed
+//              uint64_t elapsed - wall time in nanoseconds
+//RETURNS      : Nothing (rates of an empty run print as 0 so the output
+//              stays valid JSON)
+//
+static void report(const char *name, int procs, long ops, uint64_t elapsed) {
+    printf("%s\n    {\"name\": \"%s\", \"processes\": %d, \"ops\": %ld, "
+           "\"total_ns\": %llu, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f}",
+           results_printed++ ? "," : "",
+           name, procs, ops, (unsigned long long)elapsed,
+           ops > 0 ? (double)elapsed / (double)ops : 0.0,
+           elapsed > 0 ? (double)ops * 1e9 / (double)elapsed : 0.0);
+    fflush(stdout);
+}
+
+//
+//FUNCTION     : sample_booking
+//DESCRIPTION  : Fills a typical booking record
+//PARAMETERS   : ClientMessage *msg - receives the booking
+//              int n - varies the record contents
+//RETURNS      : Nothing
+//
+static void sample_booking(ClientMessage *msg, int n) {
+    memset(msg, 0, sizeof(ClientMessage));
+    msg->clientId  = 1;
+    msg->requestId = (unsigned int)n;
+    strcpy(msg->firstName, "Maria");
+    strcpy(msg->lastName, "Silva");
+    msg->age = 20 + n % 60;
+    snprintf(msg->address, MAX_ADDRESS, "%d King Street West", n % 999 + 1);
+    strcpy(msg->destination, "Rio de Janeiro");
+    msg->numPeople = 1 + n % 4;
+    msg->priceCents = 129999LL * msg->numPeople;
+}
+
+//
+//FUNCTION     : create_catalog
+//DESCRIPTION  : Creates a private catalog segment with the given number
+//              of trips; forked benchmark processes share it and its lock
+//PARAMETERS   : Catalog *cat - receives the attachment
+//              uint32_t trips - trips to add
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int create_catalog(Catalog *cat, uint32_t trips) {
+    Trip trip;
+
+    if (catalog_create(cat, BENCH_SHM_NAME, CATALOG_INITIAL_CAPACITY) == -1) {
+        return -1;
+    }
+    catalog_remove(BENCH_SHM_NAME);     //Gone once the bench exits
+
+    memset(&trip, 0, sizeof(Trip));
+    unsigned int version = catalog_write_begin(cat);
+    for (uint32_t i = 0; i < trips; i++) {
+        snprintf(trip.destination, MAX_NAME, "Destination %u", i);
+        trip.priceCents = 10000 + (i % 1000) * 100;
+        if (catalog_insert(cat, &trip, version) == -1) {
+            catalog_write_end(cat);
+            return -1;
+        }
+    }
+    catalog_write_end(cat);
+    return 0;
+}
+
+//
+//FUNCTION     : bench_lock_contended
+//DESCRIPTION  : Times lock/unlock pairs spread over several processes
+//              that all start together
+//PARAMETERS   : Catalog *cat - catalog, int procs - processes
+//              long iterations - lock/unlock pairs in total (at least one
+//              per process)
+//              int write - 1 for writer locks, 0 for reader locks
+//RETURNS      : Nothing
+//
+static void bench_lock_contended(Catalog *cat, int procs, long iterations, int write) {
+    int go[2];
+    long per_proc = iterations / procs > 0 ? iterations / procs : 1;
+
+    if (pipe(go) == -1) {
+        perror("pipe");
+        return;
+    }
+
+    for (int p = 0; p < procs; p++) {
+        if (fork() == 0) {
+            char c;
+            close(go[1]);
+            if (read(go[0], &c, 1) < 0) {
+                _exit(1);
+            }
+            for (long i = 0; i < per_proc; i++) {
+                if (write) {
+                    catalog_write_lock(cat);
+                } else {
+                    catalog_read_lock(cat);
+                }
+                catalog_unlock(cat);
+            }
+            _exit(0);
+        }
+    }
+
+    close(go[0]);
+    uint64_t start = monotonic_ns();
+    close(go[1]);       //Releases every child at once
+    while (wait(NULL) > 0) {
+    }
+    report(write ? "catalog_write_lock_contended" : "catalog_read_lock_contended",
+           procs, per_proc * procs, monotonic_ns() - start);
+}
+
+//
+//FUNCTION     : bench_lock
+//DESCRIPTION  : Catalog reader/writer lock, uncontended and contended
+//PARAMETERS   : Catalog *cat - catalog
+//              long iterations, int procs - benchmark size
+//RETURNS      : Nothing
+//
+static void bench_lock(Catalog *cat, long iterations, int procs) {
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        catalog_read_lock(cat);
+        catalog_unlock(cat);
+    }
+    report("catalog_read_lock", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        catalog_write_lock(cat);
+        catalog_unlock(cat);
+    }
+    report("catalog_write_lock", 1, iterations, monotonic_ns() - start);
+
+    bench_lock_contended(cat, procs, iterations, 0);
+    bench_lock_contended(cat, procs, iterations, 1);
+}
+
+//
+//FUNCTION     : bench_catalog
+//DESCRIPTION  : Copies the catalog the old way (under the reader lock)
+//              and the lock-free way (catalog_snapshot)
+//PARAMETERS   : Catalog *cat - catalog
+//              long iterations - catalog reads
+//RETURNS      : Nothing
+//
+static void bench_catalog(Catalog *cat, long iterations) {
+    TripMatch *local = NULL;
+    uint32_t bufCap = 0, count = 0;
+    volatile int sink = 0;
+
+    catalog_snapshot(cat, &local, &bufCap, &count);     //Sizes the buffer
+
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        CatalogColumns cols;
+        catalog_read_lock(cat);
+        catalog_columns(cat, &cols);
+        Trip *src = catalog_records(cat, cols.count);
+        for (uint32_t t = 0; t < cols.liveCount; t++) {
+            local[t].slot = cols.live[t];
+            local[t].trip = src[cols.live[t]];
+        }
+        count = cols.liveCount;
+        catalog_unlock(cat);
+        sink += (int)count + local[0].trip.destination[0];
+    }
+    report("catalog_read_locked", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        catalog_snapshot(cat, &local, &bufCap, &count);
+        sink += (int)count + local[0].trip.destination[0];
+    }
+    report("catalog_snapshot", 1, iterations, monotonic_ns() - start);
+    free(local);
+}
+
+//
+//FUNCTION     : bench_catalog_readers
+//DESCRIPTION  : Lock-free snapshots from 1..procs processes at once, each
+//              doing the same number of reads, so ops_per_sec shows how
+//              catalog reads scale with reader count. That only holds up
+//              to the CPUs of the benchmark host: beyond them readers
+//              time-share and total throughput stays flat, which says
+//              nothing about the reads themselves.
+//PARAMETERS   : Catalog *cat - catalog, int procs - most readers
+//              long iterations - snapshots per process
+//RETURNS      : Nothing
+//
+static void bench_catalog_readers(Catalog *cat, int procs, long iterations) {
+    for (int readers = 1; readers <= procs; readers *= 2) {
+        int go[2];
+
+        if (pipe(go) == -1) {
+            perror("pipe");
+            return;
+        }
+
+        for (int p = 0; p < readers; p++) {
+            if (fork() == 0) {
+                TripMatch *local = NULL;
+                uint32_t bufCap = 0, count = 0;
+                volatile int sink = 0;
+                char c;
+
+                close(go[1]);
+                if (read(go[0], &c, 1) < 0) {
+                    _exit(1);
+                }
+                for (long i = 0; i < iterations; i++) {
+                    catalog_snapshot(cat, &local, &bufCap, &count);
+                    sink += (int)count;
+                }
+                _exit(0);
+            }
+        }
+
+        close(go[0]);
+        uint64_t start = monotonic_ns();
+        close(go[1]);
+        while (wait(NULL) > 0) {
+        }
+        report("catalog_snapshot_readers", readers, iterations * readers,
+               monotonic_ns() - start);
+    }
+}
+
+//
+//FUNCTION     : bench_reserve
+//DESCRIPTION  : Reserves one seat at a time from procs processes at once,
+//              either all on the same trip or each on its own trip. Each
+//              trip has fewer seats than the attempts made on it, so the
+//              run also checks that exactly that many seats were sold.
+//PARAMETERS   : Catalog *cat - catalog, int procs - processes
+//              long iterations - reservation attempts per process
+//              int shared - 1 for one trip, 0 for a trip per process
+//RETURNS      : Nothing
+//
+static void bench_reserve(Catalog *cat, int procs, long iterations, int shared) {
+    int trips = shared ? 1 : (procs < BENCH_CATALOG_TRIPS ? procs : BENCH_CATALOG_TRIPS);
+    int seats = (int)(iterations * procs / trips / 2) + 1;
+    _Atomic long *sold = mmap(NULL, sizeof(long), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    unsigned int versions[BENCH_CATALOG_TRIPS];
+    Trip trip;
+    int go[2];
+
+    if (sold == MAP_FAILED || pipe(go) == -1) {
+        perror("bench_reserve");
+        return;
+    }
+    atomic_init(sold, 0);
+
+    //Seats sold by an earlier run stay sold across updates, so restock by
+    //lifting the limit first
+    unsigned int v = catalog_write_begin(cat);
+    for (int t = 0; t < trips; t++) {
+        trip = catalog_records(cat, (uint32_t)t + 1)[t];
+        trip.seats = 0;
+        catalog_update(cat, (uint32_t)t, &trip, v);
+        trip.seats = seats;
+        catalog_update(cat, (uint32_t)t, &trip, v);
+        versions[t] = v;
+    }
+    catalog_write_end(cat);
+
+    for (int p = 0; p < procs; p++) {
+        if (fork() == 0) {
+            uint32_t slot = (uint32_t)(p % trips);
+            long mine = 0;
+            int left;
+            char c;
+
+            close(go[1]);
+            if (read(go[0], &c, 1) < 0) {
+                _exit(1);
+            }
+            for (long i = 0; i < iterations; i++) {
+                mine += catalog_reserve(cat, slot, versions[slot], 1, &left) == RESERVE_OK;
+            }
+            atomic_fetch_add(sold, mine);
+            _exit(0);
+        }
+    }
+
+    close(go[0]);
+    uint64_t start = monotonic_ns();
+    close(go[1]);
+    while (wait(NULL) > 0) {
+    }
+    report(shared ? "reserve_same_trip" : "reserve_own_trip", procs,
+           iterations * procs, monotonic_ns() - start);
+
+    if (atomic_load(sold) != (long)seats * trips) {
+        fprintf(stderr, "Seat reservation sold %ld seats, expected %ld\n",
+                atomic_load(sold), (long)seats * trips);
+    }
+    munmap((void *)sold, sizeof(long));
+}
+
+//
+//FUNCTION     : bench_revenue
+//DESCRIPTION  : Times revenue accounting from several processes: every
+//              process adding to one shared atomic counter (the cache
+//              line bounces between cores) against each adding to its
+//              own 64-byte-aligned shard with a plain load and store, as
+//              the server workers do. The shards are summed afterwards
+//              and checked against the expected total.
+//PARAMETERS   : int procs - processes, long iterations - adds per process
+//              int sharded - 1 for per-process shards, 0 for one counter
+//RETURNS      : Nothing
+//
+static void bench_revenue(int procs, long iterations, int sharded) {
+    typedef struct { _Atomic int64_t cents; } __attribute__((aligned(64))) Shard;
+    size_t bytes = sizeof(Shard) * (size_t)(procs + 1);
+    Shard *shards = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int go[2];
+
+    if (shards == MAP_FAILED || pipe(go) == -1) {
+        perror("bench_revenue");
+        return;
+    }
+    for (int p = 0; p <= procs; p++) {
+        atomic_init(&shards[p].cents, 0);
+    }
+
+    for (int p = 0; p < procs; p++) {
+        if (fork() == 0) {
+            _Atomic int64_t *mine = &shards[p + 1].cents;
+            char c;
+
+            close(go[1]);
+            if (read(go[0], &c, 1) < 0) {
+                _exit(1);
+            }
+            for (long i = 0; i < iterations; i++) {
+                if (sharded) {
+                    //Single writer: no read-modify-write needed
+                    atomic_store_explicit(mine, atomic_load_explicit(mine, memory_order_relaxed) + 129999,
+                                          memory_order_relaxed);
+                } else {
+                    atomic_fetch_add_explicit(&shards[0].cents, 129999, memory_order_relaxed);
+                }
+            }
+            _exit(0);
+        }
+    }
+
+    close(go[0]);
+    uint64_t start = monotonic_ns();
+    close(go[1]);
+    while (wait(NULL) > 0) {
+    }
+    report(sharded ? "revenue_sharded" : "revenue_shared_atomic", procs,
+           iterations * procs, monotonic_ns() - start);
+
+    int64_t total = 0;
+    for (int p = 0; p <= procs; p++) {
+        total += atomic_load(&shards[p].cents);
+    }
+    if (total != 129999LL * iterations * procs) {
+        fprintf(stderr, "Revenue counters lost updates: %lld cents\n", (long long)total);
+    }
+    munmap(shards, bytes);
+}
+
+//
+//FUNCTION     : bench_large_catalog
+//DESCRIPTION  : Builds a BENCH_LARGE_TRIPS catalog from the initial
+//              capacity (growing the segment online), then times slot
+//              reads, destination lookups (linear scan and hash index),
+//              full snapshots, sorted-order searches, single appends,
+//              delete/insert churn and a save/restore through the
+//              catalog file
+//PARAMETERS   : long iterations - slot reads
+//RETURNS      : Nothing
+//
+static void bench_large_catalog(long iterations) {
+    Catalog cat;
+    Trip trip;
+    TripMatch *local = NULL;
+    uint32_t bufCap = 0, count = 0;
+    volatile int sink = 0;
+    char name[MAX_NAME];
+
+    uint64_t start = monotonic_ns();
+    if (create_catalog(&cat, BENCH_LARGE_TRIPS) == -1) {
+        return;
+    }
+    report("catalog_append_with_growth", 1, BENCH_LARGE_TRIPS, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += catalog_get_trip(&cat, (uint32_t)(i % BENCH_LARGE_TRIPS), &trip);
+    }
+    report("catalog_get_trip_100k", 1, iterations, monotonic_ns() - start);
+
+    //Linear scan (the lookup before the hash index) vs the index
+    long scans = iterations / 1000 + 1;
+    Trip *all = catalog_records(&cat, BENCH_LARGE_TRIPS);
+    start = monotonic_ns();
+    for (long i = 0; i < scans; i++) {
+        snprintf(name, MAX_NAME, "Destination %ld", (i * 7919) % BENCH_LARGE_TRIPS);
+        for (uint32_t t = 0; t < BENCH_LARGE_TRIPS; t++) {
+            if (all[t].active && strncmp(all[t].destination, name, MAX_NAME) == 0) {
+                sink += (int)t;
+                break;
+            }
+        }
+    }
+    report("catalog_scan_destination_100k", 1, scans, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        snprintf(name, MAX_NAME, "Destination %ld", (i * 7919) % BENCH_LARGE_TRIPS);
+        sink += catalog_find_trip(&cat, name, &trip);
+    }
+    report("catalog_find_trip_100k", 1, iterations, monotonic_ns() - start);
+
+    long snapshots = iterations / 10000 + 1;
+    start = monotonic_ns();
+    for (long i = 0; i < snapshots; i++) {
+        catalog_snapshot(&cat, &local, &bufCap, &count);
+        sink += (int)count;
+    }
+    report("catalog_snapshot_100k", 1, snapshots, monotonic_ns() - start);
+
+    int32_t lo, hi;
+    long scans100k = iterations / 1000 + 1;
+    start = monotonic_ns();
+    for (long i = 0; i < scans100k; i++) {
+        sink += (int)catalog_under_budget(&cat, 50000, NULL, 0);
+        sink += (int)catalog_price_range(&cat, &lo, &hi);
+    }
+    report("catalog_budget_and_range_100k", 1, scans100k, monotonic_ns() - start);
+
+    //Sorted-order queries; the range count must agree with the scan
+    TripMatch matches[SEARCH_RESULTS];
+    unsigned int version;
+    if (search_price_range(&cat, 0, 50000, matches, 0, &version) !=
+        catalog_under_budget(&cat, 50000, NULL, 0)) {
+        fprintf(stderr, "search_price_range disagrees with the price scan\n");
+    }
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        snprintf(name, MAX_NAME, "Destination %ld", (i * 7919) % 1000);
+        sink += (int)search_prefix(&cat, name, matches, SEARCH_RESULTS, &version);
+    }
+    report("search_prefix_100k", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        int32_t from = 10000 + (int32_t)(i % 1000) * 100;
+        sink += (int)search_price_range(&cat, from, from + 500, matches, SEARCH_RESULTS, &version);
+    }
+    report("search_price_range_100k", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += (int)search_cheapest(&cat, SEARCH_RESULTS, matches, &version);
+    }
+    report("search_cheapest_100k", 1, iterations, monotonic_ns() - start);
+
+    //Single-trip edits: the new slot is merged into both sorted orders
+    //before the edit is published
+    long edits = iterations / 10000 + 1;
+    memset(&trip, 0, sizeof(Trip));
+    start = monotonic_ns();
+    for (long i = 0; i < edits; i++) {
+        snprintf(trip.destination, MAX_NAME, "Added %ld", i);
+        trip.priceCents = 10000 + (i % 1000) * 100;
+        unsigned int v = catalog_write_begin(&cat);
+        catalog_insert(&cat, &trip, v);
+        catalog_write_end(&cat);
+    }
+    report("catalog_append_one_100k", 1, edits, monotonic_ns() - start);
+
+    //Churn: delete a trip and insert a new one, which takes the freed
+    //slot, so the catalog stays the same size
+    start = monotonic_ns();
+    for (long i = 0; i < edits; i++) {
+        uint32_t slot = (uint32_t)((i * 7919) % BENCH_LARGE_TRIPS);
+        snprintf(trip.destination, MAX_NAME, "Churn %ld", i);
+        unsigned int v = catalog_write_begin(&cat);
+        if (catalog_delete(&cat, slot, v) == 0 && catalog_insert(&cat, &trip, v) != (int)slot) {
+            fprintf(stderr, "catalog_insert did not reuse slot %u\n", slot);
+        }
+        catalog_write_end(&cat);
+    }
+    report("catalog_delete_insert_100k", 1, edits, monotonic_ns() - start);
+
+    //Persistence: save to the catalog file, then restart from it
+    Catalog restored;
+    start = monotonic_ns();
+    if (catalog_save(&cat, BENCH_CATALOG_FILE) == 0) {
+        report("catalog_save_100k", 1, 1, monotonic_ns() - start);
+
+        start = monotonic_ns();
+        if (catalog_restore(&restored, BENCH_SHM_NAME, BENCH_CATALOG_FILE) == 0) {
+            report("catalog_restore_100k", 1, 1, monotonic_ns() - start);
+            if (restored.hdr->liveCount != cat.hdr->liveCount) {
+                fprintf(stderr, "catalog_restore lost trips\n");
+            }
+            catalog_remove(BENCH_SHM_NAME);
+            catalog_close(&restored);
+        }
+        unlink(BENCH_CATALOG_FILE);
+    }
+
+    free(local);
+    catalog_close(&cat);
+}
+
+//
+//FUNCTION     : bench_scan
+//DESCRIPTION  : Price column kernels on BENCH_SCAN_SLOTS slots (half of
+//              them active) with every kernel set the CPU supports.
+//              ops are slots scanned, so ns_per_op is the cost per slot.
+//PARAMETERS   : long iterations - scales the number of passes
+//RETURNS      : Nothing
+//
+static void bench_scan(long iterations) {
+    int32_t *prices  = malloc(BENCH_SCAN_SLOTS * sizeof(int32_t));
+    uint64_t *active = calloc(BENCH_SCAN_SLOTS / 64, sizeof(uint64_t));
+    uint32_t *slots  = malloc(BENCH_SCAN_SLOTS * sizeof(uint32_t));
+    long passes = iterations / 20000 + 1;
+    volatile uint32_t sink = 0;
+    uint32_t expected = 0;
+    char name[64];
+
+    if (prices == NULL || active == NULL || slots == NULL) {
+        free(prices);
+        free(active);
+        free(slots);
+        return;
+    }
+
+    srand(42);
+    for (uint32_t i = 0; i < BENCH_SCAN_SLOTS; i++) {
+        prices[i] = 1000 + rand() % 200000;
+        if (rand() & 1) {
+            active[i >> 6] |= 1ull << (i & 63);
+        }
+    }
+
+    int best = scan_select(-1);
+    for (int isa = SCAN_SCALAR; isa <= best; isa++) {
+        int32_t lo = 0, hi = 0;
+        uint32_t found = 0;
+
+        scan_select(isa);
+
+        uint64_t start = monotonic_ns();
+        for (long p = 0; p < passes; p++) {
+            found = scan_under_budget(prices, active, BENCH_SCAN_SLOTS, 50000, NULL, 0);
+            sink += found;
+        }
+        snprintf(name, sizeof(name), "scan_count_under_budget_%s", scan_isa_name(isa));
+        report(name, 1, passes * BENCH_SCAN_SLOTS, monotonic_ns() - start);
+
+        start = monotonic_ns();
+        for (long p = 0; p < passes; p++) {
+            sink += scan_under_budget(prices, active, BENCH_SCAN_SLOTS, 50000,
+                                      slots, BENCH_SCAN_SLOTS);
+        }
+        snprintf(name, sizeof(name), "scan_list_under_budget_%s", scan_isa_name(isa));
+        report(name, 1, passes * BENCH_SCAN_SLOTS, monotonic_ns() - start);
+
+        start = monotonic_ns();
+        for (long p = 0; p < passes; p++) {
+            sink += scan_price_range(prices, active, BENCH_SCAN_SLOTS, &lo, &hi);
+        }
+        snprintf(name, sizeof(name), "scan_price_range_%s", scan_isa_name(isa));
+        report(name, 1, passes * BENCH_SCAN_SLOTS, monotonic_ns() - start);
+
+        //Every kernel set must agree with the scalar one
+        if (isa == SCAN_SCALAR) {
+            expected = found;
+        } else if (found != expected) {
+            fprintf(stderr, "%s kernels disagree with scalar: %u vs %u\n",
+                    scan_isa_name(isa), found, expected);
+        }
+    }
+    scan_select(-1);
+
+    free(prices);
+    free(active);
+    free(slots);
+}
+
+//
+//FUNCTION     : bench_protocol
+//DESCRIPTION  : Encode/decode cost of single bookings and batches
+//PARAMETERS   : long iterations - records to encode/decode
+//RETURNS      : Nothing
+//
+static void bench_protocol(long iterations) {
+    static uint8_t frame[PROTO_MAX_FRAME];
+    static ClientMessage batch[PROTO_MAX_BATCH];
+    ClientMessage msg, out;
+    FrameHeader hdr;
+    volatile int sink = 0;
+    int len = 0, encoded = 0;
+
+    sample_booking(&msg, 7);
+
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        msg.requestId = (unsigned int)i;
+        len = proto_encode_booking(&msg, frame, sizeof(frame));
+        sink += len;
+    }
+    report("booking_encode", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        proto_parse_header(frame, (size_t)len, &hdr);
+        sink += proto_decode_booking(frame + PROTO_HEADER_SIZE, hdr.length, &out);
+    }
+    report("booking_decode", 1, iterations, monotonic_ns() - start);
+
+    for (int i = 0; i < PROTO_MAX_BATCH; i++) {
+        sample_booking(&batch[i], i);
+    }
+    long rounds = iterations / PROTO_MAX_BATCH + 1;
+
+    start = monotonic_ns();
+    for (long i = 0; i < rounds; i++) {
+        len = proto_encode_batch(batch, PROTO_MAX_BATCH, frame, sizeof(frame), &encoded);
+        sink += len;
+    }
+    report("batch_encode_per_record", 1, rounds * encoded, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < rounds; i++) {
+        proto_parse_header(frame, (size_t)len, &hdr);
+        sink += proto_decode_batch(frame + PROTO_HEADER_SIZE, hdr.length,
+                                   batch, PROTO_MAX_BATCH);
+    }
+    report("batch_decode_per_record", 1, rounds * encoded, monotonic_ns() - start);
+
+    printf(",\n    {\"name\": \"booking_wire_bytes\", \"bytes\": %d, \"struct_bytes\": %zu}",
+           proto_encode_booking(&msg, frame, sizeof(frame)), sizeof(ClientMessage));
+}
+
+//
+//FUNCTION     : bench_journal
+//DESCRIPTION  : Cost of journal_append on the caller's side and the
+//              end-to-end rate until every record is synced, for a few
+//              group commit settings (commits per run shows the batching)
+//PARAMETERS   : long iterations - bookings journaled per setting
+//RETURNS      : Nothing
+//
+static void bench_journal(long iterations) {
+    static const struct { long delayUs; uint32_t batch; } settings[] = {
+        { 0, 1 }, { JOURNAL_DEFAULT_DELAY_US, JOURNAL_DEFAULT_BATCH }, { 10000, 4096 }
+    };
+    JournalRecord rec;
+    Journal j;
+
+    memset(&rec, 0, sizeof(rec));
+    strcpy(rec.destination, "Paris");
+    rec.numPeople  = 2;
+    rec.priceCents = 24999;
+
+    for (size_t s = 0; s < sizeof(settings) / sizeof(settings[0]); s++) {
+        char name[64];
+        long ops = settings[s].batch == 1 ? iterations / 100 + 1 : iterations;
+        uint64_t appendNs = 0;
+
+        unlink(BENCH_JOURNAL_FILE);
+        if (journal_open(&j, BENCH_JOURNAL_FILE, settings[s].delayUs, settings[s].batch) == -1) {
+            perror("journal_open");
+            return;
+        }
+
+        uint64_t start = monotonic_ns();
+        for (long i = 0; i < ops; i++) {
+            uint64_t t = monotonic_ns();
+            rec.bookingNumber = (uint64_t)i + 1;
+            journal_append(&j, &rec);
+            appendNs += monotonic_ns() - t;
+        }
+        while (journal_durable(&j) < (uint64_t)ops) {
+            usleep(100);
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        unsigned long long commits = atomic_load(&j.commits);
+        journal_close(&j);
+
+        snprintf(name, sizeof(name), "journal_append_delay%ldus_batch%u",
+                 settings[s].delayUs, settings[s].batch);
+        report(name, 1, ops, appendNs);
+        snprintf(name, sizeof(name), "journal_durable_delay%ldus_batch%u",
+                 settings[s].delayUs, settings[s].batch);
+        report(name, 1, ops, elapsed);
+        printf(",\n    {\"name\": \"%s_commits\", \"commits\": %llu}", name, commits);
+    }
+    unlink(BENCH_JOURNAL_FILE);
+}
+
+//
+//FUNCTION     : bench_rates
+//DESCRIPTION  : Cost of counting a booking in the rolling windows and of
+//              building the 1/5/15 minute report once 15 minutes of
+//              buckets are full (bookings spread over 100 destinations
+//              and over the whole span)
+//PARAMETERS   : long iterations - bookings counted
+//RETURNS      : Nothing
+//
+static void bench_rates(long iterations) {
+    RateWindows *r = rates_create(1);
+    char names[100][MAX_NAME];
+    StatsReport stats;
+    uint64_t base = monotonic_ns();
+    uint64_t step = 900ULL * 1000000000ULL / (uint64_t)iterations;
+    long reports = iterations / 1000 + 1;
+
+    if (r == NULL) {
+        perror("rates_create");
+        return;
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(names[i], MAX_NAME, "Destination %d", i);
+    }
+
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        rates_add(r, 0, base + (uint64_t)i * step, names[(i * 7) % 100], 10000 + i % 1000);
+    }
+    report("rates_add", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < reports; i++) {
+        rates_report(r, base + (uint64_t)iterations * step, &stats);
+    }
+    report("rates_report", 1, reports, monotonic_ns() - start);
+    rates_destroy(r);
+}
+
+//
+//FUNCTION     : bench_recovery
+//DESCRIPTION  : Restart cost with a 1M-booking journal: replaying all of
+//              it against mapping a checkpoint and replaying only the
+//              tail written after it
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+static void bench_recovery(void) {
+    JournalRecord *recs = calloc(BENCH_RECOVERY_BOOKINGS, sizeof(JournalRecord));
+    BookingTotals t;
+    FILE *fp;
+
+    if (recs == NULL) {
+        return;
+    }
+    for (long i = 0; i < BENCH_RECOVERY_BOOKINGS; i++) {
+        recs[i].magic = JOURNAL_MAGIC;
+        recs[i].bookingNumber = (uint64_t)i + 1;
+        recs[i].numPeople  = 1 + (int32_t)(i % 4);
+        recs[i].priceCents = 10000 + (uint32_t)(i % 977);
+        snprintf(recs[i].destination, MAX_NAME, "Trip %ld", i % 5000);
+        recs[i].checksum = journal_checksum(&recs[i]);
+    }
+
+    fp = fopen(BENCH_JOURNAL_FILE, "w");
+    if (fp == NULL) {
+        free(recs);
+        return;
+    }
+    fwrite(recs, sizeof(JournalRecord), BENCH_RECOVERY_BOOKINGS, fp);
+    fclose(fp);
+
+    //Full replay (no checkpoint)
+    totals_init(&t);
+    uint64_t start = monotonic_ns();
+    long replayed = journal_replay(&t, BENCH_JOURNAL_FILE, 0);
+    report("recovery_full_replay", 1, replayed, monotonic_ns() - start);
+    totals_free(&t);
+
+    //Checkpoint covering all but the tail
+    totals_init(&t);
+    for (long i = 0; i < BENCH_RECOVERY_BOOKINGS - BENCH_RECOVERY_TAIL; i++) {
+        totals_add(&t, &recs[i]);
+    }
+    t.hdr.journalOffset = (uint64_t)(BENCH_RECOVERY_BOOKINGS - BENCH_RECOVERY_TAIL) *
+                          sizeof(JournalRecord);
+    checkpoint_save(&t, BENCH_CHECKPOINT_FILE);
+    totals_free(&t);
+
+    start = monotonic_ns();
+    checkpoint_load(&t, BENCH_CHECKPOINT_FILE);
+    replayed = journal_replay(&t, BENCH_JOURNAL_FILE, 0);
+    uint64_t elapsed = monotonic_ns() - start;
+    printf(",\n    {\"name\": \"recovery_checkpoint_plus_tail\", \"bookings\": %llu, "
+           "\"replayed\": %ld, \"destinations\": %u, \"total_ns\": %llu}",
+           (unsigned long long)t.hdr.recordCount, replayed, t.hdr.destCount,
+           (unsigned long long)elapsed);
+    totals_free(&t);
+
+    unlink(BENCH_JOURNAL_FILE);
+    unlink(BENCH_CHECKPOINT_FILE);
+    free(recs);
+}
+
+//
+//FUNCTION     : bench_display
+//DESCRIPTION  : display_client() plus one wrefresh per booking, rendered
+//              to an 80x24 terminal written to /dev/null, against posting
+//              the bookings to the render thread (the event loop's side)
+//PARAMETERS   : long iterations - bookings rendered
+//RETURNS      : Nothing
+//
+static void bench_display(long iterations) {
+    ClientMessage msg;
+    FILE *out = fopen("/dev/null", "w");
+    FILE *in  = fopen("/dev/null", "r");
+
+    if (out == NULL || in == NULL) {
+        return;
+    }
+
+    setenv("TERM", "xterm", 0);
+    setenv("COLUMNS", "80", 1);
+    setenv("LINES", "24", 1);
+    SCREEN *screen = newterm(NULL, out, in);
+    if (screen == NULL) {
+        return;
+    }
+    set_term(screen);
+    display_create_windows();
+
+    sample_booking(&msg, 3);
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        msg.clientId = (int)i;
+        display_client(&msg);
+        wrefresh(display_win);
+    }
+    report("display_client_render", 1, iterations, monotonic_ns() - start);
+
+    //Ten times the bookings: posting must keep up with the network path
+    if (display_start(0) == 0) {
+        long posts = iterations * 10;
+        start = monotonic_ns();
+        for (long i = 0; i < posts; i++) {
+            msg.clientId = (int)i;
+            display_post_client(&msg);
+        }
+        report("display_post_client", 1, posts, monotonic_ns() - start);
+        display_stop();
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(out);
+    fclose(in);
+}
+
+//
+//FUNCTION     : bench_binlog
+//DESCRIPTION  : Cost of logging a booking to the binary event log (ring
+//              copy; the flusher thread writes) against formatting it
+//              and writing it straight to a file, one write() per line
+//PARAMETERS   : long iterations - bookings logged
+//RETURNS      : Nothing
+//
+static void bench_binlog(long iterations) {
+    ClientMessage msg;
+    char line[256];
+
+    sample_booking(&msg, 3);
+    unlink(BENCH_BINLOG_FILE);
+    if (binlog_open(BENCH_BINLOG_FILE) == -1 || binlog_start(0) == -1) {
+        perror("binlog_open");
+        return;
+    }
+
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        msg.clientId = (int)i;
+        binlog_booking(&msg);
+    }
+    report("binlog_booking", 1, iterations, monotonic_ns() - start);
+    binlog_stop();
+    binlog_close();
+
+    //Records that reached the file
+    FILE *fp = fopen(BENCH_BINLOG_FILE, "r");
+    if (fp != NULL) {
+        BinlogHeader hdr;
+        unsigned long long records = 0, bytes = sizeof(BinlogFileHeader);
+
+        fseek(fp, sizeof(BinlogFileHeader), SEEK_SET);
+        while (fread(&hdr, sizeof(hdr), 1, fp) == 1 && hdr.length >= sizeof(hdr) &&
+               fseek(fp, hdr.length - (long)sizeof(hdr), SEEK_CUR) == 0) {
+            records += hdr.type == BINLOG_BOOKING;
+            bytes += hdr.length;
+        }
+        fclose(fp);
+        printf(",\n    {\"name\": \"binlog_booking_written\", \"records\": %llu, \"bytes\": %llu}",
+               records, bytes);
+    }
+
+    int fd = open(BENCH_BINLOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open");
+        return;
+    }
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        int n = snprintf(line, sizeof(line), "Client %ld booked %d to %s for $%lld.%02lld\n",
+                         i, msg.numPeople, msg.destination,
+                         (long long)(msg.priceCents / 100), (long long)(msg.priceCents % 100));
+        if (write(fd, line, (size_t)n) != n) {
+            perror("write");
+            break;
+        }
+    }
+    report("text_line_write", 1, iterations, monotonic_ns() - start);
+    close(fd);
+    unlink(BENCH_BINLOG_FILE);
+}
+
+//
+//FUNCTION     : bench_histogram
+//DESCRIPTION  : Cost of recording a latency in a single-writer histogram
+//              (the event loop's side) and of merging one for a scrape
+//              plus reading its p99
+//PARAMETERS   : long iterations - values recorded
+//RETURNS      : Nothing
+//
+static void bench_histogram(long iterations) {
+    static Histogram h, merged;
+    long merges = iterations / 1000 + 1;
+    uint64_t value = 12345;
+    volatile uint64_t p99 = 0;
+
+    uint64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; i++) {
+        //Spread over the range like real latencies (xorshift)
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+        hist_record(&h, value & 0xfffff, 1);
+    }
+    report("hist_record", 1, iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < merges; i++) {
+        memset(&merged, 0, sizeof(merged));
+        hist_merge(&merged, &h);
+        p99 = hist_quantile(&merged, 0.99);
+    }
+    report("hist_merge_quantile", 1, merges, monotonic_ns() - start);
+    (void)p99;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = BENCH_DEFAULT_ITERATIONS;
+    int procs = BENCH_DEFAULT_PROCS;
+
+    if (argc > 1) {
+        iterations = atol(argv[1]);
+    }
+    if (argc > 2) {
+        procs = atoi(argv[2]);
+    }
+    if (iterations < 1 || procs < 1) {
+        fprintf(stderr, "Usage: %s [iterations] [processes]\n", argv[0]);
+        return 1;
+    }
+
+    Catalog cat;
+    if (create_catalog(&cat, BENCH_CATALOG_TRIPS) == -1) {
+        return 1;
+    }
+
+    printf("{\n  \"iterations\": %ld,\n  \"results\": [", iterations);
+    bench_lock(&cat, iterations, procs);
+    bench_catalog(&cat, iterations);
+    bench_catalog_readers(&cat, procs, iterations);
+    bench_reserve(&cat, procs, iterations, 1);
+    bench_reserve(&cat, procs, iterations, 0);
+    bench_revenue(procs, iterations, 0);
+    bench_revenue(procs, iterations, 1);
+    bench_large_catalog(iterations);
+    bench_scan(iterations);
+    bench_protocol(iterations);
+    bench_journal(iterations);
+    bench_recovery();
+    bench_rates(iterations);
+    bench_display(iterations / 10 + 1);
+    bench_binlog(iterations);
+    bench_histogram(iterations);
+    printf("\n  ]\n}\n");
+    return 0;
+}
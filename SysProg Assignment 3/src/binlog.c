@@ -0,0 +1,516 @@
+//
+//FILE          : binlog.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 16 2025
+//DESCRIPTION   : Asynchronous binary event log for the headless server.
+//               Logging copies a fixed-layout record into the calling
+//               thread's ring; a flusher thread writes every ring out in
+//               large appends (see binlog.h). logdump turns the file
+//               back into text.
+//
+
+#define _GNU_SOURCE
+#include "binlog.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define FLUSH_POLL_MS 10            //Flusher checks the rings this often
+#define MAX_RINGS 64                //Logging threads per process
+
+//One logging thread's records. The thread only moves head, the flusher
+//only moves tail.
+typedef struct LogRing {
+    uint8_t *data;                  //BINLOG_RING_BYTES
+    _Atomic uint64_t head;          //Bytes logged
+    _Atomic uint64_t tail;          //Bytes written to the file
+    _Atomic uint64_t dropped;       //Records lost to failed writes
+    struct LogRing *next;
+} LogRing;
+
+static int log_fd = -1;
+static uint8_t log_worker = BINLOG_MAIN;
+static __thread LogRing *my_ring;
+static LogRing *rings;              //Every logging thread's ring
+static int ring_count;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;  //List and draining
+static pthread_t flusher;
+static _Atomic int flusher_running;
+static _Atomic int flusher_stop;
+
+static __thread char line[BINLOG_TEXT_MAX];     //Text not yet logged (binlog_text)
+static __thread int line_length;
+
+static size_t drain(void);
+static void emit_line(void);
+
+//
+//FUNCTION     : ring_get
+//DESCRIPTION  : The calling thread's ring, created and registered the
+//              first time the thread logs
+//PARAMETERS   : None
+//RETURNS      : LogRing * - ring, NULL if logging is off or out of memory
+//
+static LogRing *ring_get(void) {
+    if (my_ring != NULL || log_fd == -1) {
+        return my_ring;
+    }
+
+    pthread_mutex_lock(&rings_lock);
+    if (ring_count < MAX_RINGS) {
+        LogRing *r = calloc(1, sizeof(LogRing));
+        if (r != NULL && (r->data = malloc(BINLOG_RING_BYTES)) != NULL) {
+            r->next = rings;
+            rings = r;
+            ring_count++;
+            my_ring = r;
+        } else {
+            free(r);
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+    return my_ring;
+}
+
+//
+//FUNCTION     : log_record
+//DESCRIPTION  : Stamps a record and copies it into the caller's ring.
+//              A full ring is drained by the caller first, which always
+//              empties it (records a failed write loses are counted there).
+//PARAMETERS   : void *rec - record starting with a BinlogHeader
+//              uint8_t type - BINLOG_* type
+//              size_t length - bytes used, rounded up to 8 here (the
+//              padding must already be zero)
+//RETURNS      : Nothing
+//
+static void log_record(void *rec, uint8_t type, size_t length) {
+    LogRing *r = ring_get();
+    BinlogHeader *hdr = rec;
+    struct timespec ts;
+
+    if (r == NULL) {
+        return;
+    }
+    length = (length + 7) & ~(size_t)7;
+
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (BINLOG_RING_BYTES - (head - tail) < length) {
+        //The flusher is behind: write the rings from here rather than
+        //lose the record
+        drain();
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr->length   = (uint16_t)length;
+    hdr->type     = type;
+    hdr->worker   = log_worker;
+    hdr->reserved = 0;
+    hdr->timeNs   = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+    size_t off = (size_t)(head & (BINLOG_RING_BYTES - 1));
+    size_t first = length < BINLOG_RING_BYTES - off ? length : BINLOG_RING_BYTES - off;
+    memcpy(r->data + off, rec, first);
+    memcpy(r->data, (uint8_t *)rec + first, length - first);
+    atomic_store_explicit(&r->head, head + length, memory_order_release);
+}
+
+//
+//FUNCTION     : write_all
+//DESCRIPTION  : Appends a chunk whole or not at all: writev() until it
+//              is all written, under an exclusive flock() shared with the
+//              other workers' flushers. If a write fails, the file is cut
+//              back to where the chunk started, so no torn record is left
+//              for later records to land behind.
+//PARAMETERS   : struct iovec *iov, int n - segments (modified)
+//RETURNS      : int - 0 on success, -1 on error (nothing of the chunk
+//              is left in the file)
+//
+static int write_all(struct iovec *iov, int n) {
+    int rc = 0;
+
+    while (flock(log_fd, LOCK_EX) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    off_t start = lseek(log_fd, 0, SEEK_END);
+    if (start == -1) {
+        flock(log_fd, LOCK_UN);
+        return -1;
+    }
+
+    while (n > 0) {
+        ssize_t written = writev(log_fd, iov, n > IOV_MAX ? IOV_MAX : n);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (ftruncate(log_fd, start) == -1) {
+                //Nothing more can be done; logdump stops at the tear
+            }
+            rc = -1;
+            break;
+        }
+        while (n > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    flock(log_fd, LOCK_UN);
+    return rc;
+}
+
+//
+//FUNCTION     : count_records
+//DESCRIPTION  : Records held in a ring between two positions. Records are
+//              8-byte aligned, so a length field never wraps.
+//PARAMETERS   : const LogRing *r, uint64_t from, uint64_t to - bytes
+//RETURNS      : uint64_t - records
+//
+static uint64_t count_records(const LogRing *r, uint64_t from, uint64_t to) {
+    uint64_t records = 0;
+
+    while (from < to) {
+        const BinlogHeader *hdr =
+            (const BinlogHeader *)(r->data + (from & (BINLOG_RING_BYTES - 1)));
+        from += hdr->length;
+        records++;
+    }
+    return records;
+}
+
+//
+//FUNCTION     : drain
+//DESCRIPTION  : Writes everything logged so far, from every ring, in one
+//              writev(), plus a BINLOG_DROPPED record per ring that lost
+//              records, then frees the ring space. If the write fails,
+//              the chunk is cut back out of the file and every record of
+//              it is added to its ring's dropped count instead.
+//PARAMETERS   : None
+//RETURNS      : size_t - bytes written (0 if the write failed)
+//
+static size_t drain(void) {
+    static struct iovec iov[MAX_RINGS * 3];
+    static BinlogDropped dropped[MAX_RINGS];
+    LogRing *ringsSeen[MAX_RINGS];
+    uint64_t heads[MAX_RINGS], tails[MAX_RINGS], lostBefore[MAX_RINGS];
+    size_t total = 0;
+    int n = 0, seen = 0;
+
+    pthread_mutex_lock(&rings_lock);
+    for (LogRing *r = rings; r != NULL; r = r->next) {
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        uint64_t lost = atomic_exchange_explicit(&r->dropped, 0, memory_order_relaxed);
+
+        if (head > tail) {
+            size_t off = (size_t)(tail & (BINLOG_RING_BYTES - 1));
+            size_t len = (size_t)(head - tail);
+            size_t first = len < BINLOG_RING_BYTES - off ? len : BINLOG_RING_BYTES - off;
+
+            iov[n].iov_base = r->data + off;
+            iov[n++].iov_len = first;
+            if (len > first) {
+                iov[n].iov_base = r->data;
+                iov[n++].iov_len = len - first;
+            }
+            total += len;
+        }
+        if (lost > 0) {
+            BinlogDropped *d = &dropped[seen];
+            struct timespec ts;
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            memset(d, 0, sizeof(BinlogDropped));
+            d->hdr.length = sizeof(BinlogDropped);
+            d->hdr.type   = BINLOG_DROPPED;
+            d->hdr.worker = log_worker;
+            d->hdr.timeNs = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+            d->records    = lost;
+            iov[n].iov_base = d;
+            iov[n++].iov_len = sizeof(BinlogDropped);
+            total += sizeof(BinlogDropped);
+        }
+        ringsSeen[seen] = r;
+        heads[seen] = head;
+        tails[seen] = tail;
+        lostBefore[seen++] = lost;
+    }
+
+    int failed = n > 0 && write_all(iov, n) == -1;
+    for (int i = 0; i < seen; i++) {
+        if (failed) {
+            atomic_fetch_add_explicit(&ringsSeen[i]->dropped, lostBefore[i] +
+                                      count_records(ringsSeen[i], tails[i], heads[i]),
+                                      memory_order_relaxed);
+        }
+        atomic_store_explicit(&ringsSeen[i]->tail, heads[i], memory_order_release);
+    }
+    pthread_mutex_unlock(&rings_lock);
+    return failed ? 0 : total;
+}
+
+//
+//FUNCTION     : pending_bytes
+//DESCRIPTION  : Bytes logged and not yet written, over every ring
+//PARAMETERS   : None
+//RETURNS      : size_t - bytes
+//
+static size_t pending_bytes(void) {
+    size_t total = 0;
+
+    pthread_mutex_lock(&rings_lock);
+    for (LogRing *r = rings; r != NULL; r = r->next) {
+        total += (size_t)(atomic_load_explicit(&r->head, memory_order_acquire) -
+                          atomic_load_explicit(&r->tail, memory_order_relaxed));
+        if (atomic_load_explicit(&r->dropped, memory_order_relaxed) > 0) {
+            total += sizeof(BinlogDropped);
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+    return total;
+}
+
+//
+//FUNCTION     : flush_loop
+//DESCRIPTION  : Flusher thread: every FLUSH_POLL_MS, writes the rings out
+//              once BINLOG_CHUNK bytes are waiting or the last write is
+//              BINLOG_FLUSH_MS old; drains everything before exiting
+//PARAMETERS   : void *arg - unused
+//RETURNS      : void * - NULL
+//
+static void *flush_loop(void *arg) {
+    struct timespec poll = { 0, FLUSH_POLL_MS * 1000000L };
+    uint64_t lastWrite = monotonic_ns();
+
+    (void)arg;
+    while (!atomic_load(&flusher_stop)) {
+        nanosleep(&poll, NULL);
+
+        size_t pending = pending_bytes();
+        uint64_t now = monotonic_ns();
+        if (pending >= BINLOG_CHUNK ||
+            (pending > 0 && now - lastWrite >= (uint64_t)BINLOG_FLUSH_MS * 1000000ULL)) {
+            drain();
+            lastWrite = now;
+        }
+    }
+    drain();
+    return NULL;
+}
+
+//
+//FUNCTION     : binlog_open
+//DESCRIPTION  : Opens (or creates) the log for appending and writes the
+//              file header to a new file. Call before fork; every worker
+//              then starts its own flusher with binlog_start.
+//PARAMETERS   : const char *path - log file
+//RETURNS      : int - 0 on success, -1 on error
+//
+int binlog_open(const char *path) {
+    struct stat st;
+
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd == -1) {
+        return -1;
+    }
+    if (fstat(log_fd, &st) == 0 && st.st_size == 0) {
+        BinlogFileHeader fh = { BINLOG_MAGIC, BINLOG_VERSION, (uint64_t)time(NULL) };
+        if (write(log_fd, &fh, sizeof(fh)) != (ssize_t)sizeof(fh)) {
+            close(log_fd);
+            log_fd = -1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : binlog_start / binlog_stop
+//DESCRIPTION  : Starts this process's flusher thread and tags its records
+//              with the worker id / writes what is left and stops it
+//PARAMETERS   : int worker - worker number
+//RETURNS      : binlog_start: int - 0 on success, -1 if the thread could
+//              not start (records then wait for binlog_flush)
+//
+int binlog_start(int worker) {
+    sigset_t all, old;
+    int rc;
+
+    log_worker = (uint8_t)worker;
+    atomic_store(&flusher_stop, 0);
+
+    //Signals stay with the event loop, which relies on EINTR
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&flusher, NULL, flush_loop, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    atomic_store(&flusher_running, 1);
+    return 0;
+}
+
+void binlog_stop(void) {
+    if (!atomic_load(&flusher_running)) {
+        return;
+    }
+    atomic_store(&flusher_stop, 1);
+    pthread_join(flusher, NULL);
+    atomic_store(&flusher_running, 0);
+}
+
+//
+//FUNCTION     : binlog_flush
+//DESCRIPTION  : Writes everything logged so far now, including the
+//              caller's unfinished line. Needed before fork, so the
+//              children do not inherit records still in a ring.
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void binlog_flush(void) {
+    if (log_fd != -1) {
+        emit_line();
+        drain();
+    }
+}
+
+//
+//FUNCTION     : binlog_close
+//DESCRIPTION  : Stops the flusher, writes what is left, closes the file
+//              and frees the rings
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void binlog_close(void) {
+    if (log_fd == -1) {
+        return;
+    }
+    binlog_stop();
+    emit_line();
+    drain();
+    close(log_fd);
+    log_fd = -1;
+
+    pthread_mutex_lock(&rings_lock);
+    while (rings != NULL) {
+        LogRing *next = rings->next;
+        free(rings->data);
+        free(rings);
+        rings = next;
+    }
+    ring_count = 0;
+    my_ring = NULL;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+//
+//FUNCTION     : binlog_booking
+//DESCRIPTION  : Logs an accepted booking
+//PARAMETERS   : const ClientMessage *msg - booking (clientId assigned)
+//RETURNS      : Nothing
+//
+void binlog_booking(const ClientMessage *msg) {
+    BinlogBooking rec;
+    size_t n = strnlen(msg->destination, MAX_NAME - 1);
+    size_t length = offsetof(BinlogBooking, destination) + n;
+
+    rec.clientId   = msg->clientId;
+    rec.numPeople  = msg->numPeople;
+    rec.priceCents = msg->priceCents;
+    rec.destLength = (uint8_t)n;
+    memcpy(rec.destination, msg->destination, n);
+    memset((uint8_t *)&rec + length, 0, ((length + 7) & ~(size_t)7) - length);
+    log_record(&rec, BINLOG_BOOKING, length);
+}
+
+//
+//FUNCTION     : binlog_batch
+//DESCRIPTION  : Logs the result of one FRAME_BATCH
+//PARAMETERS   : int clientId - client, int count - records in the batch
+//              int accepted, int rejected - outcome
+//              int64_t cents - revenue of the accepted records
+//RETURNS      : Nothing
+//
+void binlog_batch(int clientId, int count, int accepted, int rejected, int64_t cents) {
+    BinlogBatch rec;
+
+    rec.clientId = clientId;
+    rec.count    = (uint16_t)count;
+    rec.accepted = (uint16_t)accepted;
+    rec.rejected = (uint16_t)rejected;
+    rec.reserved = 0;
+    rec.cents    = cents;
+    log_record(&rec, BINLOG_BATCH, sizeof(rec));
+}
+
+//
+//FUNCTION     : binlog_connection
+//DESCRIPTION  : Logs a connection accepted or closed
+//PARAMETERS   : int type - BINLOG_CONNECT or BINLOG_CLOSE
+//              int clientId - client
+//              uint32_t addr - IPv4 address, network byte order (0 on close)
+//RETURNS      : Nothing
+//
+void binlog_connection(int type, int clientId, uint32_t addr) {
+    BinlogConnection rec;
+
+    rec.clientId = clientId;
+    rec.addr     = addr;
+    log_record(&rec, (uint8_t)type, sizeof(rec));
+}
+
+//
+//FUNCTION     : emit_line
+//DESCRIPTION  : Logs the calling thread's collected text as one record
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+static void emit_line(void) {
+    BinlogText rec;
+
+    //Blank lines only spaced out the screen
+    if (line_length > 0 && !(line_length == 1 && line[0] == '\n')) {
+        memcpy(rec.text, line, (size_t)line_length);
+        rec.text[line_length] = '\0';
+
+        size_t length = sizeof(BinlogHeader) + (size_t)line_length + 1;
+        size_t padded = (length + 7) & ~(size_t)7;
+        memset((uint8_t *)&rec + length, 0, padded - length);
+        log_record(&rec, BINLOG_TEXT, length);
+    }
+    line_length = 0;
+}
+
+//
+//FUNCTION     : binlog_text
+//DESCRIPTION  : Logs a formatted message. Messages printed in pieces are
+//              collected per thread and logged as one record when the
+//              line ends (or reaches BINLOG_TEXT_MAX - 1 bytes).
+//PARAMETERS   : const char *fmt, va_list args - format and arguments
+//RETURNS      : Nothing
+//
+void binlog_text(const char *fmt, va_list args) {
+    int room = BINLOG_TEXT_MAX - line_length;
+    int n = vsnprintf(line + line_length, (size_t)room, fmt, args);
+
+    if (n < 0) {
+        return;
+    }
+    line_length += n < room ? n : room - 1;
+    if (n >= room - 1 || (line_length > 0 && line[line_length - 1] == '\n')) {
+        emit_line();
+    }
+}
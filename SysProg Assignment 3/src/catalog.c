@@ -0,0 +1,1541 @@
+//
+//FILE               : catalog.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Rodrigo P Gomes
+//FIRST VERSION      : 2025-12-06
+//DESCRIPTION        : Trip catalog kept in a POSIX shared memory segment
+//                     that grows online. Writers serialize on a
+//                     process-shared rwlock and bump a sequence counter;
+//                     readers copy records without locking and retry on
+//                     a torn read, remapping first if the segment grew.
+//                     A hash index on destination inside the segment gives
+//                     constant-time lookups at any catalog size,
+//                     price/active columns feed the SIMD scans in scan.c,
+//                     and sorted slot orders feed the queries in search.c.
+//                     Deleted slots go on an intrusive free list and are
+//                     reused; a dense live list lets readers skip them.
+//                     Seats are reserved per trip with compare-and-swap,
+//                     so bookings never take the writer lock.
+//                     catalog_save/catalog_restore keep a checksummed
+//                     copy of the segment in a memory-mapped file.
+//                     catalog_publish swaps in a catalog built off-line
+//                     as a whole; attached processes move to it on their
+//                     next read or edit.
+//
+
+#define _GNU_SOURCE
+#include "catalog.h"
+#include "scan.h"
+#include <stddef.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <time.h>
+
+//Where POSIX shared memory objects live, for renaming them
+#define SHM_DIR "/dev/shm"
+
+//Trip array starts on its own cache line after the header; so does
+//every region after it
+#define ALIGN64(x) (((x) + 63) & ~(uint64_t)63)
+#define TRIPS_OFFSET ALIGN64(sizeof(CatalogHeader))
+
+//Offsets of the regions that follow the Trip array for one capacity
+typedef struct {
+    uint64_t index, prices, active, names, byName, byPrice, live, links, end;
+} Regions;
+
+//
+//FUNCTION     : index_slots
+//DESCRIPTION  : Hash index size for a capacity (power of two, load <= 1/2)
+//PARAMETERS   : uint32_t capacity - trip slots
+//RETURNS      : uint32_t - index slots
+//
+static uint32_t index_slots(uint32_t capacity) {
+    uint32_t slots = 16;
+
+    while (slots < capacity * 2) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+//
+//FUNCTION     : regions
+//DESCRIPTION  : Lays out the index, the columns, the sorted orders and
+//              the live/free lists after the Trip array
+//PARAMETERS   : uint32_t capacity - trip slots
+//RETURNS      : Regions - offsets, end = segment size
+//
+static Regions regions(uint32_t capacity) {
+    Regions r;
+
+    r.index  = TRIPS_OFFSET + (uint64_t)capacity * sizeof(Trip);
+    r.prices = ALIGN64(r.index + (uint64_t)index_slots(capacity) * sizeof(uint32_t));
+    r.active = ALIGN64(r.prices + (uint64_t)capacity * sizeof(int32_t));
+    r.names  = ALIGN64(r.active + (uint64_t)(capacity + 63) / 64 * sizeof(uint64_t));
+    r.byName  = ALIGN64(r.names + (uint64_t)capacity * sizeof(uint32_t));
+    r.byPrice = ALIGN64(r.byName + (uint64_t)capacity * sizeof(uint32_t));
+    r.live    = ALIGN64(r.byPrice + (uint64_t)capacity * sizeof(uint32_t));
+    r.links   = ALIGN64(r.live + (uint64_t)capacity * sizeof(uint32_t));
+    r.end     = ALIGN64(r.links + (uint64_t)capacity * sizeof(uint32_t));
+    return r;
+}
+
+//
+//FUNCTION     : segment_size
+//DESCRIPTION  : Bytes needed for a catalog with the given capacity
+//PARAMETERS   : uint32_t capacity - trip slots
+//RETURNS      : size_t - segment size
+//
+static size_t segment_size(uint32_t capacity) {
+    return (size_t)regions(capacity).end;
+}
+
+//
+//FUNCTION     : column
+//DESCRIPTION  : Locates a column in the local mapping (range checked like
+//              catalog_records)
+//PARAMETERS   : Catalog *cat - attachment, uint64_t offset - column start
+//              uint64_t bytes - column length
+//RETURNS      : void * - column, NULL if it is not mapped
+//
+static void *column(Catalog *cat, uint64_t offset, uint64_t bytes) {
+    if (offset > cat->mapSize || bytes > cat->mapSize - offset) {
+        return NULL;
+    }
+    return (char *)cat->hdr + offset;
+}
+
+//
+//FUNCTION     : column_set
+//DESCRIPTION  : Copies one slot's price, active flag and name offset into
+//              the columns. Writers only.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//RETURNS      : Nothing
+//
+static void column_set(Catalog *cat, uint32_t slot) {
+    CatalogHeader *hdr = cat->hdr;
+    Trip *trip = &catalog_records(cat, slot + 1)[slot];
+    int32_t *prices  = (int32_t *)((char *)hdr + hdr->pricesOffset);
+    uint64_t *active = (uint64_t *)((char *)hdr + hdr->activeOffset);
+    uint32_t *names  = (uint32_t *)((char *)hdr + hdr->namesOffset);
+
+    prices[slot] = trip->priceCents > INT32_MAX ? INT32_MAX : (int32_t)trip->priceCents;
+    names[slot]  = (uint32_t)(hdr->tripsOffset + (uint64_t)slot * sizeof(Trip) +
+                              offsetof(Trip, destination));
+    if (trip->active) {
+        active[slot >> 6] |= 1ull << (slot & 63);
+    } else {
+        active[slot >> 6] &= ~(1ull << (slot & 63));
+    }
+}
+
+//
+//FUNCTION     : hash_name
+//DESCRIPTION  : FNV-1a hash of a destination name
+//PARAMETERS   : const char *name - destination
+//RETURNS      : uint32_t - hash
+//
+static uint32_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < MAX_NAME && name[i] != '\0'; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : index_table
+//DESCRIPTION  : Locates the hash index in the local mapping (range checked
+//              like catalog_records)
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : uint32_t * - index, NULL if it is not mapped
+//
+static uint32_t *index_table(Catalog *cat) {
+    uint64_t offset = cat->hdr->indexOffset;
+    uint32_t slots  = cat->hdr->indexSlots;
+
+    if (slots == 0 || (slots & (slots - 1)) != 0 || offset > cat->mapSize ||
+        slots > (cat->mapSize - offset) / sizeof(uint32_t)) {
+        return NULL;
+    }
+    return (uint32_t *)((char *)cat->hdr + offset);
+}
+
+//
+//FUNCTION     : index_insert
+//DESCRIPTION  : Adds a trip to the destination index. A destination that
+//              is already indexed keeps its first slot. Writers only.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//RETURNS      : Nothing
+//
+static void index_insert(Catalog *cat, uint32_t slot) {
+    uint32_t *table = index_table(cat);
+    Trip *trips = catalog_records(cat, cat->hdr->tripCount);
+    uint32_t mask = cat->hdr->indexSlots - 1;
+    uint32_t h = hash_name(trips[slot].destination) & mask;
+
+    while (table[h] != 0) {
+        if (strncmp(trips[table[h] - 1].destination, trips[slot].destination, MAX_NAME) == 0) {
+            return;
+        }
+        h = (h + 1) & mask;
+    }
+    table[h] = slot + 1;
+}
+
+//
+//FUNCTION     : index_remove
+//DESCRIPTION  : Drops a trip from the destination index, shifting later
+//              entries of the probe run back so no tombstones are needed.
+//              Call while the trip still holds its indexed destination.
+//              Writers only.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//RETURNS      : Nothing
+//
+static void index_remove(Catalog *cat, uint32_t slot) {
+    uint32_t *table = index_table(cat);
+    Trip *trips = catalog_records(cat, cat->hdr->tripCount);
+    uint32_t mask = cat->hdr->indexSlots - 1;
+    uint32_t h = hash_name(trips[slot].destination) & mask;
+
+    while (table[h] != slot + 1) {
+        if (table[h] == 0) {
+            return;             //Not indexed (duplicate destination)
+        }
+        h = (h + 1) & mask;
+    }
+
+    table[h] = 0;
+    for (uint32_t j = (h + 1) & mask; table[j] != 0; j = (j + 1) & mask) {
+        uint32_t home = hash_name(trips[table[j] - 1].destination) & mask;
+
+        //The entry at j may fill the hole unless its home lies
+        //(cyclically) in (h, j]
+        int stays = (h <= j) ? (home > h && home <= j) : (home > h || home <= j);
+        if (!stays) {
+            table[h] = table[j];
+            table[j] = 0;
+            h = j;
+        }
+    }
+}
+
+//
+//FUNCTION     : live_add / live_remove
+//DESCRIPTION  : Adds a slot to the end of the live list, or swaps the
+//              last live slot into its place and pushes it on the free
+//              list. Both are O(1). Writers only.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//RETURNS      : Nothing
+//
+static void live_add(Catalog *cat, uint32_t slot) {
+    CatalogHeader *hdr = cat->hdr;
+    uint32_t *live  = (uint32_t *)((char *)hdr + hdr->liveOffset);
+    uint32_t *links = (uint32_t *)((char *)hdr + hdr->linksOffset);
+
+    live[hdr->liveCount] = slot;
+    links[slot] = hdr->liveCount++;
+}
+
+static void live_remove(Catalog *cat, uint32_t slot) {
+    CatalogHeader *hdr = cat->hdr;
+    uint32_t *live  = (uint32_t *)((char *)hdr + hdr->liveOffset);
+    uint32_t *links = (uint32_t *)((char *)hdr + hdr->linksOffset);
+    uint32_t pos  = links[slot];
+    uint32_t last = live[--hdr->liveCount];
+
+    live[pos] = last;
+    links[last] = pos;
+    links[slot] = hdr->freeHead;
+    hdr->freeHead = slot + 1;
+}
+
+//
+//FUNCTION     : derived_build
+//DESCRIPTION  : Places the index, the columns, the sorted orders and the
+//              live/free lists after the Trip array for the current
+//              capacity and fills the index, columns and lists from the
+//              trips (the orders are re-sorted by catalog_write_end).
+//              Writers only.
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : Nothing
+//
+static void derived_build(Catalog *cat) {
+    CatalogHeader *hdr = cat->hdr;
+    Regions r = regions(hdr->capacity);
+
+    hdr->indexOffset  = r.index;
+    hdr->indexSlots   = index_slots(hdr->capacity);
+    hdr->pricesOffset = r.prices;
+    hdr->activeOffset = r.active;
+    hdr->namesOffset  = r.names;
+    hdr->byNameOffset  = r.byName;
+    hdr->byPriceOffset = r.byPrice;
+    hdr->sortedCount   = 0;
+    hdr->liveOffset    = r.live;
+    hdr->linksOffset   = r.links;
+    hdr->liveCount     = 0;
+    hdr->freeHead      = 0;
+    cat->rebuild = 1;
+    memset((char *)hdr + r.index, 0, (size_t)(r.end - r.index));
+
+    //Free slots are pushed from the top so the lowest is reused first
+    Trip *trips = catalog_records(cat, hdr->tripCount);
+    uint32_t *links = (uint32_t *)((char *)hdr + r.links);
+    for (uint32_t i = 0; i < hdr->tripCount; i++) {
+        column_set(cat, i);
+        if (trips[i].active) {
+            index_insert(cat, i);
+            live_add(cat, i);
+        }
+    }
+    for (uint32_t i = hdr->tripCount; i-- > 0; ) {
+        if (!trips[i].active) {
+            links[i] = hdr->freeHead;
+            hdr->freeHead = i + 1;
+        }
+    }
+}
+
+//
+//FUNCTION     : compare_slot / compare_name / compare_price
+//DESCRIPTION  : qsort_r orderings of slots: by slot, by destination, and
+//              by price then slot
+//PARAMETERS   : const void *a, *b - slots, void *arg - Catalog
+//RETURNS      : int - <0, 0, >0
+//
+static int compare_slot(const void *a, const void *b, void *arg) {
+    uint32_t sa = *(const uint32_t *)a, sb = *(const uint32_t *)b;
+
+    (void)arg;
+    return sa < sb ? -1 : (sa > sb);
+}
+
+static int compare_name(const void *a, const void *b, void *arg) {
+    Catalog *cat = arg;
+    Trip *trips = catalog_records(cat, cat->hdr->tripCount);
+
+    return strncmp(trips[*(const uint32_t *)a].destination,
+                   trips[*(const uint32_t *)b].destination, MAX_NAME);
+}
+
+static int compare_price(const void *a, const void *b, void *arg) {
+    Catalog *cat = arg;
+    const int32_t *prices = (const int32_t *)((char *)cat->hdr + cat->hdr->pricesOffset);
+    uint32_t sa = *(const uint32_t *)a, sb = *(const uint32_t *)b;
+
+    if (prices[sa] != prices[sb]) {
+        return prices[sa] < prices[sb] ? -1 : 1;
+    }
+    return sa < sb ? -1 : (sa > sb);
+}
+
+//
+//FUNCTION     : order_touch
+//DESCRIPTION  : Records that a slot's name, price or active flag changed
+//              so catalog_write_end re-sorts it. Writers only.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//RETURNS      : Nothing
+//
+static void order_touch(Catalog *cat, uint32_t slot) {
+    if (cat->rebuild) {
+        return;
+    }
+    if (cat->pendingCount == cat->pendingCap) {
+        uint32_t newCap = cat->pendingCap ? cat->pendingCap * 2 : 64;
+        uint32_t *grown = realloc(cat->pending, (size_t)newCap * sizeof(uint32_t));
+        if (grown == NULL) {
+            cat->rebuild = 1;       //Fall back to a full sort
+            return;
+        }
+        cat->pending = grown;
+        cat->pendingCap = newCap;
+    }
+    cat->pending[cat->pendingCount++] = slot;
+}
+
+//
+//FUNCTION     : bsearch_slot
+//DESCRIPTION  : Binary search in an ascending list of slots
+//PARAMETERS   : const uint32_t *slots, uint32_t n, uint32_t slot
+//RETURNS      : int - 1 if present, 0 otherwise
+//
+static int bsearch_slot(const uint32_t *slots, uint32_t n, uint32_t slot) {
+    uint32_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (slots[mid] < slot) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < n && slots[lo] == slot;
+}
+
+//
+//FUNCTION     : order_merge
+//DESCRIPTION  : Merges the changed slots back into one sorted order in
+//              place: the entries that changed are dropped, then each
+//              changed slot still active is binary searched into the rest,
+//              moving the tail once per insertion (last one first)
+//PARAMETERS   : Catalog *cat - attachment, uint32_t *order - sorted slots
+//              (room for count + nInsert), uint32_t count - entries
+//              const uint32_t *changed, uint32_t nChanged - changed slots
+//              sorted by slot
+//              const uint32_t *insert, uint32_t nInsert - active changed
+//              slots sorted by the order's comparator
+//              int (*cmp) - the order's comparator
+//RETURNS      : uint32_t - entries in the merged order
+//
+static uint32_t order_merge(Catalog *cat, uint32_t *order, uint32_t count,
+                            const uint32_t *changed, uint32_t nChanged,
+                            const uint32_t *insert, uint32_t nInsert,
+                            int (*cmp)(const void *, const void *, void *)) {
+    uint32_t kept = 0;
+    uint32_t minChanged = nChanged ? changed[0] : UINT32_MAX;
+
+    //Appended slots were never in the order, so this is usually one
+    //compare per entry
+    for (uint32_t i = 0; i < count; i++) {
+        if (order[i] < minChanged || !bsearch_slot(changed, nChanged, order[i])) {
+            order[kept++] = order[i];
+        }
+    }
+
+    uint32_t end = kept;
+    for (uint32_t j = nInsert; j-- > 0; ) {
+        uint32_t lo = 0, hi = end;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (cmp(&order[mid], &insert[j], cat) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        memmove(&order[lo + j + 1], &order[lo], (size_t)(end - lo) * sizeof(uint32_t));
+        order[lo + j] = insert[j];
+        end = lo;
+    }
+    return kept + nInsert;
+}
+
+//
+//FUNCTION     : order_build
+//DESCRIPTION  : Brings byName and byPrice up to date before an edit is
+//              published. Slots changed in the write section are sorted
+//              on their own and merged into the existing orders, so an
+//              edit of k trips costs O(k log n) compares plus moving the
+//              n entries once; after a resize (or if
+//              tracking ran out of memory) both orders are sorted from
+//              scratch. Writers only.
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : Nothing
+//
+static void order_build(Catalog *cat) {
+    CatalogHeader *hdr = cat->hdr;
+    uint32_t *byName  = (uint32_t *)((char *)hdr + hdr->byNameOffset);
+    uint32_t *byPrice = (uint32_t *)((char *)hdr + hdr->byPriceOffset);
+    Trip *trips = catalog_records(cat, hdr->tripCount);
+    uint32_t *insert = NULL;
+    uint32_t n = 0;
+
+    if (!cat->rebuild) {
+        insert = malloc((size_t)cat->pendingCount * sizeof(uint32_t));
+    }
+
+    if (insert == NULL) {
+        //Full rebuild
+        for (uint32_t i = 0; i < hdr->tripCount; i++) {
+            if (trips[i].active) {
+                byName[n++] = i;
+            }
+        }
+        memcpy(byPrice, byName, (size_t)n * sizeof(uint32_t));
+        qsort_r(byName, n, sizeof(uint32_t), compare_name, cat);
+        qsort_r(byPrice, n, sizeof(uint32_t), compare_price, cat);
+    } else {
+        //Changed slots, deduplicated, then the active ones in each order
+        uint32_t *changed = cat->pending, nChanged = 0, nInsert = 0;
+
+        qsort_r(changed, cat->pendingCount, sizeof(uint32_t), compare_slot, NULL);
+        for (uint32_t i = 0; i < cat->pendingCount; i++) {
+            if (nChanged == 0 || changed[nChanged - 1] != changed[i]) {
+                changed[nChanged++] = changed[i];
+            }
+        }
+        for (uint32_t i = 0; i < nChanged; i++) {
+            if (trips[changed[i]].active) {
+                insert[nInsert++] = changed[i];
+            }
+        }
+
+        qsort_r(insert, nInsert, sizeof(uint32_t), compare_name, cat);
+        n = order_merge(cat, byName, hdr->sortedCount, changed, nChanged,
+                        insert, nInsert, compare_name);
+        qsort_r(insert, nInsert, sizeof(uint32_t), compare_price, cat);
+        order_merge(cat, byPrice, hdr->sortedCount, changed, nChanged,
+                    insert, nInsert, compare_price);
+        free(insert);
+    }
+
+    hdr->sortedCount = n;
+    cat->rebuild = 0;
+    cat->pendingCount = 0;
+}
+
+//
+//FUNCTION     : lock_init
+//DESCRIPTION  : Initializes the writer lock embedded in the header. It is
+//              process-shared and prefers writers. Uncontended acquire and
+//              release are userspace atomics (no syscall).
+//PARAMETERS   : CatalogHeader *hdr - new segment header
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int lock_init(CatalogHeader *hdr) {
+    pthread_rwlockattr_t attr;
+    int rc;
+
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    rc = pthread_rwlock_init(&hdr->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    if (rc != 0) {
+        fprintf(stderr, "pthread_rwlock_init: %s\n", strerror(rc));
+        return -1;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : segment_map
+//DESCRIPTION  : Creates (or replaces) a segment of the given size and
+//              maps it
+//PARAMETERS   : Catalog *cat - receives fd, mapping and size
+//              const char *name - shm_open name, size_t size - bytes
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int segment_map(Catalog *cat, const char *name, size_t size) {
+    cat->fd = shm_open(name, O_CREAT | O_RDWR, PERMISSIONS);
+    if (cat->fd == -1) {
+        perror("shm_open");
+        return -1;
+    }
+    if (ftruncate(cat->fd, (off_t)size) == -1) {
+        perror("ftruncate");
+        close(cat->fd);
+        return -1;
+    }
+
+    cat->hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cat->fd, 0);
+    if (cat->hdr == MAP_FAILED) {
+        perror("mmap catalog");
+        close(cat->fd);
+        return -1;
+    }
+    cat->mapSize = size;
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_create
+//DESCRIPTION  : Creates (or replaces) the catalog segment and initializes
+//              an empty catalog in it
+//PARAMETERS   : Catalog *cat - receives the attachment
+//              const char *name - shm_open name, CATALOG_SHM_NAME normally
+//              uint32_t capacity - initial trip slots
+//RETURNS      : int - 0 on success, -1 on error
+//
+int catalog_create(Catalog *cat, const char *name, uint32_t capacity) {
+    if (capacity < 1) {
+        capacity = CATALOG_INITIAL_CAPACITY;
+    }
+    size_t size = segment_size(capacity);
+
+    if (segment_map(cat, name, size) == -1) {
+        return -1;
+    }
+
+    CatalogHeader *hdr = cat->hdr;
+    memset(hdr, 0, sizeof(CatalogHeader));
+    if (lock_init(hdr) == -1) {
+        catalog_close(cat);
+        return -1;
+    }
+    hdr->magic       = CATALOG_MAGIC;
+    hdr->layout      = CATALOG_LAYOUT;
+    hdr->capacity    = capacity;
+    hdr->tripCount   = 0;
+    hdr->tripsOffset = TRIPS_OFFSET;
+    atomic_init(&hdr->seq, 0);
+    atomic_init(&hdr->generation, 1);
+    atomic_init(&hdr->size, size);
+    derived_build(cat);
+    cat->name = name;
+    cat->generation = 1;
+    cat->pending = NULL;
+    cat->pendingCount = cat->pendingCap = 0;
+    cat->lockedAt = 0;
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_open
+//DESCRIPTION  : Attaches an existing catalog segment
+//PARAMETERS   : Catalog *cat - receives the attachment
+//              const char *name - shm_open name
+//RETURNS      : int - 0 on success, -1 if missing (errno ENOENT) or invalid
+//
+int catalog_open(Catalog *cat, const char *name) {
+    struct stat st;
+
+    cat->fd = shm_open(name, O_RDWR, PERMISSIONS);
+    if (cat->fd == -1) {
+        return -1;
+    }
+    if (fstat(cat->fd, &st) == -1 || (size_t)st.st_size < sizeof(CatalogHeader)) {
+        close(cat->fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    cat->mapSize = (size_t)st.st_size;
+    cat->hdr = mmap(NULL, cat->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, cat->fd, 0);
+    if (cat->hdr == MAP_FAILED) {
+        close(cat->fd);
+        return -1;
+    }
+
+    if (cat->hdr->magic != CATALOG_MAGIC || cat->hdr->layout != CATALOG_LAYOUT) {
+        fprintf(stderr, "Catalog %s has an unknown layout; recreate it with shm_manager\n",
+                name);
+        catalog_close(cat);
+        errno = EINVAL;
+        return -1;
+    }
+    cat->name = name;
+    cat->generation = atomic_load(&cat->hdr->generation);
+    cat->rebuild = 0;
+    cat->pending = NULL;
+    cat->pendingCount = cat->pendingCap = 0;
+    cat->lockedAt = 0;
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_close
+//DESCRIPTION  : Detaches from the catalog (the segment stays)
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : Nothing
+//
+void catalog_close(Catalog *cat) {
+    if (cat->hdr != NULL && cat->hdr != MAP_FAILED) {
+        munmap(cat->hdr, cat->mapSize);
+    }
+    if (cat->fd != -1) {
+        close(cat->fd);
+    }
+    free(cat->pending);
+    cat->hdr = NULL;
+    cat->fd  = -1;
+    cat->mapSize = 0;
+    cat->pending = NULL;
+    cat->pendingCount = cat->pendingCap = 0;
+    cat->lockedAt = 0;
+}
+
+//
+//FUNCTION     : catalog_remove
+//DESCRIPTION  : Removes the catalog segment name; attached processes keep
+//              their mappings until they detach
+//PARAMETERS   : const char *name - shm_open name
+//RETURNS      : int - 0 on success, -1 on error
+//
+int catalog_remove(const char *name) {
+    return shm_unlink(name);
+}
+
+//
+//FUNCTION     : catalog_reopen
+//DESCRIPTION  : Moves an attachment from a retired segment to the catalog
+//              now published under its name. The old mapping is dropped
+//              here; the segment is freed once no process maps it.
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : int - 1 on success, -1 on error
+//
+static int catalog_reopen(Catalog *cat) {
+    Catalog fresh = { -1, NULL, 0, 0 };
+
+    if (cat->name == NULL || catalog_open(&fresh, cat->name) == -1) {
+        perror("reopen catalog");
+        return -1;
+    }
+    catalog_close(cat);
+    *cat = fresh;
+    return 1;
+}
+
+//
+//FUNCTION     : catalog_refresh
+//DESCRIPTION  : Remaps the local view if another process grew the segment,
+//              or reopens the catalog if a new one was published
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : int - 1 if remapped, 0 if already current, -1 on error
+//
+int catalog_refresh(Catalog *cat) {
+    unsigned int generation = atomic_load(&cat->hdr->generation);
+    size_t size = (size_t)atomic_load(&cat->hdr->size);
+
+    if (generation == cat->generation && size == cat->mapSize) {
+        return 0;
+    }
+    if (atomic_load(&cat->hdr->retired)) {
+        return catalog_reopen(cat);
+    }
+    if (size != cat->mapSize) {
+        void *map = mremap(cat->hdr, cat->mapSize, size, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED) {
+            perror("mremap catalog");
+            return -1;
+        }
+        cat->hdr = map;
+        cat->mapSize = size;
+    }
+    cat->generation = generation;
+    return 1;
+}
+
+//
+//FUNCTION     : catalog_read_lock / catalog_write_lock / catalog_unlock
+//DESCRIPTION  : Shared or exclusive access through the rwlock. Readers use
+//              catalog_read_begin() instead; the reader lock is kept for
+//              comparison in the bench. Writers record how long they
+//              waited for the lock and held it in the segment header.
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : Nothing (exits on error)
+//
+void catalog_read_lock(Catalog *cat) {
+    int rc = pthread_rwlock_rdlock(&cat->hdr->lock);
+
+    if (rc != 0) {
+        fprintf(stderr, "catalog read lock: %s\n", strerror(rc));
+        exit(1);
+    }
+}
+
+void catalog_write_lock(Catalog *cat) {
+    uint64_t start = monotonic_ns();
+    int rc = pthread_rwlock_wrlock(&cat->hdr->lock);
+
+    if (rc != 0) {
+        fprintf(stderr, "catalog write lock: %s\n", strerror(rc));
+        exit(1);
+    }
+    cat->lockedAt = monotonic_ns();
+    hist_record(&cat->hdr->lockWait, cat->lockedAt - start, 1);
+}
+
+void catalog_unlock(Catalog *cat) {
+    if (cat->lockedAt != 0) {
+        hist_record(&cat->hdr->lockHold, monotonic_ns() - cat->lockedAt, 1);
+        cat->lockedAt = 0;
+    }
+
+    int rc = pthread_rwlock_unlock(&cat->hdr->lock);
+
+    if (rc != 0) {
+        fprintf(stderr, "catalog unlock: %s\n", strerror(rc));
+        exit(1);
+    }
+}
+
+//
+//FUNCTION     : catalog_write_begin
+//DESCRIPTION  : Takes the writer lock, catches up with any growth by an
+//              earlier writer (or a newly published catalog) and makes the
+//              sequence odd so lock-free readers discard any copy that
+//              overlaps the edit
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : unsigned int - catalog version the edit publishes; store
+//              it in Trip.version of every trip changed (exits on error)
+//
+unsigned int catalog_write_begin(Catalog *cat) {
+    catalog_write_lock(cat);
+    while (atomic_load(&cat->hdr->retired)) {
+        catalog_unlock(cat);
+        if (catalog_reopen(cat) == -1) {
+            exit(1);
+        }
+        catalog_write_lock(cat);
+    }
+    if (catalog_refresh(cat) == -1) {
+        exit(1);
+    }
+    unsigned int seq = atomic_fetch_add_explicit(&cat->hdr->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return seq + 2;
+}
+
+//
+//FUNCTION     : catalog_write_end
+//DESCRIPTION  : Updates the sorted orders if trips changed (the O(n)
+//              part of any edit, see order_build), publishes the edit
+//              (sequence even again) and releases the writer lock
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : Nothing (exits on error)
+//
+void catalog_write_end(Catalog *cat) {
+    if (cat->rebuild || cat->pendingCount > 0) {
+        order_build(cat);
+    }
+    atomic_fetch_add_explicit(&cat->hdr->seq, 1, memory_order_release);
+    catalog_unlock(cat);
+}
+
+//
+//FUNCTION     : catalog_grow
+//DESCRIPTION  : Extends the segment to hold at least capacity trips.
+//              Records keep their offsets; the hash index and the
+//              columns are rebuilt after the larger Trip array. Other processes see the new
+//              generation and remap on their next read. Must be called
+//              between write_begin and write_end.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t capacity - slots wanted
+//RETURNS      : int - 0 on success, -1 on error
+//
+int catalog_grow(Catalog *cat, uint32_t capacity) {
+    CatalogHeader *hdr = cat->hdr;
+
+    if (capacity <= hdr->capacity) {
+        return 0;
+    }
+
+    size_t size = segment_size(capacity);
+    if (ftruncate(cat->fd, (off_t)size) == -1) {
+        perror("ftruncate");
+        return -1;
+    }
+    void *map = mremap(cat->hdr, cat->mapSize, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        perror("mremap catalog");
+        return -1;
+    }
+    cat->hdr = hdr = map;
+    cat->mapSize = size;
+
+    hdr->capacity = capacity;
+    derived_build(cat);
+    atomic_store(&hdr->size, size);
+    cat->generation = atomic_fetch_add(&hdr->generation, 1) + 1;
+    return 0;
+}
+
+//
+//FUNCTION     : inventory_store
+//DESCRIPTION  : Publishes a trip's seat inventory for a new version.
+//              Reservations still holding the old version fail their CAS.
+//              Writers only.
+//PARAMETERS   : Trip *rec - record in the segment
+//              unsigned int version - version stamped on the record
+//              int oldSeats - seats before the edit (-1 for a new trip)
+//RETURNS      : Nothing
+//
+static void inventory_store(Trip *rec, unsigned int version, int oldSeats) {
+    _Atomic uint64_t *inventory = (_Atomic uint64_t *)&rec->inventory;
+    uint64_t cur = atomic_load_explicit(inventory, memory_order_acquire);
+    uint64_t next;
+
+    do {
+        int64_t left = rec->seats;
+
+        if (!rec->active) {
+            left = 0;
+        } else if (oldSeats > 0) {
+            //Seats already sold stay sold when the capacity changes
+            left = (int64_t)(uint32_t)cur + rec->seats - oldSeats;
+            if (left < 0) {
+                left = 0;
+            }
+        }
+        next = ((uint64_t)version << 32) | (uint32_t)left;
+    } while (!atomic_compare_exchange_weak_explicit(inventory, &cur, next,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire));
+}
+
+//
+//FUNCTION     : catalog_insert
+//DESCRIPTION  : Adds an active trip: a freed slot is reused if there is
+//              one, otherwise the next slot is taken, doubling the
+//              segment when it is full. Taking the slot is O(1); the
+//              sorted orders are merged at write_end (O(n) per write
+//              section). Must be called between write_begin and
+//              write_end.
+//PARAMETERS   : Catalog *cat - attachment, const Trip *trip - new trip
+//              unsigned int version - value returned by write_begin
+//RETURNS      : int - slot index, -1 on error
+//
+int catalog_insert(Catalog *cat, const Trip *trip, unsigned int version) {
+    CatalogHeader *hdr = cat->hdr;
+    uint32_t slot;
+
+    if (hdr->freeHead != 0) {
+        uint32_t *links = (uint32_t *)((char *)hdr + hdr->linksOffset);
+        slot = hdr->freeHead - 1;
+        hdr->freeHead = links[slot];
+    } else {
+        slot = hdr->tripCount;
+        if (slot == hdr->capacity && catalog_grow(cat, slot * 2) == -1) {
+            return -1;
+        }
+        cat->hdr->tripCount = slot + 1;
+    }
+
+    Trip *rec = catalog_records(cat, slot + 1);
+    rec[slot] = *trip;
+    rec[slot].active  = 1;
+    rec[slot].version = version;
+    inventory_store(&rec[slot], version, -1);
+    column_set(cat, slot);
+    index_insert(cat, slot);
+    live_add(cat, slot);
+    order_touch(cat, slot);
+    return (int)slot;
+}
+
+//
+//FUNCTION     : catalog_update
+//DESCRIPTION  : Replaces the destination, price and seat count of an
+//              active trip, keeping its slot and the seats already sold.
+//              Must be called between write_begin and write_end.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//              const Trip *trip - new destination, price and seats
+//              unsigned int version - value returned by write_begin
+//RETURNS      : int - 0 on success, -1 if the slot is not an active trip
+//
+int catalog_update(Catalog *cat, uint32_t slot, const Trip *trip, unsigned int version) {
+    Trip *rec = catalog_records(cat, cat->hdr->tripCount);
+
+    if (slot >= cat->hdr->tripCount || !rec[slot].active) {
+        return -1;
+    }
+
+    int oldSeats = rec[slot].seats;
+    index_remove(cat, slot);
+    memcpy(rec[slot].destination, trip->destination, MAX_NAME);
+    rec[slot].priceCents = trip->priceCents;
+    rec[slot].seats   = trip->seats;
+    rec[slot].version = version;
+    inventory_store(&rec[slot], version, oldSeats);
+    column_set(cat, slot);
+    index_insert(cat, slot);
+    order_touch(cat, slot);
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_delete
+//DESCRIPTION  : Deactivates a trip and puts its slot on the free list in
+//              O(1); the sorted orders drop it at write_end (O(n) per
+//              write section). The record keeps its data and is stamped
+//              with the version, so bookings quoting it are rejected.
+//              Must be called between write_begin and write_end.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - trip slot
+//              unsigned int version - value returned by write_begin
+//RETURNS      : int - 0 on success, -1 if the slot is not an active trip
+//
+int catalog_delete(Catalog *cat, uint32_t slot, unsigned int version) {
+    Trip *rec = catalog_records(cat, cat->hdr->tripCount);
+
+    if (slot >= cat->hdr->tripCount || !rec[slot].active) {
+        return -1;
+    }
+
+    index_remove(cat, slot);
+    rec[slot].active  = 0;
+    rec[slot].version = version;
+    inventory_store(&rec[slot], version, rec[slot].seats);
+    column_set(cat, slot);
+    live_remove(cat, slot);
+    order_touch(cat, slot);
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_lookup
+//DESCRIPTION  : Looks up a destination in the hash index without the
+//              lock-free read protocol, for writers inside a write
+//              section or on a catalog no one else has attached yet
+//PARAMETERS   : Catalog *cat - attachment, const char *destination
+//RETURNS      : int - 0-based slot, -1 if there is no active trip
+//
+int catalog_lookup(Catalog *cat, const char *destination) {
+    uint32_t *table = index_table(cat);
+    Trip *trips = catalog_records(cat, cat->hdr->tripCount);
+    uint32_t mask = cat->hdr->indexSlots - 1;
+
+    for (uint32_t h = hash_name(destination) & mask; table[h] != 0; h = (h + 1) & mask) {
+        if (strncmp(trips[table[h] - 1].destination, destination, MAX_NAME) == 0) {
+            return (int)table[h] - 1;
+        }
+    }
+    return -1;
+}
+
+//
+//FUNCTION     : catalog_publish
+//DESCRIPTION  : Replaces the live catalog with one built off-line under a
+//              staging name, in one step. Under the old catalog's writer
+//              lock the staged trips are stamped with versions newer than
+//              any the old catalog handed out, the staging segment is
+//              renamed over the live name (atomic), and the old segment
+//              is marked retired with its seat inventories fenced so
+//              in-flight reservations fail. Readers finish their current
+//              copy of the old catalog and reopen the new one by name on
+//              their next read; nobody ever sees a half-loaded catalog.
+//              The staged catalog must not be in a write section.
+//PARAMETERS   : Catalog *staged - attachment to the staged catalog; it is
+//              the live catalog afterwards
+//              const char *stagingName - its shm_open name
+//              const char *name - live shm_open name, CATALOG_SHM_NAME
+//RETURNS      : int - 0 on success, -1 on error
+//
+int catalog_publish(Catalog *staged, const char *stagingName, const char *name) {
+    Catalog old = { -1, NULL, 0, 0 };
+    char from[128], to[128];
+    CatalogHeader *hdr = staged->hdr;
+    unsigned int version = atomic_load(&hdr->seq);
+    int hasOld = catalog_open(&old, name) == 0;
+
+    snprintf(from, sizeof(from), SHM_DIR "%s", stagingName);
+    snprintf(to, sizeof(to), SHM_DIR "%s", name);
+
+    if (hasOld) {
+        //Newer than any version the old catalog handed out
+        unsigned int oldVersion = catalog_write_begin(&old);
+        if (oldVersion > version) {
+            version = oldVersion;
+        }
+    }
+
+    //Nobody else maps the staged catalog yet, so no write section
+    Trip *trips = catalog_records(staged, hdr->tripCount);
+    for (uint32_t i = 0; i < hdr->tripCount; i++) {
+        trips[i].version = version;
+        trips[i].inventory = ((uint64_t)version << 32) | (uint32_t)trips[i].inventory;
+    }
+    atomic_store(&hdr->seq, version);
+
+    if (rename(from, to) == -1) {
+        perror("rename staged catalog");
+        if (hasOld) {
+            catalog_write_end(&old);
+            catalog_close(&old);
+        }
+        return -1;
+    }
+    staged->name = name;
+
+    if (hasOld) {
+        Trip *oldTrips = catalog_records(&old, old.hdr->tripCount);
+        for (uint32_t i = 0; i < old.hdr->tripCount; i++) {
+            atomic_store((_Atomic uint64_t *)&oldTrips[i].inventory, 0);
+        }
+        atomic_store(&old.hdr->retired, 1);
+        atomic_fetch_add(&old.hdr->generation, 1);
+        catalog_write_end(&old);
+        catalog_close(&old);
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : catalog_read_begin
+//DESCRIPTION  : Starts a lock-free read: waits out an active writer and
+//              remaps if the segment grew since the last read
+//PARAMETERS   : Catalog *cat - attachment
+//RETURNS      : unsigned int - sequence to pass to catalog_read_retry
+//
+unsigned int catalog_read_begin(Catalog *cat) {
+    while (1) {
+        unsigned int seq = atomic_load_explicit(&cat->hdr->seq, memory_order_acquire);
+        if (seq & 1) {
+            sched_yield();      //Writer in progress
+            continue;
+        }
+        if (atomic_load_explicit(&cat->hdr->generation, memory_order_relaxed) != cat->generation) {
+            if (catalog_refresh(cat) == -1) {
+                exit(1);
+            }
+            continue;
+        }
+        return seq;
+    }
+}
+
+//
+//FUNCTION     : catalog_read_retry
+//DESCRIPTION  : Ends a lock-free read
+//PARAMETERS   : Catalog *cat - attachment
+//              unsigned int seq - value from catalog_read_begin
+//RETURNS      : int - 1 if a writer interfered and the copy must be
+//              discarded, 0 if the copy is consistent
+//
+int catalog_read_retry(Catalog *cat, unsigned int seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&cat->hdr->seq, memory_order_relaxed) != seq;
+}
+
+//
+//FUNCTION     : catalog_records
+//DESCRIPTION  : Locates the Trip array in the local mapping. Values read
+//              during a lock-free read may be torn, so the range is
+//              checked against the mapping before it is used.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t count - slots needed
+//RETURNS      : Trip * - first record, NULL if count slots are not mapped
+//
+Trip *catalog_records(Catalog *cat, uint32_t count) {
+    uint64_t offset = cat->hdr->tripsOffset;
+
+    if (offset > cat->mapSize ||
+        count > (cat->mapSize - offset) / sizeof(Trip)) {
+        return NULL;
+    }
+    return (Trip *)((char *)cat->hdr + offset);
+}
+
+//
+//FUNCTION     : catalog_snapshot
+//DESCRIPTION  : Copies the live trips (walking the live list, not every
+//              slot) without taking any lock. The buffer is grown as
+//              needed and the copy is retried on a torn read.
+//PARAMETERS   : Catalog *cat - attachment
+//              TripMatch **trips, uint32_t *bufCap - caller's buffer (may
+//              start NULL/0), reallocated when too small
+//              uint32_t *count - receives the number of live trips
+//RETURNS      : unsigned int - sequence of the copy (catalog version),
+//              0 with *count 0 if out of memory
+//
+unsigned int catalog_snapshot(Catalog *cat, TripMatch **trips, uint32_t *bufCap, uint32_t *count) {
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        Trip *src;
+
+        if (catalog_columns(cat, &cols) == -1 ||
+            (src = catalog_records(cat, cols.count)) == NULL) {
+            continue;           //Torn header; read it again
+        }
+        if (cols.liveCount > *bufCap) {
+            TripMatch *buf = realloc(*trips, (size_t)cols.liveCount * sizeof(TripMatch));
+            if (buf == NULL) {
+                *count = 0;
+                return 0;
+            }
+            *trips  = buf;
+            *bufCap = cols.liveCount;
+            continue;
+        }
+        for (uint32_t i = 0; i < cols.liveCount; i++) {
+            uint32_t slot = cols.live[i];
+            if (slot < cols.count) {
+                (*trips)[i].slot = slot;
+                (*trips)[i].trip = src[slot];
+            }
+        }
+
+        if (!catalog_read_retry(cat, seq)) {
+            *count = cols.liveCount;
+            return seq;
+        }
+    }
+}
+
+//
+//FUNCTION     : catalog_get_trip
+//DESCRIPTION  : Copies one slot without taking any lock
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - 0-based slot
+//              Trip *trip - receives the record
+//RETURNS      : int - 1 if the slot exists, 0 otherwise
+//
+int catalog_get_trip(Catalog *cat, uint32_t slot, Trip *trip) {
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t n = cat->hdr->tripCount;
+        Trip *src = catalog_records(cat, n);
+        int found = 0;
+
+        if (src != NULL && slot < n) {
+            *trip = src[slot];
+            found = 1;
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            return found;
+        }
+    }
+}
+
+//
+//FUNCTION     : catalog_find_trip
+//DESCRIPTION  : Looks up an active trip by destination through the hash
+//              index, without locking. Probing is bounded by the index
+//              size so a torn read cannot loop forever.
+//PARAMETERS   : Catalog *cat - attachment
+//              const char *destination - name to match
+//              Trip *trip - receives the record
+//RETURNS      : int - 1-based slot, 0 if not found
+//
+int catalog_find_trip(Catalog *cat, const char *destination, Trip *trip) {
+    uint32_t hash = hash_name(destination);
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t n = cat->hdr->tripCount;
+        Trip *src = catalog_records(cat, n);
+        uint32_t *table = index_table(cat);
+        int found = 0;
+
+        if (src != NULL && table != NULL) {
+            uint32_t mask = cat->hdr->indexSlots - 1;
+            uint32_t h = hash & mask;
+
+            for (uint32_t probe = 0; probe <= mask && table[h] != 0; probe++) {
+                uint32_t e = table[h];
+                if (e <= n && src[e - 1].active &&
+                    strncmp(src[e - 1].destination, destination, MAX_NAME) == 0) {
+                    *trip = src[e - 1];
+                    found = (int)e;
+                    break;
+                }
+                h = (h + 1) & mask;
+            }
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            return found;
+        }
+    }
+}
+
+//
+//FUNCTION     : catalog_columns
+//DESCRIPTION  : Locates the columns, sorted orders and live list. Call
+//              between catalog_read_begin and catalog_read_retry; the
+//              pointers are only valid for that read.
+//PARAMETERS   : Catalog *cat - attachment
+//              CatalogColumns *cols - receives the columns
+//RETURNS      : int - 0 on success, -1 if a torn header points outside
+//              the mapping
+//
+int catalog_columns(Catalog *cat, CatalogColumns *cols) {
+    CatalogHeader *hdr = cat->hdr;
+    uint32_t n = hdr->tripCount;
+
+    if (n > hdr->capacity) {
+        return -1;
+    }
+    cols->count  = n;
+    cols->prices = column(cat, hdr->pricesOffset, (uint64_t)n * sizeof(int32_t));
+    cols->active = column(cat, hdr->activeOffset, (uint64_t)(n + 63) / 64 * sizeof(uint64_t));
+    cols->names  = column(cat, hdr->namesOffset, (uint64_t)n * sizeof(uint32_t));
+    cols->sortedCount = hdr->sortedCount;
+    if (cols->sortedCount > n) {
+        return -1;
+    }
+    cols->byName  = column(cat, hdr->byNameOffset, (uint64_t)cols->sortedCount * sizeof(uint32_t));
+    cols->byPrice = column(cat, hdr->byPriceOffset, (uint64_t)cols->sortedCount * sizeof(uint32_t));
+    cols->liveCount = hdr->liveCount;
+    if (cols->liveCount > n) {
+        return -1;
+    }
+    cols->live = column(cat, hdr->liveOffset, (uint64_t)cols->liveCount * sizeof(uint32_t));
+    return (cols->prices && cols->active && cols->names && cols->byName && cols->byPrice &&
+            cols->live) ? 0 : -1;
+}
+
+//
+//FUNCTION     : catalog_under_budget
+//DESCRIPTION  : Finds the active trips priced at or under a budget with a
+//              SIMD scan of the price column, without locking
+//PARAMETERS   : Catalog *cat - attachment
+//              int32_t budgetCents - price limit per person (inclusive)
+//              uint32_t *slots, uint32_t max - receives up to max 0-based
+//              slots in ascending order; NULL to only count
+//RETURNS      : uint32_t - number of matching trips (may exceed max)
+//
+uint32_t catalog_under_budget(Catalog *cat, int32_t budgetCents, uint32_t *slots, uint32_t max) {
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t found = 0;
+
+        if (catalog_columns(cat, &cols) == 0) {
+            found = scan_under_budget(cols.prices, cols.active, cols.count,
+                                      budgetCents, slots, max);
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            return found;
+        }
+    }
+}
+
+//
+//FUNCTION     : catalog_price_range
+//DESCRIPTION  : Cheapest and most expensive active trip, without locking
+//PARAMETERS   : Catalog *cat - attachment
+//              int32_t *minCents, *maxCents - receive the range (0 if empty)
+//RETURNS      : uint32_t - number of active trips
+//
+uint32_t catalog_price_range(Catalog *cat, int32_t *minCents, int32_t *maxCents) {
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t count = 0;
+
+        *minCents = *maxCents = 0;
+        if (catalog_columns(cat, &cols) == 0) {
+            count = scan_price_range(cols.prices, cols.active, cols.count,
+                                     minCents, maxCents);
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            return count;
+        }
+    }
+}
+
+//
+//FUNCTION     : catalog_reserve
+//DESCRIPTION  : Takes seats on a trip with compare-and-swap on its
+//              inventory word, without any lock, so bookings for
+//              different trips never contend and the same trip can never
+//              be oversold. The word carries the trip version: if the trip
+//              was edited, deleted or its slot reused since the caller
+//              read it, the reservation fails instead of landing on the
+//              wrong trip.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - 0-based slot
+//              unsigned int version - Trip.version the caller validated
+//              int seats - seats wanted (> 0)
+//              int *left - receives the seats left afterwards (or now,
+//              if the reservation failed)
+//RETURNS      : int - RESERVE_OK, RESERVE_SOLD_OUT or RESERVE_CHANGED
+//
+int catalog_reserve(Catalog *cat, uint32_t slot, unsigned int version, int seats, int *left) {
+    Trip *rec = catalog_records(cat, slot + 1);
+
+    *left = 0;
+    if (rec == NULL || seats <= 0) {
+        return RESERVE_CHANGED;
+    }
+
+    _Atomic uint64_t *inventory = (_Atomic uint64_t *)&rec[slot].inventory;
+    uint64_t cur = atomic_load_explicit(inventory, memory_order_acquire);
+    uint32_t avail;
+
+    do {
+        avail = (uint32_t)cur;
+        if ((unsigned int)(cur >> 32) != version) {
+            return RESERVE_CHANGED;
+        }
+        if ((uint32_t)seats > avail) {
+            *left = (int)avail;
+            return RESERVE_SOLD_OUT;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(inventory, &cur, cur - (uint32_t)seats,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire));
+    *left = (int)(avail - (uint32_t)seats);
+    return RESERVE_OK;
+}
+
+//
+//FUNCTION     : catalog_release
+//DESCRIPTION  : Gives back seats taken with catalog_reserve when the
+//              booking could not be completed. If the trip was edited in
+//              the meantime its inventory was reset with it, so nothing
+//              is given back.
+//PARAMETERS   : Catalog *cat - attachment, uint32_t slot - 0-based slot
+//              unsigned int version - version passed to catalog_reserve
+//              int seats - seats it took
+//RETURNS      : Nothing
+//
+void catalog_release(Catalog *cat, uint32_t slot, unsigned int version, int seats) {
+    Trip *rec = catalog_records(cat, slot + 1);
+
+    if (rec == NULL || seats <= 0) {
+        return;
+    }
+
+    _Atomic uint64_t *inventory = (_Atomic uint64_t *)&rec[slot].inventory;
+    uint64_t cur = atomic_load_explicit(inventory, memory_order_acquire);
+
+    do {
+        if ((unsigned int)(cur >> 32) != version) {
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(inventory, &cur, cur + (uint32_t)seats,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire));
+}
+
+//
+//FUNCTION     : image_checksum
+//DESCRIPTION  : FNV-1a style checksum of a segment image, eight bytes at
+//              a time (images are a multiple of 64 bytes)
+//PARAMETERS   : const void *data, size_t len - image
+//RETURNS      : uint64_t - checksum
+//
+static uint64_t image_checksum(const void *data, size_t len) {
+    const uint64_t *word = data;
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t i = 0; i < len / sizeof(uint64_t); i++) {
+        h ^= word[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : catalog_save
+//DESCRIPTION  : Writes the catalog to a memory-mapped file: the segment is
+//              copied under the writer lock into a temporary file, its
+//              checksum goes in the file header, the mapping is msync'd
+//              and the file is renamed over the old one, so the file on
+//              disk is always a complete catalog. Call between edits, not
+//              inside write_begin/write_end.
+//PARAMETERS   : Catalog *cat - attachment, const char *path - file
+//RETURNS      : int - 0 on success, -1 on error
+//
+int catalog_save(Catalog *cat, const char *path) {
+    char tmp[512];
+    int rc = -1;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open catalog file");
+        return -1;
+    }
+
+    catalog_write_lock(cat);
+    if (catalog_refresh(cat) == -1) {
+        exit(1);
+    }
+    size_t size = sizeof(CatalogFileHeader) + cat->mapSize;
+    if (ftruncate(fd, (off_t)size) == -1) {
+        perror("ftruncate catalog file");
+        catalog_unlock(cat);
+        close(fd);
+        return -1;
+    }
+    CatalogFileHeader *file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) {
+        perror("mmap catalog file");
+        catalog_unlock(cat);
+        close(fd);
+        return -1;
+    }
+    memcpy(file + 1, cat->hdr, cat->mapSize);
+    catalog_unlock(cat);
+
+    file->magic     = CATALOG_FILE_MAGIC;
+    file->layout    = CATALOG_LAYOUT;
+    file->imageSize = size - sizeof(CatalogFileHeader);
+    file->checksum  = image_checksum(file + 1, file->imageSize);
+    file->savedAt   = (uint64_t)time(NULL);
+
+    if (msync(file, size, MS_SYNC) == -1) {
+        perror("msync catalog file");
+    } else if (rename(tmp, path) == -1) {
+        perror("rename catalog file");
+    } else {
+        rc = 0;
+    }
+    munmap(file, size);
+    close(fd);
+    return rc;
+}
+
+//
+//FUNCTION     : catalog_restore
+//DESCRIPTION  : Recreates the catalog segment from a file written by
+//              catalog_save. The file is mapped, its header and checksum
+//              are checked and the image is copied into a new segment as
+//              is (no parsing); only the lock, the lock histograms and
+//              the counters that describe live processes are reset. The
+//              sequence is kept so the trips' version stamps stay valid.
+//PARAMETERS   : Catalog *cat - receives the attachment
+//              const char *name - shm_open name of the segment to create
+//              const char *path - file
+//RETURNS      : int - 0 on success, -1 if the file is missing (errno
+//              ENOENT), damaged or from another layout (errno EINVAL)
+//
+int catalog_restore(Catalog *cat, const char *name, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) == -1 ||
+        (size_t)st.st_size < sizeof(CatalogFileHeader) + sizeof(CatalogHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const CatalogFileHeader *file = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return -1;
+    }
+
+    const CatalogHeader *image = (const CatalogHeader *)(file + 1);
+    if (file->magic != CATALOG_FILE_MAGIC || file->layout != CATALOG_LAYOUT ||
+        file->imageSize != size - sizeof(CatalogFileHeader) ||
+        image->magic != CATALOG_MAGIC || image->size != file->imageSize ||
+        file->checksum != image_checksum(image, file->imageSize)) {
+        fprintf(stderr, "Catalog file %s is damaged or from another version\n", path);
+        munmap((void *)file, size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (segment_map(cat, name, file->imageSize) == -1) {
+        munmap((void *)file, size);
+        return -1;
+    }
+    memcpy(cat->hdr, image, file->imageSize);
+    munmap((void *)file, size);
+
+    CatalogHeader *hdr = cat->hdr;
+    if (lock_init(hdr) == -1) {
+        catalog_close(cat);
+        return -1;
+    }
+    //Trips keep their version stamps, so the sequence must keep counting
+    //from where the image left it (even: no write in progress) or the
+    //next edit would make every untouched trip look newer than any quote
+    unsigned int seq = atomic_load_explicit(&hdr->seq, memory_order_relaxed);
+    atomic_init(&hdr->seq, (seq + 1) & ~1u);
+    atomic_init(&hdr->generation, 1);
+    atomic_init(&hdr->retired, 0);
+    memset(&hdr->lockWait, 0, sizeof(Histogram));
+    memset(&hdr->lockHold, 0, sizeof(Histogram));
+    cat->name = name;
+    cat->generation = 1;
+    cat->rebuild = 0;
+    cat->pending = NULL;
+    cat->pendingCount = cat->pendingCap = 0;
+    cat->lockedAt = 0;
+    return 0;
+}
@@ -0,0 +1,362 @@
+//
+//FILE          : checkpoint.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 14 2025
+//DESCRIPTION   : Crash recovery for the server totals. BookingTotals
+//               folds journal records into the lifetime totals and
+//               per-destination aggregates; checkpoints save them with
+//               the journal offset they cover. On startup the server
+//               maps the last checkpoint and replays only the journal
+//               records written after it, so restart time depends on
+//               the checkpoint interval, not on the bookings ever taken.
+//
+
+#define _GNU_SOURCE
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REPLAY_CHUNK 4096           //Journal records read per pread()
+
+//
+//FUNCTION     : checkpoint_checksum
+//DESCRIPTION  : FNV-1a hash of the header up to its checksum field and
+//              of the destination totals
+//PARAMETERS   : const CheckpointHeader *hdr - header
+//              const DestinationTotal *dests - hdr->destCount totals
+//RETURNS      : uint64_t - checksum
+//
+static uint64_t checkpoint_checksum(const CheckpointHeader *hdr, const DestinationTotal *dests) {
+    const uint8_t *p = (const uint8_t *)hdr;
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t i = 0; i < offsetof(CheckpointHeader, checksum); i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    p = (const uint8_t *)dests;
+    for (size_t i = 0; i < (size_t)hdr->destCount * sizeof(DestinationTotal); i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : hash_destination
+//DESCRIPTION  : FNV-1a hash of a destination name
+//PARAMETERS   : const char *name - destination
+//RETURNS      : uint32_t - hash
+//
+static uint32_t hash_destination(const char *name) {
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < MAX_NAME && name[i] != '\0'; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : totals_init / totals_free
+//DESCRIPTION  : Starts empty totals (nothing folded in) / releases them
+//PARAMETERS   : BookingTotals *t - totals
+//RETURNS      : Nothing
+//
+void totals_init(BookingTotals *t) {
+    memset(t, 0, sizeof(BookingTotals));
+    t->hdr.magic   = CHECKPOINT_MAGIC;
+    t->hdr.version = CHECKPOINT_VERSION;
+}
+
+void totals_free(BookingTotals *t) {
+    free(t->dests);
+    free(t->index);
+    t->dests = NULL;
+    t->index = NULL;
+    t->destCap = t->indexSlots = 0;
+    t->hdr.destCount = 0;
+}
+
+//
+//FUNCTION     : totals_reindex
+//DESCRIPTION  : Grows the destination array and rebuilds the hash index
+//              for the new capacity
+//PARAMETERS   : BookingTotals *t - totals, uint32_t capacity - destinations
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+static int totals_reindex(BookingTotals *t, uint32_t capacity) {
+    uint32_t slots = 16;
+
+    while (slots < capacity * 2) {
+        slots <<= 1;
+    }
+
+    DestinationTotal *dests = realloc(t->dests, (size_t)capacity * sizeof(DestinationTotal));
+    if (dests == NULL) {
+        return -1;
+    }
+    t->dests = dests;
+    t->destCap = capacity;
+
+    uint32_t *index = calloc(slots, sizeof(uint32_t));
+    if (index == NULL) {
+        return -1;
+    }
+    free(t->index);
+    t->index = index;
+    t->indexSlots = slots;
+
+    for (uint32_t i = 0; i < t->hdr.destCount; i++) {
+        uint32_t h = hash_destination(dests[i].destination) & (slots - 1);
+        while (index[h] != 0) {
+            h = (h + 1) & (slots - 1);
+        }
+        index[h] = i + 1;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : totals_destination
+//DESCRIPTION  : Finds a destination's totals, adding a zeroed entry the
+//              first time it is seen
+//PARAMETERS   : BookingTotals *t - totals, const char *destination
+//RETURNS      : DestinationTotal * - entry, NULL if out of memory
+//
+static DestinationTotal *totals_destination(BookingTotals *t, const char *destination) {
+    if (t->hdr.destCount == t->destCap &&
+        totals_reindex(t, t->destCap ? t->destCap * 2 : 64) == -1) {
+        return NULL;
+    }
+
+    uint32_t mask = t->indexSlots - 1;
+    uint32_t h = hash_destination(destination) & mask;
+    while (t->index[h] != 0) {
+        DestinationTotal *d = &t->dests[t->index[h] - 1];
+        if (strncmp(d->destination, destination, MAX_NAME) == 0) {
+            return d;
+        }
+        h = (h + 1) & mask;
+    }
+
+    DestinationTotal *d = &t->dests[t->hdr.destCount];
+    memset(d, 0, sizeof(DestinationTotal));
+    strncpy(d->destination, destination, MAX_NAME - 1);
+    t->index[h] = ++t->hdr.destCount;
+    return d;
+}
+
+//
+//FUNCTION     : totals_merge
+//DESCRIPTION  : Adds to one destination's totals (the header totals are
+//              left alone)
+//PARAMETERS   : BookingTotals *t - totals, const char *destination
+//              int64_t bookings, int64_t people, int64_t cents - amounts
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int totals_merge(BookingTotals *t, const char *destination,
+                 int64_t bookings, int64_t people, int64_t cents) {
+    DestinationTotal *d = totals_destination(t, destination);
+
+    if (d == NULL) {
+        return -1;
+    }
+    d->bookings += bookings;
+    d->people   += people;
+    d->cents    += cents;
+    return 0;
+}
+
+//
+//FUNCTION     : totals_add
+//DESCRIPTION  : Folds one journal record into the totals
+//PARAMETERS   : BookingTotals *t - totals, const JournalRecord *rec
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int totals_add(BookingTotals *t, const JournalRecord *rec) {
+    if (totals_merge(t, rec->destination, 1, rec->numPeople, rec->priceCents) == -1) {
+        return -1;
+    }
+
+    t->hdr.recordCount++;
+    t->hdr.totalCents += rec->priceCents;
+    if (rec->bookingNumber > t->hdr.lastBookingNumber) {
+        t->hdr.lastBookingNumber = rec->bookingNumber;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : checkpoint_load
+//DESCRIPTION  : Maps a checkpoint file and loads its totals
+//PARAMETERS   : BookingTotals *t - receives the totals (initialized)
+//              const char *path - checkpoint file
+//RETURNS      : int - 0 on success, -1 if missing (errno ENOENT) or
+//              damaged (t is left empty)
+//
+int checkpoint_load(BookingTotals *t, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    totals_init(t);
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const CheckpointHeader *hdr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        return -1;
+    }
+
+    const DestinationTotal *dests = (const DestinationTotal *)(hdr + 1);
+    if (hdr->magic != CHECKPOINT_MAGIC || hdr->version != CHECKPOINT_VERSION ||
+        size != sizeof(CheckpointHeader) + (size_t)hdr->destCount * sizeof(DestinationTotal) ||
+        hdr->checksum != checkpoint_checksum(hdr, dests)) {
+        fprintf(stderr, "Checkpoint %s is damaged or from another version\n", path);
+        munmap((void *)hdr, size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    t->hdr = *hdr;
+    t->hdr.destCount = 0;
+    for (uint32_t i = 0; i < hdr->destCount; i++) {
+        DestinationTotal *d = totals_destination(t, dests[i].destination);
+        if (d == NULL) {
+            munmap((void *)hdr, size);
+            totals_free(t);
+            totals_init(t);
+            errno = ENOMEM;
+            return -1;
+        }
+        *d = dests[i];
+    }
+    munmap((void *)hdr, size);
+    return 0;
+}
+
+//
+//FUNCTION     : checkpoint_save
+//DESCRIPTION  : Writes the totals to path.tmp, syncs it and renames it
+//              over the checkpoint
+//PARAMETERS   : const BookingTotals *t - totals
+//              const char *path - checkpoint file
+//RETURNS      : int - 0 on success, -1 on error
+//
+int checkpoint_save(const BookingTotals *t, const char *path) {
+    char tmpPath[256];
+    CheckpointHeader hdr = t->hdr;
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+
+    hdr.savedAt  = (uint64_t)time(NULL);
+    hdr.checksum = checkpoint_checksum(&hdr, t->dests);
+
+    size_t destBytes = (size_t)hdr.destCount * sizeof(DestinationTotal);
+    if (write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        (destBytes > 0 && write(fd, t->dests, destBytes) != (ssize_t)destBytes) ||
+        fsync(fd) == -1) {
+        close(fd);
+        unlink(tmpPath);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmpPath, path) == -1) {
+        unlink(tmpPath);
+        return -1;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : journal_replay
+//DESCRIPTION  : Folds the journal records after t->hdr.journalOffset into
+//              the totals and advances the offset. The journal is synced
+//              first, so only records already on disk are counted, and
+//              read under a shared flock(): journal_write holds it
+//              exclusively from append to sync, so a group that may yet
+//              fail and be cut back out is never seen.
+//              Replay stops at the first torn or damaged record; at
+//              startup (truncate = 1) the journal is cut back to there so
+//              new records are appended to a clean tail.
+//PARAMETERS   : BookingTotals *t - totals
+//              const char *path - journal file
+//              int truncate - 1 to drop a torn tail (no writers running)
+//RETURNS      : long - records replayed, -1 on error
+//
+long journal_replay(BookingTotals *t, const char *path, int truncate) {
+    static JournalRecord chunk[REPLAY_CHUNK];
+    struct stat st;
+    long replayed = 0;
+    int fd = open(path, truncate ? O_RDWR : O_RDONLY);
+
+    if (fd == -1) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    while (flock(fd, truncate ? LOCK_EX : LOCK_SH) == -1) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (fstat(fd, &st) == -1 || fdatasync(fd) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    uint64_t end = (uint64_t)st.st_size;
+    if (end < t->hdr.journalOffset) {
+        //The journal was replaced or cut; start over on the new file
+        t->hdr.journalOffset = 0;
+    }
+
+    int bad = 0;
+    while (!bad && t->hdr.journalOffset + sizeof(JournalRecord) <= end) {
+        size_t want = (size_t)((end - t->hdr.journalOffset) / sizeof(JournalRecord));
+        if (want > REPLAY_CHUNK) {
+            want = REPLAY_CHUNK;
+        }
+        ssize_t got = pread(fd, chunk, want * sizeof(JournalRecord), (off_t)t->hdr.journalOffset);
+        if (got < (ssize_t)sizeof(JournalRecord)) {
+            break;
+        }
+
+        for (size_t i = 0; i < (size_t)got / sizeof(JournalRecord); i++) {
+            if (chunk[i].magic != JOURNAL_MAGIC ||
+                chunk[i].checksum != journal_checksum(&chunk[i])) {
+                bad = 1;
+                break;
+            }
+            if (totals_add(t, &chunk[i]) == -1) {
+                close(fd);          //Also drops the lock
+                return -1;
+            }
+            t->hdr.journalOffset += sizeof(JournalRecord);
+            replayed++;
+        }
+    }
+
+    if (truncate && t->hdr.journalOffset < end &&
+        ftruncate(fd, (off_t)t->hdr.journalOffset) == -1) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return replayed;
+}
@@ -4,21 +4,27 @@
 //PROGRAMMER    : Josiah Williams
 //FIRST VERSION : 2025-11-08
 //DESCRIPTION   : TCP client that gathers trip and client information,
-//               reads available trips from shared memory, and sends
+//               searches available trips in shared memory, and sends
 //               data to server via socket.
 //               [NCURSES] Enhanced with ncurses GUI windows.
 //
 
 #include "ipc_shared.h"
+#include "protocol.h"
+#include "loadgen.h"
+#include "catalog.h"
+#include "search.h"
 #include <ncurses.h>     //[NCURSES]
+#include <poll.h>
+#include <stdarg.h>
 
 //----------------------------------------------------
 //Global variables
 //----------------------------------------------------
 int client_socket = -1;
-int shmid         = -1;
-int semid         = -1;
-SharedMemory *shm = NULL;
+Catalog cat       = { -1, NULL, 0, 0 };
+unsigned int next_request_id = 0;
+FrameBuffer ack_buffer = { NULL, 0, 0 };
 
 //[NCURSES] Global ncurses windows
 WINDOW *display_win;
@@ -31,27 +37,82 @@ void cleanup(void);
 int  validate_name(char *name);
 int  validate_age(int age);
 void get_client_data(ClientMessage *msg);
+int  parse_price_range(const char *input, int32_t *loCents, int32_t *hiCents);
 void reset_input_window(void);
+int  upload_bookings(const char *server_ip, const char *path);
+void drain_acks(int statsWaitMs);
+void stats_print(const char *fmt, ...);
+void show_stats(const StatsReport *report);
+int  query_stats(const char *server_ip);
 
 //
 //FUNCTION     : main
 //DESCRIPTION  : Entry point for the TCP client.
 //              Connects to shared memory and server, then
 //              enters ncurses-based interaction loop.
-//PARAMETERS   : int argc, char *argv[] - optional server IP
+//PARAMETERS   : int argc, char *argv[] - optional server IP,
+//              --upload FILE to send a CSV of bookings in batches,
+//              --load [--conns N] [--count N] [--rate N] [--batch N]
+//              [--window N] [--csv FILE] for a headless load test,
+//              --stats to print the server's rolling booking rates
 //RETURNS      : int - exit code
 //
 int main(int argc, char *argv[])
 {
     ClientMessage msg;
+    uint8_t frame[PROTO_MAX_BOOKING];
+    int frame_len;
     struct sockaddr_in server_addr;
     char server_ip[20] = "127.0.0.1";    //default localhost
     char cont_input[32];
+    const char *upload_path = NULL;
+    int load_mode = 0;
+    int stats_mode = 0;
+    LoadConfig load = { NULL, NULL, LOAD_DEFAULT_CONNS, LOAD_DEFAULT_COUNT, 0, 1,
+                        LOAD_DEFAULT_WINDOW };
+
+    //Optional server IP, bulk upload file and load test settings
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--upload") == 0 && i + 1 < argc) {
+            upload_path = argv[++i];
+        } else if (strcmp(argv[i], "--load") == 0) {
+            load_mode = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_mode = 1;
+        } else if (strcmp(argv[i], "--conns") == 0 && i + 1 < argc) {
+            load.conns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            load.count = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            load.rate = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            load.batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            load.window = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            load.csvPath = argv[++i];
+        } else {
+            strncpy(server_ip, argv[i], sizeof(server_ip) - 1);
+            server_ip[sizeof(server_ip) - 1] = '\0';
+        }
+    }
 
-    //Optional server IP from command line
-    if (argc > 1) {
-        strncpy(server_ip, argv[1], sizeof(server_ip) - 1);
-        server_ip[sizeof(server_ip) - 1] = '\0';
+    if (upload_path != NULL) {
+        return upload_bookings(server_ip, upload_path);
+    }
+    if (stats_mode) {
+        return query_stats(server_ip);
+    }
+
+    if (load_mode) {
+        if (load.conns < 1 || load.count < 1 || load.rate < 0 || load.window < 1 ||
+            load.batch < 1 || load.batch > PROTO_MAX_BATCH) {
+            fprintf(stderr, "Invalid load settings (batch must be 1-%d).\n",
+                    PROTO_MAX_BATCH);
+            return 1;
+        }
+        load.serverIp = server_ip;
+        return run_load(&load);
     }
 
     printf("=== Client (Writer) ===\n");
@@ -79,32 +140,15 @@ int main(int argc, char *argv[])
     wrefresh(input_win);
 
     //--------------------------------------------------
-    //Attach to shared memory & semaphore
+    //Attach to shared memory (the catalog lock lives inside it)
     //--------------------------------------------------
-    shmid = shmget(SHM_KEY, sizeof(SharedMemory), PERMISSIONS);
-    if (shmid == -1) {
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
         wprintw(display_win, "Error: start shm_manager and create shared memory first.\n");
         wrefresh(display_win);
         endwin();
         return 1;
     }
 
-    shm = (SharedMemory *)shmat(shmid, NULL, 0);
-    if (shm == (void *)-1) {
-        perror("shmat");
-        endwin();
-        return 1;
-    }
-
-    semid = get_semaphore(SEM_KEY);
-    if (semid == -1) {
-        wprintw(display_win, "Semaphore not found! Run shm_manager first.\n");
-        wrefresh(display_win);
-        cleanup();
-        endwin();
-        return 1;
-    }
-
     wprintw(display_win, "Connected to shared memory.\n");
     wrefresh(display_win);
 
@@ -153,6 +197,9 @@ int main(int argc, char *argv[])
     //Main ncurses loop
     //--------------------------------------------------
     for (;;) {
+        //Show acknowledgements for bookings sent so far (pipelined)
+        drain_acks(0);
+
         //Reset command window for menu
         reset_input_window();
         nodelay(input_win, FALSE);   //blocking input
@@ -164,18 +211,17 @@ int main(int argc, char *argv[])
         int ch = wgetch(input_win);
 
         if (ch == KEY_F(1)) {
-            memset(&msg, 0, sizeof(msg));
-            msg.signal = SIGNAL_F1;
-            send(client_socket, &msg, sizeof(msg), 0);
+            frame_len = proto_encode_signal(SIGNAL_F1, frame, sizeof(frame));
+            proto_send_all(client_socket, frame, (size_t)frame_len);
             wprintw(display_win, "\nF1 pressed — closing client.\n");
             wrefresh(display_win);
             break;
         } else if (ch == KEY_F(2)) {
-            memset(&msg, 0, sizeof(msg));
-            msg.signal = SIGNAL_F2;
-            send(client_socket, &msg, sizeof(msg), 0);
+            frame_len = proto_encode_signal(SIGNAL_F2, frame, sizeof(frame));
+            proto_send_all(client_socket, frame, (size_t)frame_len);
             wprintw(display_win, "\nF2 pressed — total requested from server.\n");
             wrefresh(display_win);
+            drain_acks(1000);
             continue;   //back to command menu
         }
 
@@ -184,15 +230,18 @@ int main(int argc, char *argv[])
         msg.signal = 0;
 
         get_client_data(&msg);
+        msg.requestId = ++next_request_id;
 
-        if (send(client_socket, &msg, sizeof(msg), 0) == -1) {
+        frame_len = proto_encode_booking(&msg, frame, sizeof(frame));
+        if (frame_len == -1 ||
+            proto_send_all(client_socket, frame, (size_t)frame_len) == -1) {
             perror("send");
             wprintw(display_win, "\nFailed to send data to server.\n");
             wrefresh(display_win);
             break;
         }
 
-        wprintw(display_win, "\nClient data sent successfully.\n");
+        wprintw(display_win, "\nClient data sent (request %u).\n", msg.requestId);
         wrefresh(display_win);
 
         //Ask if the user wants to enter another client
@@ -227,14 +276,184 @@ int main(int argc, char *argv[])
 //
 void cleanup(void)
 {
-    if (shm != NULL) {
-        shmdt(shm);
-        shm = NULL;
+    if (cat.hdr != NULL) {
+        catalog_close(&cat);
     }
     if (client_socket != -1) {
         close(client_socket);
         client_socket = -1;
     }
+    proto_buffer_free(&ack_buffer);
+}
+
+//
+//FUNCTION     : drain_acks
+//DESCRIPTION  : Displays every booking acknowledgement that has already
+//              arrived, without waiting. Bookings are not sent as a
+//              synchronous round trip; their acks are picked up here.
+//              After F2 it also waits for the server's FRAME_STATS.
+//PARAMETERS   : int statsWaitMs - longest wait for a FRAME_STATS, 0 for none
+//RETURNS      : Nothing
+//
+void drain_acks(int statsWaitMs)
+{
+    struct pollfd pfd = { client_socket, POLLIN, 0 };
+    FrameHeader hdr;
+    BookingAck ack;
+    StatsReport report;
+    uint64_t deadline = monotonic_ns() + (uint64_t)statsWaitMs * 1000000ULL;
+    int wantStats = statsWaitMs > 0;
+
+    for (;;) {
+        int timeoutMs = 0;
+        if (wantStats) {
+            uint64_t now = monotonic_ns();
+            timeoutMs = now < deadline ? (int)((deadline - now) / 1000000ULL) + 1 : 0;
+        }
+        if (poll(&pfd, 1, timeoutMs) != 1) {
+            if (wantStats) {
+                wprintw(display_win, "No statistics from the server.\n");
+            }
+            break;
+        }
+
+        if (proto_buffer_fill(&ack_buffer, client_socket) <= 0) {
+            wprintw(display_win, "\nServer closed the connection.\n");
+            wrefresh(display_win);
+            return;
+        }
+
+        size_t used = 0;
+        while (proto_parse_header(ack_buffer.data + used,
+                                  ack_buffer.len - used, &hdr) == 1) {
+            if (hdr.type == FRAME_ACK &&
+                proto_decode_ack(ack_buffer.data + used + PROTO_HEADER_SIZE,
+                                 hdr.length, &ack) == 0) {
+                if (ack.status == ACK_OK) {
+                    wprintw(display_win, "Request %u confirmed: booking #%llu, $%.2f",
+                            ack.requestId,
+                            (unsigned long long)ack.bookingNumber,
+                            ack.priceCents / 100.0);
+                } else {
+                    wprintw(display_win, "Request %u rejected by server: %s",
+                            ack.requestId, proto_status_text(ack.status));
+                }
+                if (ack.seatsLeft >= 0) {
+                    wprintw(display_win, " (%d seats left)", ack.seatsLeft);
+                }
+                wprintw(display_win, "\n");
+            } else if (hdr.type == FRAME_STATS &&
+                       proto_decode_stats(ack_buffer.data + used + PROTO_HEADER_SIZE,
+                                          hdr.length, &report) == 0) {
+                show_stats(&report);
+                wantStats = 0;
+            }
+            used += PROTO_HEADER_SIZE + hdr.length;
+        }
+        proto_buffer_consume(&ack_buffer, used);
+    }
+    wrefresh(display_win);
+}
+
+//
+//FUNCTION     : stats_print
+//DESCRIPTION  : printf to the display window, or to stdout when ncurses
+//              is not running (--stats)
+//PARAMETERS   : const char *fmt, ... - format and arguments
+//RETURNS      : Nothing
+//
+void stats_print(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    if (display_win != NULL) {
+        vw_printw(display_win, fmt, args);
+    } else {
+        vprintf(fmt, args);
+    }
+    va_end(args);
+}
+
+//
+//FUNCTION     : show_stats
+//DESCRIPTION  : Displays the server's totals and, for each rolling window,
+//              bookings per second, revenue per minute and the top
+//              destinations
+//PARAMETERS   : const StatsReport *report - decoded FRAME_STATS
+//RETURNS      : Nothing
+//
+void show_stats(const StatsReport *report)
+{
+    stats_print("=== SERVER TOTALS ===\n");
+    stats_print("Records: %llu | Total: $%lld.%02lld\n",
+                (unsigned long long)report->bookings,
+                (long long)(report->cents / 100), (long long)(report->cents % 100));
+
+    for (int w = 0; w < report->windowCount; w++) {
+        const RateWindow *win = &report->windows[w];
+        double seconds = win->coveredMs > 0 ? win->coveredMs / 1000.0 : 1.0;
+
+        stats_print("Last %2u min: %llu bookings | %.1f/s | $%.2f/min\n",
+                    win->seconds / 60, (unsigned long long)win->bookings,
+                    win->bookings / seconds, win->cents / 100.0 / seconds * 60.0);
+        for (int i = 0; i < win->topCount; i++) {
+            stats_print("    %d. %-24s %8llu  $%.2f\n", i + 1, win->top[i].destination,
+                        (unsigned long long)win->top[i].bookings,
+                        win->top[i].cents / 100.0);
+        }
+    }
+}
+
+//
+//FUNCTION     : query_stats
+//DESCRIPTION  : Headless F2: asks the server for its totals and rolling
+//              windows, prints them and disconnects
+//PARAMETERS   : const char *server_ip - server address
+//RETURNS      : int - exit code
+//
+int query_stats(const char *server_ip)
+{
+    uint8_t frame[PROTO_HEADER_SIZE + 1];
+    FrameBuffer rx = { NULL, 0, 0 };
+    FrameHeader hdr;
+    StatsReport report;
+    int found = 0;
+
+    client_socket = connect_server(server_ip, SERVER_PORT);
+    if (client_socket == -1) {
+        return 1;
+    }
+
+    int len = proto_encode_signal(SIGNAL_F2, frame, sizeof(frame));
+    if (proto_send_all(client_socket, frame, (size_t)len) == -1) {
+        perror("send");
+        cleanup();
+        return 1;
+    }
+
+    while (!found && proto_buffer_fill(&rx, client_socket) > 0) {
+        size_t used = 0;
+        while (proto_parse_header(rx.data + used, rx.len - used, &hdr) == 1) {
+            if (hdr.type == FRAME_STATS &&
+                proto_decode_stats(rx.data + used + PROTO_HEADER_SIZE,
+                                   hdr.length, &report) == 0) {
+                show_stats(&report);
+                found = 1;
+            }
+            used += PROTO_HEADER_SIZE + hdr.length;
+        }
+        proto_buffer_consume(&rx, used);
+    }
+    if (!found) {
+        fprintf(stderr, "Server closed the connection before sending statistics.\n");
+    }
+
+    len = proto_encode_signal(SIGNAL_F1, frame, sizeof(frame));
+    proto_send_all(client_socket, frame, (size_t)len);
+    proto_buffer_free(&rx);
+    cleanup();
+    return found ? 0 : 1;
 }
 
 //
@@ -273,7 +492,7 @@ int validate_age(int age)
 //FUNCTION     : get_client_data
 //DESCRIPTION  : Uses ncurses to gather name, age, address,
 //              trip choice and number of people from user,
-//              reading available trips from shared memory.
+//              searching available trips in shared memory.
 //PARAMETERS   : ClientMessage *msg - structure to store client data
 //RETURNS      : Nothing
 //
@@ -387,74 +606,121 @@ void get_client_data(ClientMessage *msg)
     }
 
     //--------------------------------------------------
-    //Display available trips from shared memory
+    //Search available trips in shared memory
     //--------------------------------------------------
-    wprintw(display_win, "\n=== Available Trips ===\n");
+    int32_t minCents, maxCents;
+    uint32_t activeTrips = catalog_price_range(&cat, &minCents, &maxCents);
+    wprintw(display_win, "\n=== Available Trips (%u, $%.2f - $%.2f) ===\n",
+            activeTrips, minCents / 100.0, maxCents / 100.0);
     wrefresh(display_win);
 
-    sem_lock(semid);
-
-    if (shm->tripCount == 0) {
+    if (activeTrips == 0) {
         wprintw(display_win, "\nNo trips available!\n");
         wrefresh(display_win);
-        sem_unlock(semid);
         cleanup();
         endwin();
         exit(1);
     }
 
-    for (int i = 0; i < shm->tripCount; i++) {
-        if (shm->trips[i].active) {
-            wprintw(display_win, "%d. %s - $%.2f\n",
-                    i + 1,
-                    shm->trips[i].destination,
-                    shm->trips[i].price);
-        }
-    }
-    wrefresh(display_win);
-
-    //--------------------------------------------------
-    //Select trip
-    //--------------------------------------------------
+    //Each search copies its matches lock-free from the catalog's sorted
+    //orders; the booking quotes the version they were read at so the
+    //server can reject stale prices
+    TripMatch matches[SEARCH_RESULTS];
     int tripChoice;
     while (1) {
         reset_input_window();
-        wprintw(input_win, "Select trip number: ");
+        wprintw(input_win, "Search (prefix, $min-$max, Enter = cheapest): ");
         wrefresh(input_win);
 
         echo();
         wgetnstr(input_win, input, sizeof(input) - 1);
         noecho();
 
-        if (sscanf(input, "%d", &tripChoice) != 1) {
-            wprintw(input_win,
-                    "\nInvalid input! Please enter a number.\n");
+        //An exact destination name is resolved through the hash index
+        Trip trip;
+        if (input[0] != '\0' && (tripChoice = catalog_find_trip(&cat, input, &trip)) != 0) {
+            strncpy(msg->destination, trip.destination, MAX_NAME - 1);
+            msg->destination[MAX_NAME - 1] = '\0';
+            msg->priceCents = trip.priceCents;
+            msg->tripId = tripChoice;
+            msg->catalogVersion = trip.version;
+            break;
+        }
+
+        unsigned int catalogVersion;
+        uint32_t total, shown;
+        int32_t loCents, hiCents;
+        if (input[0] == '\0') {
+            total = search_cheapest(&cat, SEARCH_RESULTS, matches, &catalogVersion);
+        } else if (input[0] == '$') {
+            if (parse_price_range(input, &loCents, &hiCents) == -1) {
+                wprintw(input_win, "\nUse $min-$max, e.g. $100-$500!\n");
+                wrefresh(input_win);
+                napms(1000);
+                continue;
+            }
+            total = search_price_range(&cat, loCents, hiCents, matches, SEARCH_RESULTS,
+                                       &catalogVersion);
+        } else {
+            total = search_prefix(&cat, input, matches, SEARCH_RESULTS, &catalogVersion);
+        }
+
+        if (total == 0) {
+            wprintw(input_win, "\nNo trips match!\n");
             wrefresh(input_win);
             napms(1000);
             continue;
         }
 
-        if (tripChoice < MIN_TRIP ||
-            tripChoice > shm->tripCount ||
-            !shm->trips[tripChoice - 1].active) {
+        shown = (total < SEARCH_RESULTS) ? total : SEARCH_RESULTS;
+        wprintw(display_win, "\n--- %u match(es)", total);
+        if (shown < total) {
+            wprintw(display_win, ", first %u", shown);
+        }
+        wprintw(display_win, " ---\n");
+        for (uint32_t i = 0; i < shown; i++) {
+            wprintw(display_win, "%u. %s - $%.2f",
+                    i + 1,
+                    matches[i].trip.destination,
+                    matches[i].trip.priceCents / 100.0);
+            if (matches[i].trip.seats > 0) {
+                wprintw(display_win, " (%u seats left)", (uint32_t)matches[i].trip.inventory);
+            }
+            wprintw(display_win, "\n");
+        }
+        wrefresh(display_win);
+
+        //Select trip from the results
+        reset_input_window();
+        wprintw(input_win, "Select trip number (0 to search again): ");
+        wrefresh(input_win);
+
+        echo();
+        wgetnstr(input_win, input, sizeof(input) - 1);
+        noecho();
+
+        if (sscanf(input, "%d", &tripChoice) != 1 ||
+            tripChoice < 0 || (uint32_t)tripChoice > shown) {
             wprintw(input_win, "\nInvalid trip selection!\n");
             wrefresh(input_win);
             napms(1000);
             continue;
         }
+        if (tripChoice == 0) {
+            continue;
+        }
 
         //Copy trip information
-        strncpy(msg->destination,
-                shm->trips[tripChoice - 1].destination,
-                MAX_NAME - 1);
+        TripMatch *pick = &matches[tripChoice - 1];
+        strncpy(msg->destination, pick->trip.destination, MAX_NAME - 1);
         msg->destination[MAX_NAME - 1] = '\0';
-        msg->tripPrice = shm->trips[tripChoice - 1].price;
+        msg->priceCents = pick->trip.priceCents;
+        msg->tripId = pick->slot + 1;
+        msg->catalogVersion = catalogVersion;
 
         break;
     }
 
-    sem_unlock(semid);
-
     //--------------------------------------------------
     //Get number of people
     //--------------------------------------------------
@@ -474,21 +740,64 @@ void get_client_data(ClientMessage *msg)
             continue;
         }
 
-        if (msg->numPeople < MIN_PEOPLE) {
+        if (msg->numPeople < MIN_PEOPLE || msg->numPeople > MAX_PEOPLE) {
             wprintw(input_win,
-                    "\nNumber of people must be at least %d!\n",
-                    MIN_PEOPLE);
+                    "\nNumber of people must be between %d and %d!\n",
+                    MIN_PEOPLE, MAX_PEOPLE);
             wrefresh(input_win);
             napms(1000);
             continue;
         }
 
-        //Calculate total price
-        msg->tripPrice *= msg->numPeople;
+        //Calculate total price (exact, in cents)
+        if (!booking_total(msg->priceCents, msg->numPeople, &msg->priceCents)) {
+            wprintw(input_win, "\nThat many people would overflow the total price!\n");
+            wrefresh(input_win);
+            napms(1000);
+            continue;
+        }
         break;
     }
 }
 
+//
+//FUNCTION     : parse_price_range
+//DESCRIPTION  : Parses a price range typed as "$min-$max" (the second
+//              '$' is optional) or "$max" for everything up to max
+//PARAMETERS   : const char *input - text starting with '$'
+//              int32_t *loCents, *hiCents - receive the range in cents
+//RETURNS      : int - 0 on success, -1 if the text is not a range
+//
+int parse_price_range(const char *input, int32_t *loCents, int32_t *hiCents)
+{
+    const char *dash = strchr(input, '-');
+    int64_t lo = 0, hi;
+    char first[32];
+
+    if (dash == NULL) {
+        if (!parse_cents(input, &hi)) {
+            return -1;
+        }
+    } else {
+        size_t len = (size_t)(dash - input);
+        if (len >= sizeof(first)) {
+            return -1;
+        }
+        memcpy(first, input, len);
+        first[len] = '\0';
+        if (!parse_cents(first, &lo) || !parse_cents(dash + 1, &hi)) {
+            return -1;
+        }
+    }
+
+    if (hi < lo || hi > INT32_MAX) {
+        return -1;
+    }
+    *loCents = (int32_t)lo;
+    *hiCents = (int32_t)hi;
+    return 0;
+}
+
 //
 //FUNCTION     : reset_input_window
 //DESCRIPTION  : Clears and redraws the input window box, then
@@ -503,3 +812,112 @@ void reset_input_window(void)
     wmove(input_win, 1, 1);
     wrefresh(input_win);
 }
+
+//
+//FUNCTION     : upload_bookings
+//DESCRIPTION  : Bulk upload without ncurses: reads bookings from a CSV file
+//              (first,last,age,address,destination,people,unit_price),
+//              sends them as FRAME_BATCH frames and sums the batch
+//              acknowledgements returned by the server.
+//PARAMETERS   : const char *server_ip - server address
+//              const char *path - CSV file
+//RETURNS      : int - exit code
+//
+int upload_bookings(const char *server_ip, const char *path)
+{
+    static uint8_t frame[PROTO_MAX_FRAME];
+    ClientMessage *pending;
+    FrameBuffer rx = { NULL, 0, 0 };
+    FrameHeader hdr;
+    BatchAck ack;
+    BookingAck rejects[PROTO_MAX_BATCH];
+    char line[512];
+    unsigned int line_no = 0;
+    int count = 0, skipped = 0, batches = 0, acked = 0;
+    long accepted = 0, rejected = 0;
+    unsigned long long totalCents = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    client_socket = connect_server(server_ip, SERVER_PORT);
+    pending = malloc(PROTO_MAX_BATCH * sizeof(ClientMessage));
+    if (client_socket == -1 || pending == NULL) {
+        free(pending);
+        fclose(fp);
+        cleanup();
+        return 1;
+    }
+
+    //Send full batches while reading; the last one may be short
+    int eof = 0;
+    while (!eof) {
+        if (fgets(line, sizeof(line), fp) == NULL) {
+            eof = 1;
+        } else if (line_no++, parse_booking_csv(line, &pending[count])) {
+            pending[count].requestId = line_no;     //Request id = CSV line
+            count++;
+        } else {
+            skipped++;
+        }
+
+        if (count == PROTO_MAX_BATCH || (eof && count > 0)) {
+            int sent = 0;
+            while (sent < count) {
+                int encoded;
+                int len = proto_encode_batch(&pending[sent], count - sent,
+                                             frame, sizeof(frame), &encoded);
+                if (len == -1 ||
+                    proto_send_all(client_socket, frame, (size_t)len) == -1) {
+                    perror("send");
+                    free(pending);
+                    fclose(fp);
+                    cleanup();
+                    return 1;
+                }
+                sent += encoded;
+                batches++;
+            }
+            count = 0;
+        }
+    }
+    fclose(fp);
+    free(pending);
+
+    //Collect one acknowledgement per batch
+    while (acked < batches) {
+        ssize_t n = proto_buffer_fill(&rx, client_socket);
+        if (n <= 0) {
+            fprintf(stderr, "Server closed the connection before acknowledging.\n");
+            break;
+        }
+
+        size_t used = 0;
+        while (proto_parse_header(rx.data + used, rx.len - used, &hdr) == 1) {
+            if (hdr.type == FRAME_BATCH_ACK &&
+                proto_decode_batch_ack(rx.data + used + PROTO_HEADER_SIZE,
+                                       hdr.length, &ack, rejects, PROTO_MAX_BATCH) == 0) {
+                accepted   += ack.accepted;
+                rejected   += ack.rejected;
+                totalCents += ack.totalCents;
+                acked++;
+                for (int i = 0; i < ack.rejected; i++) {
+                    printf("Line %u rejected by server: %s\n",
+                           rejects[i].requestId, proto_status_text(rejects[i].status));
+                }
+            }
+            used += PROTO_HEADER_SIZE + hdr.length;
+        }
+        proto_buffer_consume(&rx, used);
+    }
+
+    printf("Batches: %d | Accepted: %ld | Rejected: %ld | Skipped lines: %d | Total: $%.2f\n",
+           batches, accepted, rejected, skipped, totalCents / 100.0);
+
+    proto_buffer_free(&rx);
+    cleanup();
+    return acked == batches ? 0 : 1;
+}
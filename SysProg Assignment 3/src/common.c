@@ -3,101 +3,194 @@
 //PROJECT            : SysProg Assign 3
 //PROGRAMMER         : Rodrigo P Gomes
 //FIRST VERSION      : 2025-11-08
-//DESCRIPTION        : Common functions shared across all programs including
-//                     semaphore management for synchronizing access to shared memory
+//DESCRIPTION        : Common functions shared across all programs
 //
 
+#define _GNU_SOURCE
 #include "ipc_shared.h"
 
 //
-//FUNCTION     : sem_lock
-//DESCRIPTION  : Locks (decrements) the semaphore - P operation
-//PARAMETERS   : int semid - semaphore identifier
-//RETURNS      : Nothing (exits on error)
+//FUNCTION     : parse_booking_csv
+//DESCRIPTION  : Parses one CSV booking line:
+//              first,last,age,address,destination,people,unit_price
+//              The stored priceCents is the total for all people.
+//PARAMETERS   : char *line - CSV line (modified in place)
+//              ClientMessage *msg - receives the booking
+//RETURNS      : int - 1 if the line is a valid booking, 0 otherwise
 //
-void sem_lock(int semid) {
-    struct sembuf sb;
-    sb.sem_num = 0;
-    sb.sem_op = -1;  //P operation (wait/lock)
-    sb.sem_flg = 0;
-    
-    if (semop(semid, &sb, 1) == -1) {
-        perror("semop lock");
-        exit(1);
+int parse_booking_csv(char *line, ClientMessage *msg) {
+    char *fields[7];
+    char *save = NULL;
+    int64_t unitCents;
+    int n = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *tok = strtok_r(line, ",", &save); tok != NULL && n < 7;
+         tok = strtok_r(NULL, ",", &save)) {
+        fields[n++] = tok;
+    }
+    if (n != 7) {
+        return 0;
+    }
+
+    memset(msg, 0, sizeof(ClientMessage));
+    strncpy(msg->firstName, fields[0], MAX_NAME - 1);
+    strncpy(msg->lastName, fields[1], MAX_NAME - 1);
+    strncpy(msg->address, fields[3], MAX_ADDRESS - 1);
+    strncpy(msg->destination, fields[4], MAX_NAME - 1);
+
+    if (sscanf(fields[2], "%d", &msg->age) != 1 ||
+        sscanf(fields[5], "%d", &msg->numPeople) != 1 ||
+        !parse_cents(fields[6], &unitCents)) {
+        return 0;
     }
+
+    return msg->age >= MIN_AGE && msg->age <= MAX_AGE &&
+           msg->numPeople >= MIN_PEOPLE && msg->numPeople <= MAX_PEOPLE && unitCents > 0 &&
+           booking_total(unitCents, msg->numPeople, &msg->priceCents);
 }
 
 //
-//FUNCTION     : sem_unlock
-//DESCRIPTION  : Unlocks (increments) the semaphore - V operation
-//PARAMETERS   : int semid - semaphore identifier
-//RETURNS      : Nothing (exits on error)
+//FUNCTION     : booking_total
+//DESCRIPTION  : Total price of a booking, exactly: a product that does
+//              not fit in 64 bits is refused rather than wrapped
+//PARAMETERS   : int64_t unitCents - price per person
+//              int numPeople - people (already validated)
+//              int64_t *total - receives the total in cents (untouched
+//              if it does not fit)
+//RETURNS      : int - 1 if the total fits, 0 otherwise
 //
-void sem_unlock(int semid) {
-    struct sembuf sb;
-    sb.sem_num = 0;
-    sb.sem_op = 1;   //V operation (signal/unlock)
-    sb.sem_flg = 0;
-    
-    if (semop(semid, &sb, 1) == -1) {
-        perror("semop unlock");
-        exit(1);
+int booking_total(int64_t unitCents, int numPeople, int64_t *total) {
+    int64_t product;
+
+    if (__builtin_mul_overflow(unitCents, (int64_t)numPeople, &product)) {
+        return 0;
     }
+    *total = product;
+    return 1;
 }
 
 //
-//FUNCTION     : create_semaphore
-//DESCRIPTION  : Creates a new semaphore and initializes it to 1 (unlocked)
-//PARAMETERS   : key_t key - IPC key for semaphore
-//RETURNS      : int - semaphore ID or -1 on error
+//FUNCTION     : parse_trip_csv
+//DESCRIPTION  : Parses one CSV catalog line:
+//              destination,price[,seats]
+//              Seats default to 0 (unlimited).
+//PARAMETERS   : char *line - CSV line (modified in place)
+//              Trip *trip - receives the destination, price and seats
+//RETURNS      : int - 1 if the line parsed, 0 otherwise (the caller
+//              validates the destination)
 //
-int create_semaphore(key_t key) {
-    int semid;
-    union semun arg;
-    
-    //Create semaphore
-    semid = semget(key, 1, IPC_CREAT | IPC_EXCL | PERMISSIONS);
-    if (semid == -1) {
-        perror("semget create");
-        return -1;
+int parse_trip_csv(char *line, Trip *trip) {
+    char *fields[3];
+    char *save = NULL;
+    int n = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    for (char *tok = strtok_r(line, ",", &save); tok != NULL && n < 3;
+         tok = strtok_r(NULL, ",", &save)) {
+        fields[n++] = tok;
     }
-    
-    //Initialize semaphore to 1 (unlocked)
-    arg.val = 1;
-    if (semctl(semid, 0, SETVAL, arg) == -1) {
-        perror("semctl SETVAL");
-        return -1;
+    if (n < 2) {
+        return 0;
+    }
+
+    memset(trip, 0, sizeof(Trip));
+    strncpy(trip->destination, fields[0], MAX_NAME - 1);
+    if (!parse_cents(fields[1], &trip->priceCents) ||
+        (n == 3 && sscanf(fields[2], "%d", &trip->seats) != 1)) {
+        return 0;
     }
-    
-    return semid;
+    return trip->priceCents > 0 && trip->seats >= 0;
 }
 
 //
-//FUNCTION     : get_semaphore
-//DESCRIPTION  : Gets an existing semaphore
-//PARAMETERS   : key_t key - IPC key for semaphore
-//RETURNS      : int - semaphore ID or -1 on error
+//FUNCTION     : parse_cents
+//DESCRIPTION  : Parses an amount of money ("129", "129.5", "$129.99")
+//              exactly into cents, without going through float. Leading
+//              and trailing blanks are allowed; more than two decimals
+//              are not.
+//PARAMETERS   : const char *text - amount
+//              int64_t *cents - receives the amount in cents
+//RETURNS      : int - 1 if the text is a valid amount, 0 otherwise
 //
-int get_semaphore(key_t key) {
-    int semid;
-    
-    semid = semget(key, 1, PERMISSIONS);
-    if (semid == -1) {
-        perror("semget get");
-        return -1;
+int parse_cents(const char *text, int64_t *cents) {
+    int64_t whole = 0, frac = 0;
+    int digits = 0, decimals = 0;
+
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    if (*text == '$') {
+        text++;
+    }
+    for (; isdigit((unsigned char)*text); text++, digits++) {
+        if (whole > (INT64_MAX / 100 - 9) / 10) {
+            return 0;           //Out of range
+        }
+        whole = whole * 10 + (*text - '0');
+    }
+    if (*text == '.') {
+        for (text++; isdigit((unsigned char)*text); text++, decimals++) {
+            if (decimals == 2) {
+                return 0;
+            }
+            frac = frac * 10 + (*text - '0');
+        }
+    }
+    while (isspace((unsigned char)*text)) {
+        text++;
     }
-    
-    return semid;
+    if (*text != '\0' || digits + decimals == 0) {
+        return 0;
+    }
+
+    *cents = whole * 100 + (decimals == 1 ? frac * 10 : frac);
+    return 1;
 }
 
 //
-//FUNCTION     : remove_semaphore
-//DESCRIPTION  : Removes a semaphore
-//PARAMETERS   : int semid - semaphore identifier
-//RETURNS      : Nothing
+//FUNCTION     : connect_server
+//DESCRIPTION  : Opens a blocking TCP connection to the booking server
+//PARAMETERS   : const char *ip - server IPv4 address
+//              int port - server port
+//RETURNS      : int - connected socket or -1 on error
 //
-void remove_semaphore(int semid) {
-    if (semctl(semid, 0, IPC_RMID) == -1) {
-        perror("semctl IPC_RMID");
+int connect_server(const char *ip, int port) {
+    struct sockaddr_in server_addr;
+    int sock;
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, ip, &server_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid server address: %s\n", ip);
+        return -1;
     }
-}
\ No newline at end of file
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+        perror("connect");
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+//
+//FUNCTION     : monotonic_ns
+//DESCRIPTION  : Reads the monotonic clock for latency measurements
+//PARAMETERS   : None
+//RETURNS      : uint64_t - nanoseconds since an arbitrary start point
+//
+uint64_t monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
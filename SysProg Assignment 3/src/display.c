@@ -0,0 +1,444 @@
+//
+//FILE          : display.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Nov 29 2025
+//DESCRIPTION   : [NCURSES] Server screen: window setup and the booking
+//               line renderer. Kept apart from server.c so the renderer
+//               can be linked into the benchmarks.
+//               The render thread (display_start) takes the terminal off
+//               the network path: the event loop only queues events and
+//               the thread draws them at DISPLAY_FPS (see display.h).
+//               In headless mode nothing is drawn: the same calls write
+//               binary records to the event log (binlog.h).
+//
+
+#include "display.h"
+#include "binlog.h"
+#include <stdarg.h>
+
+//[NCURSES] Global ncurses windows
+WINDOW *display_win, *input_win;
+
+//Event queue of this process (bounded, multi-producer, one consumer)
+static DisplayEvent queue[DISPLAY_QUEUE];
+static _Atomic uint64_t queue_head;        //Next position to claim
+static uint64_t queue_tail;                //Next position to draw (render thread)
+static _Atomic long dropped_lines;         //Posts that found the queue full
+static _Atomic long dropped_bookings;
+static _Atomic int64_t dropped_cents;
+static pthread_t render_thread;
+static _Atomic int render_running;         //The render thread owns the terminal
+static _Atomic int render_stop;
+static int headless = 0;                   //Output goes to the binary log
+
+//
+//FUNCTION     : display_init
+//DESCRIPTION  : Starts ncurses on the terminal and creates the windows
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void display_init(void) {
+    initscr();
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    refresh();
+
+    display_create_windows();
+}
+
+//
+//FUNCTION     : display_init_headless
+//DESCRIPTION  : Headless mode: no terminal is touched and every display_*
+//              call below logs to the binary event log instead
+//PARAMETERS   : const char *logPath - event log file
+//RETURNS      : int - 0 on success, -1 if the log cannot be opened
+//
+int display_init_headless(const char *logPath) {
+    if (binlog_open(logPath) == -1) {
+        return -1;
+    }
+    headless = 1;
+    return 0;
+}
+
+//
+//FUNCTION     : display_end
+//DESCRIPTION  : Restores the terminal, or closes the event log when headless
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void display_end(void) {
+    if (headless) {
+        binlog_close();
+    } else {
+        endwin();
+    }
+}
+
+//
+//FUNCTION     : display_create_windows
+//DESCRIPTION  : Creates the display and input windows on the current screen
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void display_create_windows(void) {
+    int display_height = DISPLAY_HEIGHT;
+    int input_height   = INPUT_HEIGHT;
+
+    display_win = newwin(display_height, COLS, 0, 0);
+    input_win   = newwin(input_height,  COLS, display_height, 0);
+    scrollok(display_win, TRUE);
+    box(display_win, 0, 0);
+    box(input_win, 0, 0);
+
+    keypad(input_win, TRUE);
+}
+
+//
+//FUNCTION     : display_client
+//DESCRIPTION  : Displays client message in one formatted line
+//PARAMETERS   : const ClientMessage *msg - client message structure
+//RETURNS      : Nothing
+//
+void display_client(const ClientMessage *msg) {
+    //[NCURSES] Use ncurses output
+    wprintw(display_win, "Client%d | %s %s | Age:%d | %s | %s | People:%d | $%.2f\n",
+           msg->clientId,
+           msg->firstName,
+           msg->lastName,
+           msg->age,
+           msg->address,
+           msg->destination,
+           msg->numPeople,
+           msg->priceCents / 100.0);
+}
+
+//
+//FUNCTION     : queue_claim / queue_publish
+//DESCRIPTION  : Claims the next free event slot with compare-and-swap /
+//              hands a filled slot to the render thread
+//PARAMETERS   : uint64_t *pos - receives / gives the slot's position
+//              DisplayEvent *ev - filled slot
+//RETURNS      : queue_claim: DisplayEvent * - slot, NULL if the queue is full
+//
+static DisplayEvent *queue_claim(uint64_t *pos) {
+    uint64_t head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+
+    for (;;) {
+        DisplayEvent *ev = &queue[head & (DISPLAY_QUEUE - 1)];
+        uint64_t seq = atomic_load_explicit(&ev->seq, memory_order_acquire);
+
+        if (seq == head) {
+            if (atomic_compare_exchange_weak_explicit(&queue_head, &head, head + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *pos = head;
+                return ev;
+            }
+        } else if (seq < head) {
+            return NULL;        //Still holds an event from the last lap
+        } else {
+            head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+        }
+    }
+}
+
+static void queue_publish(DisplayEvent *ev, uint64_t pos) {
+    atomic_store_explicit(&ev->seq, pos + 1, memory_order_release);
+}
+
+//
+//FUNCTION     : draw_event
+//DESCRIPTION  : Draws one queued event and frees its slot (render thread)
+//PARAMETERS   : DisplayEvent *ev - event, uint64_t pos - its position
+//RETURNS      : Nothing
+//
+static void draw_event(DisplayEvent *ev, uint64_t pos) {
+    if (ev->type == DISPLAY_EVENT_BOOKING) {
+        display_client(&ev->booking);
+    } else {
+        wprintw(ev->type == DISPLAY_EVENT_INPUT ? input_win : display_win, "%s", ev->text);
+    }
+    atomic_store_explicit(&ev->seq, pos + DISPLAY_QUEUE, memory_order_release);
+}
+
+//
+//FUNCTION     : render_frame
+//DESCRIPTION  : Draws one frame: the newest DISPLAY_FRAME_LINES queued
+//              lines, then a summary of the older ones and of the posts
+//              dropped since the last frame, then one screen update.
+//              Skipped lines cost a counter each, so the frame costs the
+//              same however many bookings arrived.
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+static void render_frame(void) {
+    uint64_t end = queue_tail;
+    long skippedLines = 0, skippedBookings = 0;
+    int64_t skippedCents = 0;
+
+    while (end - queue_tail < DISPLAY_QUEUE &&
+           atomic_load_explicit(&queue[end & (DISPLAY_QUEUE - 1)].seq,
+                                memory_order_acquire) == end + 1) {
+        end++;
+    }
+    int drew = end != queue_tail;
+    uint64_t showFrom = end - queue_tail > DISPLAY_FRAME_LINES ? end - DISPLAY_FRAME_LINES
+                                                               : queue_tail;
+
+    for (uint64_t pos = queue_tail; pos < showFrom; pos++) {
+        DisplayEvent *ev = &queue[pos & (DISPLAY_QUEUE - 1)];
+        if (ev->type == DISPLAY_EVENT_INPUT) {
+            draw_event(ev, pos);            //Summaries and prompts are rare
+            continue;
+        }
+        skippedLines++;
+        if (ev->type == DISPLAY_EVENT_BOOKING) {
+            skippedBookings++;
+            skippedCents += ev->booking.priceCents;
+        }
+        atomic_store_explicit(&ev->seq, pos + DISPLAY_QUEUE, memory_order_release);
+    }
+
+    for (uint64_t pos = showFrom; pos < end; pos++) {
+        draw_event(&queue[pos & (DISPLAY_QUEUE - 1)], pos);
+    }
+    queue_tail = end;
+
+    //Last, so long wrapped lines cannot scroll it away
+    long droppedLines = atomic_exchange(&dropped_lines, 0);
+    skippedBookings += atomic_exchange(&dropped_bookings, 0);
+    skippedCents    += atomic_exchange(&dropped_cents, 0);
+    if (skippedLines + droppedLines > 0) {
+        wprintw(display_win, "... %ld earlier lines not shown (%ld bookings, $%lld.%02lld) ...\n",
+                skippedLines + droppedLines, skippedBookings,
+                (long long)(skippedCents / 100), (long long)(skippedCents % 100));
+    }
+
+    if (drew || droppedLines > 0) {
+        wnoutrefresh(display_win);
+        wnoutrefresh(input_win);
+        doupdate();
+    }
+}
+
+//
+//FUNCTION     : render_loop
+//DESCRIPTION  : Render thread: draws a frame every 1/DISPLAY_FPS seconds
+//              until display_stop, then draws what is left
+//PARAMETERS   : void *arg - unused
+//RETURNS      : void * - NULL
+//
+static void *render_loop(void *arg) {
+    const long frameNs = 1000000000L / DISPLAY_FPS;
+    struct timespec next, now;
+
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!atomic_load(&render_stop)) {
+        next.tv_nsec += frameNs;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        //A slow terminal skips frames instead of drawing them back to back
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec ||
+            (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+            next = now;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        render_frame();
+    }
+    render_frame();
+    return NULL;
+}
+
+//
+//FUNCTION     : display_start
+//DESCRIPTION  : Starts this process's render thread (or log flusher when
+//              headless); from here on only it draws. Call after fork:
+//              each process needs its own thread. Only one process may
+//              draw to the terminal, so forked workers run headless.
+//PARAMETERS   : int worker - worker number, tags log records
+//RETURNS      : int - 0 on success, -1 if the thread could not start
+//              (drawing then stays synchronous)
+//
+int display_start(int worker) {
+    sigset_t all, old;
+    int rc;
+
+    if (headless) {
+        return binlog_start(worker);
+    }
+
+    for (uint64_t i = 0; i < DISPLAY_QUEUE; i++) {
+        atomic_init(&queue[i].seq, i);
+    }
+    atomic_store(&queue_head, 0);
+    queue_tail = 0;
+    atomic_store(&render_stop, 0);
+    wrefresh(display_win);
+    wrefresh(input_win);
+
+    //Signals stay with the event loop, which relies on EINTR
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&render_thread, NULL, render_loop, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    atomic_store(&render_running, 1);
+    return 0;
+}
+
+//
+//FUNCTION     : display_stop
+//DESCRIPTION  : Draws the queued events and stops the render thread;
+//              drawing is synchronous again afterwards
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void display_stop(void) {
+    if (headless) {
+        binlog_stop();
+        return;
+    }
+    if (!atomic_load(&render_running)) {
+        return;
+    }
+    atomic_store(&render_stop, 1);
+    pthread_join(render_thread, NULL);
+    atomic_store(&render_running, 0);
+}
+
+//
+//FUNCTION     : display_post_client
+//DESCRIPTION  : Queues a booking line for the render thread (drawn at
+//              once when it is not running). Never blocks: a full queue
+//              drops the line and counts it for the next summary.
+//PARAMETERS   : const ClientMessage *msg - accepted booking
+//RETURNS      : Nothing
+//
+void display_post_client(const ClientMessage *msg) {
+    uint64_t pos;
+
+    if (headless) {
+        binlog_booking(msg);
+        return;
+    }
+    if (!atomic_load_explicit(&render_running, memory_order_relaxed)) {
+        display_client(msg);
+        return;
+    }
+
+    DisplayEvent *ev = queue_claim(&pos);
+    if (ev == NULL) {
+        atomic_fetch_add_explicit(&dropped_lines, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&dropped_bookings, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&dropped_cents, msg->priceCents, memory_order_relaxed);
+        return;
+    }
+    ev->type = DISPLAY_EVENT_BOOKING;
+    ev->booking = *msg;
+    queue_publish(ev, pos);
+}
+
+//
+//FUNCTION     : display_printf
+//DESCRIPTION  : wprintw for the server windows: queued for the render
+//              thread while it runs (lines longer than DISPLAY_TEXT_MAX
+//              are cut), drawn at once otherwise
+//PARAMETERS   : WINDOW *win - display_win or input_win
+//              const char *fmt, ... - format and arguments
+//RETURNS      : Nothing
+//
+void display_printf(WINDOW *win, const char *fmt, ...) {
+    va_list args;
+    uint64_t pos;
+
+    va_start(args, fmt);
+    if (headless) {
+        binlog_text(fmt, args);
+        va_end(args);
+        return;
+    }
+    if (!atomic_load_explicit(&render_running, memory_order_relaxed)) {
+        vw_printw(win, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    DisplayEvent *ev = queue_claim(&pos);
+    if (ev == NULL) {
+        atomic_fetch_add_explicit(&dropped_lines, 1, memory_order_relaxed);
+    } else {
+        ev->type = win == input_win ? DISPLAY_EVENT_INPUT : DISPLAY_EVENT_TEXT;
+        vsnprintf(ev->text, DISPLAY_TEXT_MAX, fmt, args);
+        queue_publish(ev, pos);
+    }
+    va_end(args);
+}
+
+//
+//FUNCTION     : display_refresh
+//DESCRIPTION  : Shows what was drawn so far; the render thread does this
+//              on its own every frame, so it is only needed before
+//              display_start and after display_stop. Headless, it writes
+//              the logged records out (needed before fork).
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void display_refresh(void) {
+    if (headless) {
+        binlog_flush();
+    } else if (!atomic_load_explicit(&render_running, memory_order_relaxed)) {
+        wrefresh(display_win);
+        wrefresh(input_win);
+    }
+}
+
+//
+//FUNCTION     : display_connected / display_closed
+//DESCRIPTION  : Reports a client connection accepted / closed
+//PARAMETERS   : int worker - worker that owns it, int clientNum - client
+//              struct in_addr addr - peer address
+//RETURNS      : Nothing
+//
+void display_connected(int worker, int clientNum, struct in_addr addr) {
+    if (headless) {
+        binlog_connection(BINLOG_CONNECT, clientNum, addr.s_addr);
+        return;
+    }
+    display_printf(display_win, "[W%d] Client %d connected from %s\n",
+                   worker, clientNum, inet_ntoa(addr));
+}
+
+void display_closed(int clientNum) {
+    if (headless) {
+        binlog_connection(BINLOG_CLOSE, clientNum, 0);
+        return;
+    }
+    display_printf(display_win, "Client %d finished.\n", clientNum);
+}
+
+//
+//FUNCTION     : display_batch
+//DESCRIPTION  : Reports the result of one FRAME_BATCH in one line
+//PARAMETERS   : int clientNum - client, int count - records in the batch
+//              int accepted, int rejected - outcome
+//              int64_t cents - revenue of the accepted records
+//RETURNS      : Nothing
+//
+void display_batch(int clientNum, int count, int accepted, int rejected, int64_t cents) {
+    if (headless) {
+        binlog_batch(clientNum, count, accepted, rejected, cents);
+        return;
+    }
+    display_printf(display_win, "Client%d | Batch of %d | Accepted:%d | Rejected:%d | $%.2f\n",
+                   clientNum, count, accepted, rejected, cents / 100.0);
+}
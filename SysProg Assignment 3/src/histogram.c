@@ -0,0 +1,152 @@
+//
+//FILE               : histogram.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Rodrigo P Gomes
+//FIRST VERSION      : 2025-12-17
+//DESCRIPTION        : Log-linear latency histograms (see histogram.h):
+//                     single-writer recording, merging for reports,
+//                     cumulative counts and quantiles.
+//
+
+#include "histogram.h"
+
+//
+//FUNCTION     : bucket_of
+//DESCRIPTION  : Bucket holding a value. Values below HIST_SUB have one
+//              bucket each; above that, the power of two picks a group of
+//              HIST_SUB buckets and the next HIST_SUB_BITS bits pick one.
+//PARAMETERS   : uint64_t value - ns
+//RETURNS      : int - bucket index
+//
+static int bucket_of(uint64_t value) {
+    if (value < HIST_SUB) {
+        return (int)value;
+    }
+
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((value >> shift) - HIST_SUB);
+}
+
+//
+//FUNCTION     : bucket_high
+//DESCRIPTION  : Largest value a bucket holds
+//PARAMETERS   : int index - bucket
+//RETURNS      : uint64_t - ns
+//
+static uint64_t bucket_high(int index) {
+    if (index < HIST_SUB) {
+        return (uint64_t)index;
+    }
+
+    int shift = index / HIST_SUB - 1;
+    uint64_t low = (uint64_t)(HIST_SUB + index % HIST_SUB) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+//
+//FUNCTION     : add
+//DESCRIPTION  : Single-writer increment: a relaxed load and store, so a
+//              concurrent reader sees the old or the new value
+//PARAMETERS   : _Atomic uint64_t *counter, uint64_t n - amount
+//RETURNS      : Nothing
+//
+static void add(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+//
+//FUNCTION     : hist_record
+//DESCRIPTION  : Records n occurrences of a value. Only the histogram's
+//              writer may call it.
+//PARAMETERS   : Histogram *h - histogram, uint64_t value - ns
+//              uint64_t n - occurrences (a batch accounted at once)
+//RETURNS      : Nothing
+//
+void hist_record(Histogram *h, uint64_t value, uint64_t n) {
+    add(&h->buckets[bucket_of(value)], n);
+    add(&h->count, n);
+    add(&h->sum, value * n);
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+    }
+}
+
+//
+//FUNCTION     : hist_merge
+//DESCRIPTION  : Adds one histogram into another (a private copy for a
+//              report; from may be written meanwhile). count is rebuilt
+//              from the buckets so the copy is self-consistent.
+//PARAMETERS   : Histogram *into - report copy, const Histogram *from
+//RETURNS      : Nothing
+//
+void hist_merge(Histogram *into, const Histogram *from) {
+    uint64_t count = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        uint64_t n = atomic_load_explicit(&from->buckets[i], memory_order_relaxed);
+        if (n > 0) {
+            add(&into->buckets[i], n);
+            count += n;
+        }
+    }
+    add(&into->count, count);
+    add(&into->sum, atomic_load_explicit(&from->sum, memory_order_relaxed));
+
+    uint64_t max = atomic_load_explicit(&from->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&into->max, memory_order_relaxed)) {
+        atomic_store_explicit(&into->max, max, memory_order_relaxed);
+    }
+}
+
+//
+//FUNCTION     : hist_count_below
+//DESCRIPTION  : Values recorded below a limit. Exact when the limit is a
+//              bucket boundary (any power of two is one).
+//PARAMETERS   : const Histogram *h, uint64_t limit - ns
+//RETURNS      : uint64_t - values < limit
+//
+uint64_t hist_count_below(const Histogram *h, uint64_t limit) {
+    uint64_t count = 0;
+
+    for (int i = 0; i < HIST_BUCKETS && bucket_high(i) < limit; i++) {
+        count += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    return count;
+}
+
+//
+//FUNCTION     : hist_quantile
+//DESCRIPTION  : Value at a quantile: the top of the bucket holding it,
+//              capped at the largest value recorded
+//PARAMETERS   : const Histogram *h, double q - 0.0 to 1.0
+//RETURNS      : uint64_t - ns (0 if the histogram is empty)
+//
+uint64_t hist_quantile(const Histogram *h, double q) {
+    uint64_t total = 0, seen = 0;
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        total += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t high = bucket_high(i);
+            return high < max ? high : max;
+        }
+    }
+    return max;
+}
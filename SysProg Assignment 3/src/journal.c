@@ -0,0 +1,318 @@
+//
+//FILE          : journal.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 13 2025
+//DESCRIPTION   : Write-ahead journal of accepted bookings. The event loop
+//               only copies a record into memory (journal_append); a
+//               dedicated I/O thread writes the waiting records in one
+//               write() and syncs them with one fdatasync() (group
+//               commit), then signals an eventfd so the event loop can
+//               release the acks that were waiting for them. Acks are
+//               only released for records that are really on disk.
+//
+
+#define _GNU_SOURCE
+#include "journal.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+
+//
+//FUNCTION     : journal_checksum
+//DESCRIPTION  : FNV-1a hash of a record up to its checksum field, so a
+//              torn or foreign record at the end of the file is detected
+//PARAMETERS   : const JournalRecord *rec - record
+//RETURNS      : uint32_t - checksum
+//
+uint32_t journal_checksum(const JournalRecord *rec) {
+    const uint8_t *p = (const uint8_t *)rec;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < offsetof(JournalRecord, checksum); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : journal_write
+//DESCRIPTION  : Appends a group of records and syncs them, then marks
+//              them durable and wakes the event loop. Workers share the
+//              file, so a commit holds an exclusive flock() from the
+//              append to the end of the sync: if either fails, the file
+//              is cut back to where this group started (no torn record,
+//              no half-synced copy for a retry to duplicate) and the
+//              records stay not durable.
+//PARAMETERS   : Journal *j - journal, const JournalRecord *recs
+//              uint32_t n - records
+//RETURNS      : int - 0 on success, -1 on error (errno in j->error)
+//
+static int journal_write(Journal *j, const JournalRecord *recs, uint32_t n) {
+    const char *p = (const char *)recs;
+    size_t left = (size_t)n * sizeof(JournalRecord);
+    uint64_t one = 1;
+    int error = 0;
+
+    while (flock(j->fd, LOCK_EX) == -1) {
+        if (errno != EINTR) {
+            atomic_store(&j->error, errno);
+            return -1;
+        }
+    }
+
+    //A crash mid-append leaves a partial record at the end; drop it
+    off_t start = lseek(j->fd, 0, SEEK_END);
+    if (start == -1) {
+        error = errno;
+    } else if (start % (off_t)sizeof(JournalRecord) != 0) {
+        start -= start % (off_t)sizeof(JournalRecord);
+        if (ftruncate(j->fd, start) == -1) {
+            error = errno;
+        }
+    }
+
+    while (error == 0 && left > 0) {
+        ssize_t written = write(j->fd, p, left);
+        if (written == -1) {
+            if (errno != EINTR) {
+                error = errno;
+            }
+            continue;
+        }
+        p += written;
+        left -= (size_t)written;
+    }
+    if (error == 0 && fdatasync(j->fd) == -1) {
+        error = errno;
+    }
+    if (error != 0 && start != -1 && ftruncate(j->fd, start) == -1) {
+        //Left for the next commit's check (or replay) to cut back
+    }
+    flock(j->fd, LOCK_UN);
+
+    atomic_store(&j->error, error);
+    if (error != 0) {
+        return -1;
+    }
+
+    atomic_fetch_add(&j->commits, 1);
+    atomic_fetch_add_explicit(&j->durable, n, memory_order_release);
+    if (write(j->eventFd, &one, sizeof(one)) == -1) {
+        //Counter saturated; the event loop is already due to wake up
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : journal_thread
+//DESCRIPTION  : I/O thread. Sleeps until a record arrives, then waits for
+//              a full batch or for the oldest record's delay to run out,
+//              swaps the fill buffer for an empty one and commits the
+//              group outside the lock, retrying a group that fails.
+//              Drains everything before exiting.
+//PARAMETERS   : void *arg - Journal
+//RETURNS      : void * - NULL
+//
+static void *journal_thread(void *arg) {
+    Journal *j = arg;
+    struct timespec retry = { 0, JOURNAL_RETRY_MS * 1000000L };
+    JournalRecord *flush = NULL;
+    uint32_t flushCap = 0;
+
+    pthread_mutex_lock(&j->lock);
+    while (1) {
+        while (j->fillCount == 0 && !j->stop) {
+            pthread_cond_wait(&j->wake, &j->lock);
+        }
+        if (j->fillCount == 0) {
+            break;                  //Stopped and drained
+        }
+
+        uint64_t deadline = j->fillSince + (uint64_t)j->maxDelayUs * 1000;
+        struct timespec ts = { (time_t)(deadline / 1000000000ULL),
+                               (long)(deadline % 1000000000ULL) };
+        while (!j->stop && j->fillCount < j->maxBatch &&
+               pthread_cond_timedwait(&j->wake, &j->lock, &ts) != ETIMEDOUT) {
+        }
+
+        JournalRecord *group = j->fill;
+        uint32_t n = j->fillCount, groupCap = j->fillCap;
+        j->fill = flush;
+        j->fillCap = flushCap;
+        j->fillCount = 0;
+        flush = group;
+        flushCap = groupCap;
+        pthread_mutex_unlock(&j->lock);
+
+        //A failed group is retried until it commits: later records
+        //queue behind it and every ack waiting on them stays held
+        uint64_t one = 1;
+        while (journal_write(j, flush, n) == -1) {
+            if (write(j->eventFd, &one, sizeof(one)) == -1) {
+                //Only wakes the event loop to report the error
+            }
+            nanosleep(&retry, NULL);
+            pthread_mutex_lock(&j->lock);
+            int stop = j->stop;
+            pthread_mutex_unlock(&j->lock);
+            if (stop) {
+                break;              //Shutting down: never acked, never journaled
+            }
+        }
+
+        pthread_mutex_lock(&j->lock);
+    }
+    pthread_mutex_unlock(&j->lock);
+    free(flush);
+    return NULL;
+}
+
+//
+//FUNCTION     : journal_open
+//DESCRIPTION  : Opens (or creates) the journal file for appending and
+//              starts the I/O thread. Call after fork: each process needs
+//              its own thread.
+//PARAMETERS   : Journal *j - receives the journal
+//              const char *path - journal file
+//              long maxDelayUs - longest a record waits before a commit
+//              uint32_t maxBatch - records that trigger a commit at once
+//RETURNS      : int - 0 on success, -1 on error
+//
+int journal_open(Journal *j, const char *path, long maxDelayUs, uint32_t maxBatch) {
+    pthread_condattr_t attr;
+    int rc;
+
+    memset(j, 0, sizeof(Journal));
+    j->maxDelayUs = maxDelayUs < 0 ? 0 : maxDelayUs;
+    j->maxBatch   = maxBatch < 1 ? 1 : maxBatch;
+
+    j->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (j->fd == -1) {
+        return -1;
+    }
+    j->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (j->eventFd == -1) {
+        close(j->fd);
+        return -1;
+    }
+
+    //Deadlines are monotonic_ns() values
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&j->wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    //Signals stay with the event loop, which relies on EINTR
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&j->thread, NULL, journal_thread, j);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        pthread_cond_destroy(&j->wake);
+        pthread_mutex_destroy(&j->lock);
+        close(j->eventFd);
+        close(j->fd);
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : journal_append / journal_append_batch
+//DESCRIPTION  : Queues bookings for the next group commit. Only copies
+//              the records into memory; never touches the disk. A batch
+//              is queued whole or not at all, so a caller can journal its
+//              bookings before accounting them and back out on failure.
+//PARAMETERS   : Journal *j - journal
+//              const JournalRecord *rec / JournalRecord *recs - bookings
+//              (magic and checksum are filled in here, in place for a
+//              batch), uint32_t n - records
+//RETURNS      : uint64_t - commit sequence of the (last) record: it is on
+//              disk once journal_durable() reaches it (0 if out of
+//              memory; nothing was queued)
+//
+uint64_t journal_append(Journal *j, const JournalRecord *rec) {
+    JournalRecord stamped = *rec;
+
+    return journal_append_batch(j, &stamped, 1);
+}
+
+uint64_t journal_append_batch(Journal *j, JournalRecord *recs, uint32_t n) {
+    uint64_t seq;
+
+    if (n == 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        recs[i].magic = JOURNAL_MAGIC;
+        recs[i].checksum = journal_checksum(&recs[i]);
+    }
+
+    pthread_mutex_lock(&j->lock);
+    if (j->fillCap - j->fillCount < n) {
+        uint32_t newCap = j->fillCap ? j->fillCap : j->maxBatch * 2;
+        while (newCap - j->fillCount < n) {
+            newCap *= 2;
+        }
+        JournalRecord *grown = realloc(j->fill, (size_t)newCap * sizeof(JournalRecord));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&j->lock);
+            return 0;
+        }
+        j->fill = grown;
+        j->fillCap = newCap;
+    }
+
+    uint32_t before = j->fillCount;
+    memcpy(&j->fill[before], recs, (size_t)n * sizeof(JournalRecord));
+    j->fillCount += n;
+    if (before == 0) {
+        j->fillSince = monotonic_ns();
+        pthread_cond_signal(&j->wake);      //Start the delay
+    } else if (before < j->maxBatch && j->fillCount >= j->maxBatch) {
+        pthread_cond_signal(&j->wake);      //Commit now
+    }
+    j->appended += n;
+    seq = j->appended;
+    pthread_mutex_unlock(&j->lock);
+    return seq;
+}
+
+//
+//FUNCTION     : journal_durable
+//DESCRIPTION  : Records committed to disk so far
+//PARAMETERS   : Journal *j - journal
+//RETURNS      : uint64_t - commit sequence reached
+//
+uint64_t journal_durable(Journal *j) {
+    return atomic_load_explicit(&j->durable, memory_order_acquire);
+}
+
+//
+//FUNCTION     : journal_close
+//DESCRIPTION  : Commits every queued record, stops the I/O thread and
+//              closes the file
+//PARAMETERS   : Journal *j - journal
+//RETURNS      : Nothing
+//
+void journal_close(Journal *j) {
+    pthread_mutex_lock(&j->lock);
+    j->stop = 1;
+    pthread_cond_signal(&j->wake);
+    pthread_mutex_unlock(&j->lock);
+    pthread_join(j->thread, NULL);
+
+    pthread_cond_destroy(&j->wake);
+    pthread_mutex_destroy(&j->lock);
+    close(j->eventFd);
+    close(j->fd);
+    free(j->fill);
+    j->fill = NULL;
+    j->fd = j->eventFd = -1;
+}
@@ -0,0 +1,374 @@
+//
+//FILE               : loadgen.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Josiah Williams
+//FIRST VERSION      : 2025-11-28
+//DESCRIPTION        : Headless load generator for the client (--load).
+//                     Opens several connections, sends generated or CSV
+//                     bookings at a target rate and reports throughput and
+//                     acknowledgement latency percentiles.
+//
+
+#include "loadgen.h"
+#include "protocol.h"
+#include "catalog.h"
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+//One load connection and its in-flight frames (acks come back in order)
+typedef struct {
+    int fd;
+    int wantWrite;
+    FrameBuffer rx;
+    FrameBuffer tx;
+    uint64_t *sentAt;       //Ring of send times, one per in-flight frame
+    int head, inflight;
+} LoadConn;
+
+//Bookings source: CSV records (replayed in a loop) or catalog trips
+typedef struct {
+    ClientMessage *records;
+    long recordCount;
+    TripMatch *trips;       //Live catalog trips with their slots
+    int tripCount;
+    unsigned int catalogVersion;  //Snapshot the generated quotes refer to
+    long next;
+} LoadSource;
+
+static const char *first_names[] = { "Ana", "Ben", "Carla", "Dev", "Eli", "Fay", "Gus", "Hana" };
+static const char *last_names[]  = { "Silva", "Reilly", "Williams", "Gomes", "Zada", "Chen" };
+
+//
+//FUNCTION     : load_catalog
+//DESCRIPTION  : Copies the live trips out of the shared-memory catalog
+//PARAMETERS   : LoadSource *src - receives the trips
+//RETURNS      : int - number of trips, -1 if the catalog is unavailable
+//
+static int load_catalog(LoadSource *src) {
+    Catalog cat;
+    uint32_t bufCap = 0, count = 0;
+
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
+        return -1;
+    }
+    src->catalogVersion = catalog_snapshot(&cat, &src->trips, &bufCap, &count);
+    catalog_close(&cat);
+
+    src->tripCount = (int)count;
+    return src->tripCount;
+}
+
+//
+//FUNCTION     : load_csv
+//DESCRIPTION  : Reads every valid booking from a CSV file
+//PARAMETERS   : LoadSource *src - receives the records
+//              const char *path - CSV file
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int load_csv(LoadSource *src, const char *path) {
+    char line[512];
+    long cap = 1024;
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    src->records = malloc(cap * sizeof(ClientMessage));
+    while (src->records != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (src->recordCount == cap) {
+            cap *= 2;
+            ClientMessage *grown = realloc(src->records, cap * sizeof(ClientMessage));
+            if (grown == NULL) {
+                break;
+            }
+            src->records = grown;
+        }
+        if (parse_booking_csv(line, &src->records[src->recordCount])) {
+            src->recordCount++;
+        }
+    }
+    fclose(fp);
+
+    return src->recordCount > 0 ? 0 : -1;
+}
+
+//
+//FUNCTION     : next_booking
+//DESCRIPTION  : Produces the next booking to send
+//PARAMETERS   : LoadSource *src - bookings source
+//              ClientMessage *msg - receives the booking
+//RETURNS      : Nothing
+//
+static void next_booking(LoadSource *src, ClientMessage *msg) {
+    long n = src->next++;
+
+    if (src->recordCount > 0) {
+        *msg = src->records[n % src->recordCount];
+        return;
+    }
+
+    int pick = rand() % src->tripCount;
+    const Trip *trip = &src->trips[pick].trip;
+    memset(msg, 0, sizeof(ClientMessage));
+    strcpy(msg->firstName, first_names[n % 8]);
+    strcpy(msg->lastName, last_names[n % 6]);
+    msg->age = MIN_AGE + 17 + (int)(n % 60);
+    snprintf(msg->address, MAX_ADDRESS, "%ld Main Street", n % 9999 + 1);
+    strncpy(msg->destination, trip->destination, MAX_NAME - 1);
+    msg->tripId = (int)src->trips[pick].slot + 1;
+    msg->catalogVersion = src->catalogVersion;
+    msg->numPeople = MIN_PEOPLE + (int)(n % 4);
+    if (!booking_total(trip->priceCents, msg->numPeople, &msg->priceCents)) {
+        msg->priceCents = 0;        //Sent anyway; the server rejects it
+    }
+}
+
+//
+//FUNCTION     : flush_conn
+//DESCRIPTION  : Sends queued frames and watches EPOLLOUT only while some
+//              are still pending
+//PARAMETERS   : int epfd - epoll instance, LoadConn *c - connection
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int flush_conn(int epfd, LoadConn *c) {
+    struct epoll_event ev;
+    int pending = proto_buffer_flush(&c->tx, c->fd);
+
+    if (pending == -1) {
+        return -1;
+    }
+    if (pending != c->wantWrite) {
+        ev.events   = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->wantWrite = pending;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : compare_u64
+//DESCRIPTION  : qsort comparator for latency samples
+//
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+//
+//FUNCTION     : percentile
+//DESCRIPTION  : Nearest-rank percentile of sorted samples
+//PARAMETERS   : const uint64_t *sorted, long n - samples
+//              double p - percentile (0-100)
+//RETURNS      : uint64_t - sample value
+//
+static uint64_t percentile(const uint64_t *sorted, long n, double p) {
+    if (n == 0) {
+        return 0;
+    }
+    long idx = (long)(p / 100.0 * (double)n + 0.5) - 1;
+    if (idx < 0) {
+        idx = 0;
+    }
+    if (idx >= n) {
+        idx = n - 1;
+    }
+    return sorted[idx];
+}
+
+//
+//FUNCTION     : run_load
+//DESCRIPTION  : Runs the load test and prints the report. Each frame's
+//              latency is measured from the moment it is handed to the
+//              socket until its acknowledgement is parsed.
+//PARAMETERS   : const LoadConfig *cfg - settings
+//RETURNS      : int - exit code
+//
+int run_load(const LoadConfig *cfg) {
+    static uint8_t frame[PROTO_MAX_FRAME];
+    ClientMessage *pending = malloc((size_t)cfg->batch * sizeof(ClientMessage));
+    LoadConn *conns = calloc((size_t)cfg->conns, sizeof(LoadConn));
+    uint64_t *samples = malloc((size_t)cfg->count * sizeof(uint64_t));
+    struct epoll_event ev, events[MAX_EVENTS];
+    LoadSource src;
+    long sent = 0, accepted = 0, rejected = 0, frames = 0, nsamples = 0;
+    unsigned int request_id = 0;
+    int epfd, open_conns = 0;
+
+    memset(&src, 0, sizeof(src));
+    srand((unsigned int)time(NULL));
+
+    if (pending == NULL || conns == NULL || samples == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (cfg->csvPath != NULL) {
+        if (load_csv(&src, cfg->csvPath) == -1) {
+            fprintf(stderr, "No valid bookings in %s\n", cfg->csvPath);
+            return 1;
+        }
+    } else if (load_catalog(&src) <= 0) {
+        fprintf(stderr, "No trips available! Run shm_manager first or use --csv.\n");
+        return 1;
+    }
+
+    epfd = epoll_create1(0);
+    for (int i = 0; i < cfg->conns; i++) {
+        LoadConn *c = &conns[i];
+        c->fd     = connect_server(cfg->serverIp, SERVER_PORT);
+        c->sentAt = malloc((size_t)cfg->window * sizeof(uint64_t));
+        if (c->fd == -1 || c->sentAt == NULL ||
+            fcntl(c->fd, F_SETFL, O_NONBLOCK) == -1) {
+            fprintf(stderr, "Unable to open connection %d\n", i + 1);
+            return 1;
+        }
+        ev.events   = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        open_conns++;
+    }
+
+    printf("Load: %d connections, %ld bookings, batch %d, window %d, rate %s\n",
+           cfg->conns, cfg->count, cfg->batch, cfg->window,
+           cfg->rate > 0 ? "limited" : "unlimited");
+
+    uint64_t start = monotonic_ns();
+
+    while (accepted + rejected < sent || sent < cfg->count) {
+        uint64_t now = monotonic_ns();
+        long allowed = cfg->count;
+        int timeout = 100;
+
+        if (cfg->rate > 0) {
+            allowed = (long)((double)(now - start) * cfg->rate / 1e9) + cfg->batch;
+            if (allowed > cfg->count) {
+                allowed = cfg->count;
+            }
+        }
+
+        //Top up every connection's window
+        for (int i = 0; i < cfg->conns; i++) {
+            LoadConn *c = &conns[i];
+
+            while (c->fd != -1 && c->inflight < cfg->window && sent < allowed) {
+                int n = (int)(allowed - sent < cfg->batch ? allowed - sent : cfg->batch);
+                int len, encoded = 1;
+
+                for (int k = 0; k < n; k++) {
+                    next_booking(&src, &pending[k]);
+                    pending[k].requestId = ++request_id;
+                }
+                if (cfg->batch == 1) {
+                    len = proto_encode_booking(&pending[0], frame, sizeof(frame));
+                } else {
+                    len = proto_encode_batch(pending, n, frame, sizeof(frame), &encoded);
+                }
+                if (len == -1 ||
+                    proto_buffer_append(&c->tx, frame, (size_t)len) == -1) {
+                    fprintf(stderr, "Unable to encode booking\n");
+                    return 1;
+                }
+                request_id -= (unsigned int)(n - encoded);
+                src.next   -= n - encoded;
+
+                c->sentAt[(c->head + c->inflight) % cfg->window] = now;
+                c->inflight++;
+                sent += encoded;
+                frames++;
+            }
+
+            if (c->fd != -1 && c->tx.len > 0 && flush_conn(epfd, c) == -1) {
+                fprintf(stderr, "Connection lost while sending\n");
+                return 1;
+            }
+        }
+
+        if (sent < cfg->count && sent >= allowed) {
+            timeout = 1;    //Rate limited: wake up for the next send slot
+        }
+
+        int ready = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        for (int i = 0; i < ready; i++) {
+            LoadConn *c = (LoadConn *)events[i].data.ptr;
+
+            if ((events[i].events & EPOLLOUT) && flush_conn(epfd, c) == -1) {
+                fprintf(stderr, "Connection lost while sending\n");
+                return 1;
+            }
+            if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                continue;
+            }
+
+            ssize_t got = proto_buffer_fill(&c->rx, c->fd);
+            if (got == 0 || (got == -1 && errno != EAGAIN)) {
+                fprintf(stderr, "Server closed a connection\n");
+                return 1;
+            }
+
+            uint64_t acked_at = monotonic_ns();
+            FrameHeader hdr;
+            size_t used = 0;
+            while (proto_parse_header(c->rx.data + used, c->rx.len - used, &hdr) == 1) {
+                const uint8_t *payload = c->rx.data + used + PROTO_HEADER_SIZE;
+                BookingAck ack;
+                BatchAck batch_ack;
+
+                if (hdr.type == FRAME_ACK &&
+                    proto_decode_ack(payload, hdr.length, &ack) == 0) {
+                    if (ack.status == ACK_OK) {
+                        accepted++;
+                    } else {
+                        rejected++;
+                    }
+                } else if (hdr.type == FRAME_BATCH_ACK &&
+                           proto_decode_batch_ack(payload, hdr.length, &batch_ack,
+                                                  NULL, 0) == 0) {
+                    accepted += batch_ack.accepted;
+                    rejected += batch_ack.rejected;
+                } else {
+                    used += PROTO_HEADER_SIZE + hdr.length;
+                    continue;
+                }
+
+                if (c->inflight > 0) {
+                    samples[nsamples++] = acked_at - c->sentAt[c->head];
+                    c->head = (c->head + 1) % cfg->window;
+                    c->inflight--;
+                }
+                used += PROTO_HEADER_SIZE + hdr.length;
+            }
+            proto_buffer_consume(&c->rx, used);
+        }
+    }
+
+    double elapsed = (double)(monotonic_ns() - start) / 1e9;
+
+    qsort(samples, (size_t)nsamples, sizeof(uint64_t), compare_u64);
+    printf("Sent: %ld bookings in %ld frames | Accepted: %ld | Rejected: %ld\n",
+           sent, frames, accepted, rejected);
+    printf("Elapsed: %.3f s | Throughput: %.0f bookings/s\n",
+           elapsed, elapsed > 0 ? (double)(accepted + rejected) / elapsed : 0.0);
+    printf("Ack latency (us): p50 %.1f | p99 %.1f | p999 %.1f | max %.1f\n",
+           percentile(samples, nsamples, 50.0) / 1e3,
+           percentile(samples, nsamples, 99.0) / 1e3,
+           percentile(samples, nsamples, 99.9) / 1e3,
+           nsamples > 0 ? samples[nsamples - 1] / 1e3 : 0.0);
+
+    for (int i = 0; i < open_conns; i++) {
+        close(conns[i].fd);
+        proto_buffer_free(&conns[i].rx);
+        proto_buffer_free(&conns[i].tx);
+        free(conns[i].sentAt);
+    }
+    close(epfd);
+    free(conns);
+    free(samples);
+    free(pending);
+    free(src.records);
+    free(src.trips);
+    return 0;
+}
@@ -0,0 +1,160 @@
+//
+//FILE          : logdump.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 16 2025
+//DESCRIPTION   : Decodes the headless server's binary event log
+//               (binlog.h) into one text line per record.
+//               Usage: logdump [FILE]
+//
+
+#include "binlog.h"
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+//
+//FUNCTION     : print_time
+//DESCRIPTION  : Prints a CLOCK_REALTIME stamp as local date and time
+//PARAMETERS   : uint64_t timeNs - nanoseconds since the epoch
+//RETURNS      : Nothing
+//
+static void print_time(uint64_t timeNs) {
+    time_t secs = (time_t)(timeNs / 1000000000ULL);
+    struct tm tm;
+    char text[32];
+
+    localtime_r(&secs, &tm);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%s.%06llu ", text, (unsigned long long)(timeNs % 1000000000ULL / 1000));
+}
+
+//
+//FUNCTION     : print_record
+//DESCRIPTION  : Prints one record
+//PARAMETERS   : const BinlogHeader *hdr - record (hdr->length bytes)
+//RETURNS      : int - 0 on success, -1 if the record is malformed
+//
+static int print_record(const BinlogHeader *hdr) {
+    print_time(hdr->timeNs);
+    if (hdr->worker == BINLOG_MAIN) {
+        printf("main ");
+    } else {
+        printf("W%-3u ", hdr->worker);
+    }
+
+    switch (hdr->type) {
+        case BINLOG_BOOKING: {
+            const BinlogBooking *b = (const BinlogBooking *)hdr;
+            if (hdr->length < offsetof(BinlogBooking, destination) ||
+                hdr->length < offsetof(BinlogBooking, destination) + b->destLength) {
+                return -1;
+            }
+            printf("BOOKING client=%d people=%d $%lld.%02lld %.*s\n", b->clientId,
+                   b->numPeople, (long long)(b->priceCents / 100),
+                   (long long)(b->priceCents % 100), b->destLength, b->destination);
+            return 0;
+        }
+
+        case BINLOG_BATCH: {
+            const BinlogBatch *b = (const BinlogBatch *)hdr;
+            if (hdr->length < sizeof(BinlogBatch)) {
+                return -1;
+            }
+            printf("BATCH   client=%d records=%u accepted=%u rejected=%u $%lld.%02lld\n",
+                   b->clientId, b->count, b->accepted, b->rejected,
+                   (long long)(b->cents / 100), (long long)(b->cents % 100));
+            return 0;
+        }
+
+        case BINLOG_CONNECT:
+        case BINLOG_CLOSE: {
+            const BinlogConnection *c = (const BinlogConnection *)hdr;
+            struct in_addr addr;
+            if (hdr->length < sizeof(BinlogConnection)) {
+                return -1;
+            }
+            if (hdr->type == BINLOG_CLOSE) {
+                printf("CLOSE   client=%d\n", c->clientId);
+            } else {
+                addr.s_addr = c->addr;
+                printf("CONNECT client=%d from %s\n", c->clientId, inet_ntoa(addr));
+            }
+            return 0;
+        }
+
+        case BINLOG_TEXT: {
+            const BinlogText *t = (const BinlogText *)hdr;
+            int n = (int)strnlen(t->text, hdr->length - sizeof(BinlogHeader));
+            while (n > 0 && t->text[n - 1] == '\n') {
+                n--;
+            }
+            printf("TEXT    %.*s\n", n, t->text);
+            return 0;
+        }
+
+        case BINLOG_DROPPED: {
+            const BinlogDropped *d = (const BinlogDropped *)hdr;
+            if (hdr->length < sizeof(BinlogDropped)) {
+                return -1;
+            }
+            printf("DROPPED %llu records (log write failed)\n", (unsigned long long)d->records);
+            return 0;
+        }
+
+        default:
+            return -1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : BINLOG_FILE;
+    struct stat st;
+    long records = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(BinlogFileHeader)) {
+        fprintf(stderr, "%s is not an event log\n", path);
+        close(fd);
+        return 1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    const BinlogFileHeader *fh = (const BinlogFileHeader *)data;
+    if (fh->magic != BINLOG_MAGIC || fh->version != BINLOG_VERSION) {
+        fprintf(stderr, "%s is not an event log (or from another version)\n", path);
+        munmap((void *)data, size);
+        return 1;
+    }
+
+    //Records are 8-byte aligned and never split, so a bad length means a
+    //damaged or truncated file
+    size_t off = sizeof(BinlogFileHeader);
+    while (off + sizeof(BinlogHeader) <= size) {
+        const BinlogHeader *hdr = (const BinlogHeader *)(data + off);
+        if (hdr->length < sizeof(BinlogHeader) || (hdr->length & 7) != 0 ||
+            off + hdr->length > size || print_record(hdr) == -1) {
+            fprintf(stderr, "Damaged record at offset %zu; stopping\n", off);
+            munmap((void *)data, size);
+            return 1;
+        }
+        off += hdr->length;
+        records++;
+    }
+
+    fprintf(stderr, "%ld records\n", records);
+    munmap((void *)data, size);
+    return 0;
+}
@@ -0,0 +1,289 @@
+//
+//FILE          : metrics.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 17 2025
+//DESCRIPTION   : Prometheus text exposition and the loopback HTTP
+//               listener that serves it (see metrics.h). One request per
+//               connection, answered from the listener thread.
+//
+
+#include "metrics.h"
+#include <stdarg.h>
+#include <poll.h>
+
+#define POLL_MS 200                 //How often the listener checks for stop
+#define REQUEST_MAX 2048            //Request bytes read (the rest is ignored)
+#define CLIENT_TIMEOUT_S 1          //A scraper that stalls is dropped
+#define BUCKET_FIRST 8              //Buckets le 2^8 - 1 ns (255 ns) ...
+#define BUCKET_LAST 34              //... to 2^34 - 1 ns (about 17 s)
+
+static int listen_fd = -1;
+static MetricsWriter metrics_writer;
+static pthread_t listener;
+static _Atomic int listener_running;
+static _Atomic int listener_stop;
+static MetricsText scrape;          //Only the listener thread builds it
+
+//
+//FUNCTION     : metrics_add
+//DESCRIPTION  : Adds to a counter that only the caller writes: a relaxed
+//              load and store, no locked instruction
+//PARAMETERS   : _Atomic uint64_t *counter, uint64_t n - amount
+//RETURNS      : Nothing
+//
+void metrics_add(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+//
+//FUNCTION     : append
+//DESCRIPTION  : printf into the scrape text; output that does not fit is
+//              dropped and the scrape marked truncated
+//PARAMETERS   : MetricsText *out, const char *fmt, ... - format
+//RETURNS      : Nothing
+//
+static void append(MetricsText *out, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void append(MetricsText *out, const char *fmt, ...) {
+    va_list args;
+    size_t room = sizeof(out->text) - out->len;
+
+    va_start(args, fmt);
+    int n = vsnprintf(out->text + out->len, room, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= room) {
+        out->text[out->len] = '\0';
+        out->truncated = 1;
+        return;
+    }
+    out->len += (size_t)n;
+}
+
+//
+//FUNCTION     : metrics_family / metrics_value
+//DESCRIPTION  : Writes the HELP and TYPE lines of a metric / one sample
+//PARAMETERS   : MetricsText *out, const char *name
+//              const char *type - counter, gauge or histogram
+//              const char *help - one line
+//              const char *labels - e.g. "signal=\"F1\"", NULL for none
+//              uint64_t value - sample
+//RETURNS      : Nothing
+//
+void metrics_family(MetricsText *out, const char *name, const char *type, const char *help) {
+    append(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_value(MetricsText *out, const char *name, const char *labels, uint64_t value) {
+    if (labels == NULL) {
+        append(out, "%s %llu\n", name, (unsigned long long)value);
+    } else {
+        append(out, "%s{%s} %llu\n", name, labels, (unsigned long long)value);
+    }
+}
+
+//
+//FUNCTION     : metrics_histogram
+//DESCRIPTION  : Writes a nanosecond histogram as a Prometheus histogram
+//              in seconds (cumulative power-of-two buckets, sum, count)
+//              followed by its quantiles as a <name>_quantile gauge.
+//              A bucket counts values <= le; values are whole ns, so the
+//              exact count below 2^k ns is published as le = 2^k - 1 ns.
+//PARAMETERS   : MetricsText *out, const char *name - ends in _seconds
+//              const char *help - one line, const Histogram *h - values
+//RETURNS      : Nothing
+//
+void metrics_histogram(MetricsText *out, const char *name, const char *help, const Histogram *h) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+
+    metrics_family(out, name, "histogram", help);
+    for (int k = BUCKET_FIRST; k <= BUCKET_LAST; k++) {
+        uint64_t limit = (uint64_t)1 << k;
+        append(out, "%s_bucket{le=\"%.9f\"} %llu\n", name, (double)(limit - 1) / 1e9,
+               (unsigned long long)hist_count_below(h, limit));
+    }
+    append(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+    append(out, "%s_sum %.9f\n", name,
+           (double)atomic_load_explicit(&h->sum, memory_order_relaxed) / 1e9);
+    append(out, "%s_count %llu\n", name, (unsigned long long)count);
+
+    append(out, "# HELP %s_quantile %s (quantiles)\n# TYPE %s_quantile gauge\n",
+           name, help, name);
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        append(out, "%s_quantile{quantile=\"%g\"} %.9f\n", name, quantiles[i],
+               (double)hist_quantile(h, quantiles[i]) / 1e9);
+    }
+}
+
+//
+//FUNCTION     : send_all
+//DESCRIPTION  : Sends a whole buffer on a blocking socket
+//PARAMETERS   : int fd - socket, const char *data, size_t len
+//RETURNS      : int - 0 on success, -1 on error
+//
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len  -= (size_t)n;
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : serve_request
+//DESCRIPTION  : Reads one HTTP request and answers it: GET /metrics (or
+//              /) gets a fresh scrape, anything else 404
+//PARAMETERS   : int fd - accepted connection
+//RETURNS      : Nothing
+//
+static void serve_request(int fd) {
+    struct timeval timeout = { CLIENT_TIMEOUT_S, 0 };
+    char request[REQUEST_MAX + 1];
+    char head[256];
+    size_t used = 0;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    //Only the request line matters; read until the headers end
+    while (used < REQUEST_MAX) {
+        ssize_t n = recv(fd, request + used, REQUEST_MAX - used, 0);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        used += (size_t)n;
+        request[used] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+            break;
+        }
+    }
+    request[used] = '\0';
+
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        const char *notFound = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n"
+                               "Content-Length: 10\r\nConnection: close\r\n\r\nNot found\n";
+        send_all(fd, notFound, strlen(notFound));
+        return;
+    }
+
+    scrape.len = 0;
+    scrape.truncated = 0;
+    scrape.text[0] = '\0';
+    metrics_writer(&scrape);
+    if (scrape.truncated) {
+        append(&scrape, "# metrics truncated at %d bytes\n", METRICS_MAX_TEXT);
+    }
+
+    int len = snprintf(head, sizeof(head),
+                       "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: %zu\r\nConnection: close\r\n\r\n", scrape.len);
+    if (send_all(fd, head, (size_t)len) == 0) {
+        send_all(fd, scrape.text, scrape.len);
+    }
+}
+
+//
+//FUNCTION     : listen_loop
+//DESCRIPTION  : Listener thread: accepts scrapers one at a time until
+//              metrics_stop
+//PARAMETERS   : void *arg - unused
+//RETURNS      : void * - NULL
+//
+static void *listen_loop(void *arg) {
+    struct pollfd pfd = { listen_fd, POLLIN, 0 };
+
+    (void)arg;
+    while (!atomic_load(&listener_stop)) {
+        if (poll(&pfd, 1, POLL_MS) <= 0) {
+            continue;
+        }
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1) {
+            continue;
+        }
+        serve_request(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+//
+//FUNCTION     : metrics_start
+//DESCRIPTION  : Listens on 127.0.0.1:port and starts the listener thread
+//PARAMETERS   : int port - TCP port
+//              MetricsWriter writer - fills in a scrape (called from the
+//              listener thread)
+//RETURNS      : int - 0 on success, -1 on error (errno set)
+//
+int metrics_start(int port, MetricsWriter writer) {
+    struct sockaddr_in addr;
+    sigset_t all, old;
+    int opt = 1;
+    int rc;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons((uint16_t)port);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(listen_fd, 16) == -1) {
+        int saved = errno;
+        close(listen_fd);
+        listen_fd = -1;
+        errno = saved;
+        return -1;
+    }
+
+    metrics_writer = writer;
+    atomic_store(&listener_stop, 0);
+
+    //Signals stay with the event loop, which relies on EINTR
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    rc = pthread_create(&listener, NULL, listen_loop, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        errno = rc;
+        return -1;
+    }
+    atomic_store(&listener_running, 1);
+    return 0;
+}
+
+//
+//FUNCTION     : metrics_stop
+//DESCRIPTION  : Stops the listener thread and closes the port
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void metrics_stop(void) {
+    if (!atomic_load(&listener_running)) {
+        return;
+    }
+    atomic_store(&listener_stop, 1);
+    pthread_join(listener, NULL);
+    atomic_store(&listener_running, 0);
+    close(listen_fd);
+    listen_fd = -1;
+}
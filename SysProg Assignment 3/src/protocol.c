@@ -0,0 +1,619 @@
+//
+//FILE               : protocol.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Nicholas Reilly
+//FIRST VERSION      : 2025-11-26
+//DESCRIPTION        : Length-prefixed binary wire protocol shared by the
+//                     client and the server: frame encoding, decoding and
+//                     a receive buffer that survives partial reads
+//
+
+#include "protocol.h"
+
+//Cursor over an encode or decode buffer
+typedef struct {
+    uint8_t *pos;
+    uint8_t *end;
+    int error;              //Set when a read or write would overrun (or a
+                            //field does not fit its wire type)
+} Cursor;
+
+//
+//FUNCTION     : put_u8 / put_u16 / put_u32 / put_u64 / put_str
+//DESCRIPTION  : Append big-endian integers and length-prefixed strings
+//PARAMETERS   : Cursor *c - output cursor, value to write
+//RETURNS      : Nothing (sets c->error on overflow)
+//
+static void put_u8(Cursor *c, uint8_t v) {
+    if (c->end - c->pos < 1) {
+        c->error = 1;
+        return;
+    }
+    *c->pos++ = v;
+}
+
+static void put_u16(Cursor *c, uint16_t v) {
+    put_u8(c, (uint8_t)(v >> 8));
+    put_u8(c, (uint8_t)v);
+}
+
+static void put_u32(Cursor *c, uint32_t v) {
+    put_u16(c, (uint16_t)(v >> 16));
+    put_u16(c, (uint16_t)v);
+}
+
+static void put_u64(Cursor *c, uint64_t v) {
+    put_u32(c, (uint32_t)(v >> 32));
+    put_u32(c, (uint32_t)v);
+}
+
+static void put_str(Cursor *c, const char *s, size_t max) {
+    size_t n = strnlen(s, max - 1);
+
+    put_u8(c, (uint8_t)n);
+    if (c->error || (size_t)(c->end - c->pos) < n) {
+        c->error = 1;
+        return;
+    }
+    memcpy(c->pos, s, n);
+    c->pos += n;
+}
+
+//
+//FUNCTION     : get_u8 / get_u16 / get_u32 / get_u64 / get_str
+//DESCRIPTION  : Read big-endian integers and length-prefixed strings
+//PARAMETERS   : Cursor *c - input cursor, destination for strings
+//RETURNS      : The value read (0 and c->error set on underflow)
+//
+static uint8_t get_u8(Cursor *c) {
+    if (c->end - c->pos < 1) {
+        c->error = 1;
+        return 0;
+    }
+    return *c->pos++;
+}
+
+static uint16_t get_u16(Cursor *c) {
+    uint16_t hi = get_u8(c);
+    return (uint16_t)((hi << 8) | get_u8(c));
+}
+
+static uint32_t get_u32(Cursor *c) {
+    uint32_t hi = get_u16(c);
+    return (hi << 16) | get_u16(c);
+}
+
+static uint64_t get_u64(Cursor *c) {
+    uint64_t hi = get_u32(c);
+    return (hi << 32) | get_u32(c);
+}
+
+static void get_str(Cursor *c, char *out, size_t max) {
+    size_t n = get_u8(c);
+
+    if (c->error || n >= max || (size_t)(c->end - c->pos) < n) {
+        c->error = 1;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, c->pos, n);
+    out[n] = '\0';
+    c->pos += n;
+}
+
+//
+//FUNCTION     : begin_frame / end_frame
+//DESCRIPTION  : Reserve the frame header, then fill in the payload length
+//              once the payload has been written
+//PARAMETERS   : Cursor *c - output cursor, uint8_t type - frame type,
+//              uint8_t *start - start of the frame
+//RETURNS      : end_frame: int - frame length or -1 if it did not fit
+//
+static void begin_frame(Cursor *c, uint8_t type) {
+    put_u32(c, 0);
+    put_u8(c, PROTO_VERSION);
+    put_u8(c, type);
+}
+
+static int end_frame(Cursor *c, uint8_t *start) {
+    size_t total = (size_t)(c->pos - start);
+
+    if (c->error || total > PROTO_MAX_FRAME) {
+        return -1;
+    }
+
+    Cursor hdr = { start, start + 4, 0 };
+    put_u32(&hdr, (uint32_t)(total - PROTO_HEADER_SIZE));
+    return (int)total;
+}
+
+//
+//FUNCTION     : put_booking / get_booking
+//DESCRIPTION  : Write or read one booking record (shared by FRAME_BOOKING
+//              and FRAME_BATCH). PROTO_BOOKING_RECORD lists the same
+//              fields; change both together. A party size that does not
+//              fit its u16 fails the encode instead of being truncated.
+//PARAMETERS   : Cursor *c - cursor, ClientMessage *msg - booking
+//RETURNS      : Nothing (sets c->error on overflow or malformed input)
+//
+static void put_booking(Cursor *c, const ClientMessage *msg) {
+    if (msg->numPeople < 0 || msg->numPeople > MAX_PEOPLE) {
+        c->error = 1;
+        return;
+    }
+    put_u32(c, msg->requestId);
+    put_str(c, msg->firstName, MAX_NAME);
+    put_str(c, msg->lastName, MAX_NAME);
+    put_u8(c, (uint8_t)msg->age);
+    put_str(c, msg->address, MAX_ADDRESS);
+    put_str(c, msg->destination, MAX_NAME);
+    put_u32(c, (uint32_t)msg->tripId);
+    put_u32(c, msg->catalogVersion);
+    put_u16(c, (uint16_t)msg->numPeople);
+    put_u64(c, (uint64_t)msg->priceCents);
+}
+
+static void get_booking(Cursor *c, ClientMessage *msg) {
+    memset(msg, 0, sizeof(ClientMessage));
+    msg->requestId = get_u32(c);
+    get_str(c, msg->firstName, MAX_NAME);
+    get_str(c, msg->lastName, MAX_NAME);
+    msg->age = get_u8(c);
+    get_str(c, msg->address, MAX_ADDRESS);
+    get_str(c, msg->destination, MAX_NAME);
+    msg->tripId = (int)get_u32(c);
+    msg->catalogVersion = get_u32(c);
+    msg->numPeople = get_u16(c);
+    msg->priceCents = (int64_t)get_u64(c);
+}
+
+//
+//FUNCTION     : proto_encode_booking
+//DESCRIPTION  : Encodes a client booking as a FRAME_BOOKING frame
+//PARAMETERS   : const ClientMessage *msg - booking to encode
+//              uint8_t *buf, size_t cap - output buffer
+//RETURNS      : int - frame length or -1 if the buffer is too small or
+//              the party is larger than MAX_PEOPLE
+//
+int proto_encode_booking(const ClientMessage *msg, uint8_t *buf, size_t cap) {
+    Cursor c = { buf, buf + cap, 0 };
+
+    begin_frame(&c, FRAME_BOOKING);
+    put_booking(&c, msg);
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_encode_batch
+//DESCRIPTION  : Encodes up to PROTO_MAX_BATCH bookings as one FRAME_BATCH,
+//              stopping early when the next record would not fit (or
+//              cannot be encoded, see put_booking)
+//PARAMETERS   : const ClientMessage *msgs, int count - bookings to encode
+//              uint8_t *buf, size_t cap - output buffer
+//              int *encoded - receives the number of records encoded
+//RETURNS      : int - frame length or -1 if not even one record fits
+//
+int proto_encode_batch(const ClientMessage *msgs, int count, uint8_t *buf, size_t cap,
+                       int *encoded) {
+    Cursor c = { buf, buf + (cap < PROTO_MAX_FRAME ? cap : PROTO_MAX_FRAME), 0 };
+    uint8_t *count_pos;
+    int n = 0;
+
+    begin_frame(&c, FRAME_BATCH);
+    count_pos = c.pos;
+    put_u16(&c, 0);
+
+    while (n < count && n < PROTO_MAX_BATCH && !c.error) {
+        uint8_t *record = c.pos;
+        put_booking(&c, &msgs[n]);
+        if (c.error) {
+            c.pos = record;     //Roll back the record that did not fit
+            break;
+        }
+        n++;
+    }
+    c.error = 0;
+
+    *encoded = n;
+    if (n == 0) {
+        return -1;
+    }
+
+    Cursor hdr = { count_pos, count_pos + 2, 0 };
+    put_u16(&hdr, (uint16_t)n);
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_encode_batch_ack
+//DESCRIPTION  : Encodes the server's reply to a FRAME_BATCH
+//PARAMETERS   : const BatchAck *ack - batch result
+//              const BookingAck *rejects - ack->rejected rejected records
+//              uint8_t *buf, size_t cap - output buffer
+//RETURNS      : int - frame length or -1 if the buffer is too small
+//
+int proto_encode_batch_ack(const BatchAck *ack, const BookingAck *rejects,
+                           uint8_t *buf, size_t cap) {
+    Cursor c = { buf, buf + cap, 0 };
+
+    begin_frame(&c, FRAME_BATCH_ACK);
+    put_u16(&c, ack->accepted);
+    put_u16(&c, ack->rejected);
+    put_u64(&c, ack->totalCents);
+    put_u64(&c, ack->firstBookingNumber);
+    for (int i = 0; i < ack->rejected; i++) {
+        put_u32(&c, rejects[i].requestId);
+        put_u8(&c, rejects[i].status);
+    }
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_encode_ack
+//DESCRIPTION  : Encodes the server's ack/nack for one FRAME_BOOKING
+//PARAMETERS   : const BookingAck *ack - booking result
+//              uint8_t *buf, size_t cap - output buffer
+//RETURNS      : int - frame length or -1 if the buffer is too small
+//
+int proto_encode_ack(const BookingAck *ack, uint8_t *buf, size_t cap) {
+    Cursor c = { buf, buf + cap, 0 };
+
+    begin_frame(&c, FRAME_ACK);
+    put_u32(&c, ack->requestId);
+    put_u8(&c, ack->status);
+    put_u64(&c, ack->bookingNumber);
+    put_u64(&c, (uint64_t)ack->priceCents);
+    put_u32(&c, (uint32_t)ack->seatsLeft);
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_encode_stats
+//DESCRIPTION  : Encodes the server's reply to SIGNAL_F2
+//PARAMETERS   : const StatsReport *report - totals and rolling windows
+//              uint8_t *buf, size_t cap - output buffer
+//RETURNS      : int - frame length or -1 if the buffer is too small
+//
+int proto_encode_stats(const StatsReport *report, uint8_t *buf, size_t cap) {
+    Cursor c = { buf, buf + cap, 0 };
+
+    begin_frame(&c, FRAME_STATS);
+    put_u64(&c, report->bookings);
+    put_u64(&c, (uint64_t)report->cents);
+    put_u8(&c, report->windowCount);
+    for (int w = 0; w < report->windowCount && w < STATS_WINDOWS; w++) {
+        const RateWindow *win = &report->windows[w];
+        put_u32(&c, win->seconds);
+        put_u32(&c, win->coveredMs);
+        put_u64(&c, win->bookings);
+        put_u64(&c, (uint64_t)win->cents);
+        put_u8(&c, win->topCount);
+        for (int i = 0; i < win->topCount && i < STATS_TOP; i++) {
+            put_str(&c, win->top[i].destination, MAX_NAME);
+            put_u64(&c, win->top[i].bookings);
+            put_u64(&c, (uint64_t)win->top[i].cents);
+        }
+    }
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_encode_signal
+//DESCRIPTION  : Encodes a control signal (F1/F2) as a FRAME_SIGNAL frame
+//PARAMETERS   : int signal - SIGNAL_F1 or SIGNAL_F2
+//              uint8_t *buf, size_t cap - output buffer
+//RETURNS      : int - frame length or -1 if the buffer is too small
+//
+int proto_encode_signal(int signal, uint8_t *buf, size_t cap) {
+    Cursor c = { buf, buf + cap, 0 };
+
+    begin_frame(&c, FRAME_SIGNAL);
+    put_u8(&c, (uint8_t)signal);
+    return end_frame(&c, buf);
+}
+
+//
+//FUNCTION     : proto_parse_header
+//DESCRIPTION  : Checks whether a complete frame sits at the start of buf
+//PARAMETERS   : const uint8_t *buf, size_t len - buffered bytes
+//              FrameHeader *hdr - receives the decoded header
+//RETURNS      : int - 1 if a whole frame is available, 0 if more bytes
+//              are needed, -1 if the frame is invalid
+//
+int proto_parse_header(const uint8_t *buf, size_t len, FrameHeader *hdr) {
+    if (len < PROTO_HEADER_SIZE) {
+        return 0;
+    }
+
+    Cursor c = { (uint8_t *)buf, (uint8_t *)buf + PROTO_HEADER_SIZE, 0 };
+    hdr->length  = get_u32(&c);
+    hdr->version = get_u8(&c);
+    hdr->type    = get_u8(&c);
+
+    if (hdr->version != PROTO_VERSION ||
+        hdr->length > PROTO_MAX_FRAME - PROTO_HEADER_SIZE) {
+        return -1;
+    }
+
+    return len >= PROTO_HEADER_SIZE + (size_t)hdr->length;
+}
+
+//
+//FUNCTION     : proto_decode_booking
+//DESCRIPTION  : Decodes a booking payload into a ClientMessage
+//PARAMETERS   : const uint8_t *payload, size_t len - payload bytes
+//              ClientMessage *msg - receives the booking
+//RETURNS      : int - bytes consumed or -1 if the payload is malformed
+//
+int proto_decode_booking(const uint8_t *payload, size_t len, ClientMessage *msg) {
+    Cursor c = { (uint8_t *)payload, (uint8_t *)payload + len, 0 };
+
+    get_booking(&c, msg);
+    return c.error ? -1 : (int)(c.pos - payload);
+}
+
+//
+//FUNCTION     : proto_decode_batch
+//DESCRIPTION  : Decodes every record of a FRAME_BATCH payload
+//PARAMETERS   : const uint8_t *payload, size_t len - payload bytes
+//              ClientMessage *msgs, int max - receives the bookings
+//RETURNS      : int - number of records or -1 if the payload is malformed
+//
+int proto_decode_batch(const uint8_t *payload, size_t len, ClientMessage *msgs, int max) {
+    Cursor c = { (uint8_t *)payload, (uint8_t *)payload + len, 0 };
+    int count = get_u16(&c);
+
+    if (c.error || count > max) {
+        return -1;
+    }
+    for (int i = 0; i < count && !c.error; i++) {
+        get_booking(&c, &msgs[i]);
+    }
+    return c.error ? -1 : count;
+}
+
+//
+//FUNCTION     : proto_decode_batch_ack
+//DESCRIPTION  : Decodes a FRAME_BATCH_ACK payload
+//PARAMETERS   : const uint8_t *payload, size_t len - payload bytes
+//              BatchAck *ack - receives the batch result
+//              BookingAck *rejects, int max - receives up to max rejected
+//              records (may be NULL when max is 0)
+//RETURNS      : int - 0 on success, -1 if the payload is malformed
+//
+int proto_decode_batch_ack(const uint8_t *payload, size_t len, BatchAck *ack,
+                           BookingAck *rejects, int max) {
+    Cursor c = { (uint8_t *)payload, (uint8_t *)payload + len, 0 };
+
+    ack->accepted           = get_u16(&c);
+    ack->rejected           = get_u16(&c);
+    ack->totalCents         = get_u64(&c);
+    ack->firstBookingNumber = get_u64(&c);
+    for (int i = 0; i < ack->rejected && i < max && !c.error; i++) {
+        memset(&rejects[i], 0, sizeof(BookingAck));
+        rejects[i].requestId = get_u32(&c);
+        rejects[i].status    = get_u8(&c);
+    }
+    return c.error ? -1 : 0;
+}
+
+//
+//FUNCTION     : proto_decode_ack
+//DESCRIPTION  : Decodes a FRAME_ACK payload
+//PARAMETERS   : const uint8_t *payload, size_t len - payload bytes
+//              BookingAck *ack - receives the booking result
+//RETURNS      : int - 0 on success, -1 if the payload is malformed
+//
+int proto_decode_ack(const uint8_t *payload, size_t len, BookingAck *ack) {
+    Cursor c = { (uint8_t *)payload, (uint8_t *)payload + len, 0 };
+
+    ack->requestId     = get_u32(&c);
+    ack->status        = get_u8(&c);
+    ack->bookingNumber = get_u64(&c);
+    ack->priceCents    = (int64_t)get_u64(&c);
+    ack->seatsLeft     = (int32_t)get_u32(&c);
+    return c.error ? -1 : 0;
+}
+
+//
+//FUNCTION     : proto_decode_stats
+//DESCRIPTION  : Decodes a FRAME_STATS payload
+//PARAMETERS   : const uint8_t *payload, size_t len - payload bytes
+//              StatsReport *report - receives the totals and windows
+//RETURNS      : int - 0 on success, -1 if the payload is malformed
+//
+int proto_decode_stats(const uint8_t *payload, size_t len, StatsReport *report) {
+    Cursor c = { (uint8_t *)payload, (uint8_t *)payload + len, 0 };
+
+    memset(report, 0, sizeof(StatsReport));
+    report->bookings    = get_u64(&c);
+    report->cents       = (int64_t)get_u64(&c);
+    report->windowCount = get_u8(&c);
+    if (report->windowCount > STATS_WINDOWS) {
+        return -1;
+    }
+    for (int w = 0; w < report->windowCount && !c.error; w++) {
+        RateWindow *win = &report->windows[w];
+        win->seconds   = get_u32(&c);
+        win->coveredMs = get_u32(&c);
+        win->bookings  = get_u64(&c);
+        win->cents     = (int64_t)get_u64(&c);
+        win->topCount  = get_u8(&c);
+        if (win->topCount > STATS_TOP) {
+            return -1;
+        }
+        for (int i = 0; i < win->topCount && !c.error; i++) {
+            get_str(&c, win->top[i].destination, MAX_NAME);
+            win->top[i].bookings = get_u64(&c);
+            win->top[i].cents    = (int64_t)get_u64(&c);
+        }
+    }
+    return c.error ? -1 : 0;
+}
+
+//
+//FUNCTION     : proto_status_text
+//DESCRIPTION  : Describes a booking acknowledgement status for users
+//PARAMETERS   : int status - ACK_* code
+//RETURNS      : const char * - short description
+//
+const char *proto_status_text(int status) {
+    switch (status) {
+        case ACK_OK:          return "confirmed";
+        case ACK_INVALID:     return "invalid booking";
+        case ACK_STALE:       return "price changed since the catalog was read";
+        case ACK_UNAVAILABLE: return "trip no longer available";
+        case ACK_SOLD_OUT:    return "not enough seats left";
+        case ACK_NOT_RECORDED: return "server could not record the booking; try again";
+        default:              return "unknown status";
+    }
+}
+
+//
+//FUNCTION     : proto_buffer_fill
+//DESCRIPTION  : Reads one large chunk (at least PROTO_RECV_CHUNK bytes of
+//              free space) from a socket into the buffer. The buffer is
+//              allocated on first use, so a connection that never sends
+//              holds no memory.
+//              One recv() per call keeps it safe on blocking sockets that
+//              poll() reported readable.
+//PARAMETERS   : FrameBuffer *fb - receive buffer, int fd - socket
+//RETURNS      : ssize_t - bytes read, 0 on EOF, -1 on error (errno set;
+//              EAGAIN means nothing more to read right now)
+//
+ssize_t proto_buffer_fill(FrameBuffer *fb, int fd) {
+    ssize_t n;
+
+    if (fb->cap - fb->len < PROTO_RECV_CHUNK &&
+        fb->cap < PROTO_MAX_FRAME + PROTO_RECV_CHUNK) {
+        size_t cap = fb->cap ? fb->cap * 2 : PROTO_RECV_CHUNK * 2;
+        uint8_t *data = realloc(fb->data, cap);
+        if (data == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        fb->data = data;
+        fb->cap  = cap;
+    }
+
+    do {
+        n = recv(fd, fb->data + fb->len, fb->cap - fb->len, 0);
+    } while (n == -1 && errno == EINTR);
+
+    if (n > 0) {
+        fb->len += (size_t)n;
+    }
+    return n;
+}
+
+//
+//FUNCTION     : proto_buffer_consume
+//DESCRIPTION  : Drops the parsed bytes from the front of the buffer.
+//              An emptied buffer keeps its memory for the next recv() or
+//              reply, so a busy connection does not malloc and free on
+//              every pass; only one grown past PROTO_BUFFER_KEEP (a large
+//              frame or a reply backlog) is released.
+//PARAMETERS   : FrameBuffer *fb - receive buffer, size_t used - bytes parsed
+//RETURNS      : Nothing
+//
+void proto_buffer_consume(FrameBuffer *fb, size_t used) {
+    if (used >= fb->len) {
+        if (fb->cap > PROTO_BUFFER_KEEP) {
+            proto_buffer_free(fb);
+        }
+        fb->len = 0;
+        return;
+    }
+    if (used > 0) {
+        memmove(fb->data, fb->data + used, fb->len - used);
+        fb->len -= used;
+    }
+}
+
+//
+//FUNCTION     : proto_buffer_append
+//DESCRIPTION  : Queues outgoing bytes (e.g. acknowledgements) on a send
+//              buffer
+//PARAMETERS   : FrameBuffer *fb - send buffer
+//              const uint8_t *data, size_t len - bytes to queue
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int proto_buffer_append(FrameBuffer *fb, const uint8_t *data, size_t len) {
+    if (fb->cap - fb->len < len) {
+        size_t cap = fb->cap ? fb->cap : PROTO_RECV_CHUNK;
+        while (cap - fb->len < len) {
+            cap *= 2;
+        }
+        uint8_t *grown = realloc(fb->data, cap);
+        if (grown == NULL) {
+            return -1;
+        }
+        fb->data = grown;
+        fb->cap  = cap;
+    }
+    memcpy(fb->data + fb->len, data, len);
+    fb->len += len;
+    return 0;
+}
+
+//
+//FUNCTION     : proto_buffer_flush
+//DESCRIPTION  : Sends as much of a send buffer as a non-blocking socket
+//              accepts without waiting
+//PARAMETERS   : FrameBuffer *fb - send buffer, int fd - socket
+//RETURNS      : int - 1 if bytes remain queued, 0 if drained, -1 on error
+//
+int proto_buffer_flush(FrameBuffer *fb, int fd) {
+    size_t sent = 0;
+
+    while (sent < fb->len) {
+        ssize_t n = send(fd, fb->data + sent, fb->len - sent, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+
+    proto_buffer_consume(fb, sent);
+    return fb->len > 0;
+}
+
+//
+//FUNCTION     : proto_buffer_free
+//DESCRIPTION  : Releases a receive or send buffer
+//PARAMETERS   : FrameBuffer *fb - receive buffer
+//RETURNS      : Nothing
+//
+void proto_buffer_free(FrameBuffer *fb) {
+    free(fb->data);
+    fb->data = NULL;
+    fb->len  = 0;
+    fb->cap  = 0;
+}
+
+//
+//FUNCTION     : proto_send_all
+//DESCRIPTION  : Sends a whole buffer on a blocking socket
+//PARAMETERS   : int fd - socket, const uint8_t *buf, size_t len - data
+//RETURNS      : int - 0 on success, -1 on error
+//
+int proto_send_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, 0);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
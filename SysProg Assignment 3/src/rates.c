@@ -0,0 +1,249 @@
+//
+//FILE          : rates.c
+//PROJECT       : SysProg Assignment 3
+//PROGRAMMER    : Nicholas Reilly
+//FIRST VERSION : Dec 15 2025
+//DESCRIPTION   : Rolling 1/5/15 minute booking rates, revenue and top
+//               destinations, kept in per-worker rings of time buckets
+//               (see rates.h). Workers add bookings in O(1); SIGNAL_F2
+//               merges the buckets into a StatsReport for the client.
+//
+
+#include "rates.h"
+#include "checkpoint.h"
+#include <sys/mman.h>
+
+#define BUCKET_NS ((uint64_t)RATE_BUCKET_SECONDS * 1000000000ULL)
+#define READ_TRIES 8                //Copies of a busy bucket before skipping it
+
+static const uint32_t window_seconds[STATS_WINDOWS] = { 60, 300, 900 };
+
+//
+//FUNCTION     : hash_destination
+//DESCRIPTION  : FNV-1a hash of a destination name
+//PARAMETERS   : const char *name - destination
+//RETURNS      : uint32_t - hash
+//
+static uint32_t hash_destination(const char *name) {
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < MAX_NAME && name[i] != '\0'; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//
+//FUNCTION     : rates_create / rates_destroy
+//DESCRIPTION  : Maps zeroed rings for every worker, shared with the
+//              processes forked afterwards / unmaps them
+//PARAMETERS   : int workers - worker processes
+//              RateWindows *r - windows
+//RETURNS      : rates_create: RateWindows * - windows, NULL on error
+//
+RateWindows *rates_create(int workers) {
+    size_t size = sizeof(RateWindows) + (size_t)workers * sizeof(RateRing);
+    RateWindows *r = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (r == MAP_FAILED) {
+        return NULL;
+    }
+    r->startNs = monotonic_ns();
+    r->workers = workers;
+    return r;
+}
+
+void rates_destroy(RateWindows *r) {
+    munmap(r, sizeof(RateWindows) + (size_t)r->workers * sizeof(RateRing));
+}
+
+//
+//FUNCTION     : count_destination
+//DESCRIPTION  : Counts a booking for its destination in a bucket. A full
+//              bucket gives its smallest counter to a new destination,
+//              which inherits that count as its error (space-saving).
+//PARAMETERS   : RateBucket *b - bucket, const char *destination
+//              int64_t cents - revenue of the booking
+//RETURNS      : Nothing
+//
+static void count_destination(RateBucket *b, const char *destination, int64_t cents) {
+    uint32_t hash = hash_destination(destination);
+    uint32_t smallest = 0;
+
+    for (uint32_t i = 0; i < b->topCount; i++) {
+        RateCounter *c = &b->top[i];
+        if (c->hash == hash && strncmp(c->destination, destination, MAX_NAME) == 0) {
+            c->bookings++;
+            c->cents += cents;
+            return;
+        }
+        if (c->bookings < b->top[smallest].bookings) {
+            smallest = i;
+        }
+    }
+
+    RateCounter *c;
+    if (b->topCount < RATE_TOP_SLOTS) {
+        c = &b->top[b->topCount++];
+        c->bookings = 0;
+    } else {
+        c = &b->top[smallest];
+    }
+    c->error = c->bookings;
+    c->cents = 0;
+    c->hash = hash;
+    strncpy(c->destination, destination, MAX_NAME - 1);
+    c->destination[MAX_NAME - 1] = '\0';
+    c->bookings++;
+    c->cents += cents;
+}
+
+//
+//FUNCTION     : rates_add
+//DESCRIPTION  : Counts one accepted booking in the worker's bucket for
+//              the current time, resetting the bucket if it still holds
+//              an interval from RATE_BUCKETS intervals ago
+//PARAMETERS   : RateWindows *r - windows, int worker - caller's ring
+//              uint64_t nowNs - monotonic_ns() of the booking
+//              const char *destination - trip booked
+//              int64_t cents - revenue of the booking
+//RETURNS      : Nothing
+//
+void rates_add(RateWindows *r, int worker, uint64_t nowNs, const char *destination, int64_t cents) {
+    uint64_t epoch = nowNs / BUCKET_NS + 1;
+    RateBucket *b = &r->rings[worker].buckets[epoch % RATE_BUCKETS];
+    uint32_t seq = atomic_load_explicit(&b->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&b->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (b->epoch != epoch) {
+        b->epoch = epoch;
+        b->bookings = 0;
+        b->cents = 0;
+        b->topCount = 0;
+    }
+    b->bookings++;
+    b->cents += cents;
+    count_destination(b, destination, cents);
+
+    atomic_store_explicit(&b->seq, seq + 2, memory_order_release);
+}
+
+//
+//FUNCTION     : read_bucket
+//DESCRIPTION  : Copies a bucket another worker may be writing
+//PARAMETERS   : RateBucket *b - shared bucket, RateBucket *copy
+//RETURNS      : int - 1 on a consistent copy, 0 if it kept changing
+//
+static int read_bucket(RateBucket *b, RateBucket *copy) {
+    for (int tries = 0; tries < READ_TRIES; tries++) {
+        uint32_t seq = atomic_load_explicit(&b->seq, memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(copy, b, sizeof(RateBucket));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&b->seq, memory_order_relaxed) == seq) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : pick_top
+//DESCRIPTION  : Lists the destinations with the most bookings (then
+//              revenue) into a window
+//PARAMETERS   : BookingTotals *merged - window's destination totals
+//              RateWindow *win - receives up to STATS_TOP entries
+//RETURNS      : Nothing
+//
+static void pick_top(BookingTotals *merged, RateWindow *win) {
+    win->topCount = 0;
+    while (win->topCount < STATS_TOP) {
+        DestinationTotal *best = NULL;
+        for (uint32_t i = 0; i < merged->hdr.destCount; i++) {
+            DestinationTotal *d = &merged->dests[i];
+            if (d->bookings > 0 &&
+                (best == NULL || d->bookings > best->bookings ||
+                 (d->bookings == best->bookings && d->cents > best->cents))) {
+                best = d;
+            }
+        }
+        if (best == NULL) {
+            break;
+        }
+
+        TopDestination *top = &win->top[win->topCount++];
+        strncpy(top->destination, best->destination, MAX_NAME - 1);
+        top->destination[MAX_NAME - 1] = '\0';
+        top->bookings = (uint64_t)best->bookings;
+        top->cents    = best->cents;
+        best->bookings = 0;         //Taken
+    }
+}
+
+//
+//FUNCTION     : rates_report
+//DESCRIPTION  : Sums every worker's buckets into the 1, 5 and 15 minute
+//              windows. Top destinations are ranked by the bookings each
+//              bucket is sure of (count minus error), so they are lower
+//              bounds. The lifetime totals of the report are left to the
+//              caller.
+//PARAMETERS   : RateWindows *r - windows, uint64_t nowNs - monotonic_ns()
+//              StatsReport *report - receives the windows
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int rates_report(RateWindows *r, uint64_t nowNs, StatsReport *report) {
+    static RateBucket copy;
+    BookingTotals merged[STATS_WINDOWS];
+    uint64_t nowEpoch = nowNs / BUCKET_NS + 1;
+    int result = 0;
+
+    report->windowCount = STATS_WINDOWS;
+    for (int w = 0; w < STATS_WINDOWS; w++) {
+        RateWindow *win = &report->windows[w];
+        uint64_t buckets = window_seconds[w] / RATE_BUCKET_SECONDS;
+        uint64_t from = nowEpoch > buckets ? (nowEpoch - buckets) * BUCKET_NS : 0;
+
+        memset(win, 0, sizeof(RateWindow));
+        win->seconds   = window_seconds[w];
+        win->coveredMs = (uint32_t)((nowNs - (from > r->startNs ? from : r->startNs)) / 1000000);
+        totals_init(&merged[w]);
+    }
+
+    for (int worker = 0; worker < r->workers; worker++) {
+        for (uint64_t age = 0; age < RATE_WINDOW_BUCKETS && age < nowEpoch; age++) {
+            uint64_t epoch = nowEpoch - age;
+            RateBucket *b = &r->rings[worker].buckets[epoch % RATE_BUCKETS];
+
+            if (b->epoch != epoch || !read_bucket(b, &copy) || copy.epoch != epoch) {
+                continue;
+            }
+            for (int w = 0; w < STATS_WINDOWS; w++) {
+                if (age >= window_seconds[w] / RATE_BUCKET_SECONDS) {
+                    continue;
+                }
+                report->windows[w].bookings += copy.bookings;
+                report->windows[w].cents    += copy.cents;
+                for (uint32_t i = 0; i < copy.topCount && i < RATE_TOP_SLOTS; i++) {
+                    const RateCounter *c = &copy.top[i];
+                    if (c->bookings > c->error &&
+                        totals_merge(&merged[w], c->destination,
+                                     (int64_t)(c->bookings - c->error), 0, c->cents) == -1) {
+                        result = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int w = 0; w < STATS_WINDOWS; w++) {
+        pick_top(&merged[w], &report->windows[w]);
+        totals_free(&merged[w]);
+    }
+    return result;
+}
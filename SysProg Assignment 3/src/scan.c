@@ -0,0 +1,324 @@
+//
+//FILE               : scan.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Rodrigo P Gomes
+//FIRST VERSION      : 2025-12-10
+//DESCRIPTION        : Vectorized scans over the catalog's price column and
+//                     active bitmap: trips under a budget, and min/max
+//                     price with the active count. AVX2 and SSE4.1
+//                     versions are compiled with target attributes and
+//                     chosen at run time; the scalar version runs anywhere.
+//
+
+#include "scan.h"
+#include <limits.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static int selected = -1;       //Kernel set in use, -1 until first call
+
+//
+//FUNCTION     : scan_select
+//DESCRIPTION  : Chooses the kernels. A request the CPU cannot run falls
+//              back to the best supported set.
+//PARAMETERS   : int isa - SCAN_* wanted, -1 for the best available
+//RETURNS      : int - SCAN_* now in use
+//
+int scan_select(int isa) {
+    int best = SCAN_SCALAR;
+
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        best = SCAN_AVX2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        best = SCAN_SSE41;
+    }
+#endif
+    if (isa < 0 || isa > best) {
+        isa = best;
+    }
+    selected = isa;
+    return isa;
+}
+
+//
+//FUNCTION     : scan_isa_name
+//DESCRIPTION  : Names a kernel set for reports
+//PARAMETERS   : int isa - SCAN_* value
+//RETURNS      : const char * - name
+//
+const char *scan_isa_name(int isa) {
+    switch (isa) {
+        case SCAN_AVX2:  return "avx2";
+        case SCAN_SSE41: return "sse4.1";
+        default:         return "scalar";
+    }
+}
+
+//
+//FUNCTION     : active_bits
+//DESCRIPTION  : Active flags of width slots starting at slot i, where i is
+//              a multiple of width and width divides 64
+//PARAMETERS   : const uint64_t *active - bitmap, uint32_t i - first slot
+//              int width - slots wanted (4 or 8)
+//RETURNS      : uint32_t - one bit per slot
+//
+static inline uint32_t active_bits(const uint64_t *active, uint32_t i, int width) {
+    return (uint32_t)(active[i >> 6] >> (i & 63)) & ((1u << width) - 1);
+}
+
+//
+//FUNCTION     : emit_slots
+//DESCRIPTION  : Records the slots of the set bits of a match mask
+//PARAMETERS   : uint32_t mask - one bit per slot from base
+//              uint32_t base - first slot of the mask
+//              uint32_t *slots, uint32_t max - output (may be NULL)
+//              uint32_t found - matches so far
+//RETURNS      : uint32_t - matches including this mask
+//
+static inline uint32_t emit_slots(uint32_t mask, uint32_t base, uint32_t *slots,
+                                  uint32_t max, uint32_t found) {
+    if (slots == NULL) {
+        return found + (uint32_t)__builtin_popcount(mask);
+    }
+    while (mask != 0) {
+        if (found < max) {
+            slots[found] = base + (uint32_t)__builtin_ctz(mask);
+        }
+        found++;
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+//
+//FUNCTION     : under_budget_scalar
+//DESCRIPTION  : Walks the set bits of the bitmap and tests each price
+//PARAMETERS   : see scan_under_budget; from - first slot (0, or the
+//              tail left by a SIMD kernel); found - matches so far
+//RETURNS      : uint32_t - matches (including found)
+//
+static uint32_t under_budget_scalar(const int32_t *prices, const uint64_t *active,
+                                    uint32_t from, uint32_t n, int32_t budget,
+                                    uint32_t *slots, uint32_t max, uint32_t found) {
+    uint32_t i = from;
+
+    while (i < n) {
+        uint64_t bits = active[i >> 6] >> (i & 63);
+        if (bits == 0) {
+            i = (i | 63) + 1;           //Rest of this word is inactive
+            continue;
+        }
+        i += (uint32_t)__builtin_ctzll(bits);
+        if (i >= n) {
+            break;
+        }
+        if (prices[i] <= budget) {
+            found = emit_slots(1, i, slots, max, found);
+        }
+        i++;
+    }
+    return found;
+}
+
+//
+//FUNCTION     : price_range_scalar
+//DESCRIPTION  : Min/max over active slots from..n-1
+//PARAMETERS   : see scan_price_range; from - first slot
+//              int32_t *lo, *hi - running min/max (updated)
+//RETURNS      : uint32_t - active slots seen
+//
+static uint32_t price_range_scalar(const int32_t *prices, const uint64_t *active,
+                                   uint32_t from, uint32_t n, int32_t *lo, int32_t *hi) {
+    uint32_t count = 0;
+
+    for (uint32_t i = from; i < n; i++) {
+        if ((active[i >> 6] >> (i & 63)) & 1) {
+            if (prices[i] < *lo) *lo = prices[i];
+            if (prices[i] > *hi) *hi = prices[i];
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef SCAN_X86
+//
+//FUNCTION     : under_budget_sse41 / under_budget_avx2
+//DESCRIPTION  : Compares 4 (8) prices per step against the budget, masks
+//              the result with the matching active bits and emits the
+//              survivors; groups with no active slot are skipped
+//PARAMETERS   : see scan_under_budget
+//RETURNS      : uint32_t - matches
+//
+__attribute__((target("sse4.1")))
+static uint32_t under_budget_sse41(const int32_t *prices, const uint64_t *active, uint32_t n,
+                                   int32_t budget, uint32_t *slots, uint32_t max) {
+    __m128i limit = _mm_set1_epi32(budget);
+    uint32_t found = 0, i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        uint32_t act = active_bits(active, i, 4);
+        if (act == 0) {
+            continue;
+        }
+        __m128i p = _mm_loadu_si128((const __m128i *)(prices + i));
+        uint32_t over = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(p, limit)));
+        found = emit_slots(act & ~over, i, slots, max, found);
+    }
+    return under_budget_scalar(prices, active, i, n, budget, slots, max, found);
+}
+
+__attribute__((target("avx2")))
+static uint32_t under_budget_avx2(const int32_t *prices, const uint64_t *active, uint32_t n,
+                                  int32_t budget, uint32_t *slots, uint32_t max) {
+    __m256i limit = _mm256_set1_epi32(budget);
+    uint32_t found = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint32_t act = active_bits(active, i, 8);
+        if (act == 0) {
+            continue;
+        }
+        __m256i p = _mm256_loadu_si256((const __m256i *)(prices + i));
+        uint32_t over = (uint32_t)_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpgt_epi32(p, limit)));
+        found = emit_slots(act & ~over, i, slots, max, found);
+    }
+    return under_budget_scalar(prices, active, i, n, budget, slots, max, found);
+}
+
+//
+//FUNCTION     : price_range_sse41 / price_range_avx2
+//DESCRIPTION  : Running min/max over 4 (8) lanes; inactive lanes are
+//              replaced by INT_MAX/INT_MIN with a blend built from the
+//              active bits, then the lanes are reduced once at the end
+//PARAMETERS   : see scan_price_range
+//RETURNS      : uint32_t - active slots
+//
+__attribute__((target("sse4.1")))
+static uint32_t price_range_sse41(const int32_t *prices, const uint64_t *active, uint32_t n,
+                                  int32_t *minPrice, int32_t *maxPrice) {
+    const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i top = _mm_set1_epi32(INT_MAX), bottom = _mm_set1_epi32(INT_MIN);
+    __m128i lo = top, hi = bottom;
+    uint32_t count = 0, i = 0;
+    int32_t out[4];
+
+    for (; i + 4 <= n; i += 4) {
+        uint32_t act = active_bits(active, i, 4);
+        if (act == 0) {
+            continue;
+        }
+        count += (uint32_t)__builtin_popcount(act);
+        __m128i p = _mm_loadu_si128((const __m128i *)(prices + i));
+        __m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)act), lanes), lanes);
+        lo = _mm_min_epi32(lo, _mm_blendv_epi8(top, p, m));
+        hi = _mm_max_epi32(hi, _mm_blendv_epi8(bottom, p, m));
+    }
+
+    _mm_storeu_si128((__m128i *)out, lo);
+    for (int k = 0; k < 4; k++) if (out[k] < *minPrice) *minPrice = out[k];
+    _mm_storeu_si128((__m128i *)out, hi);
+    for (int k = 0; k < 4; k++) if (out[k] > *maxPrice) *maxPrice = out[k];
+    return count + price_range_scalar(prices, active, i, n, minPrice, maxPrice);
+}
+
+__attribute__((target("avx2")))
+static uint32_t price_range_avx2(const int32_t *prices, const uint64_t *active, uint32_t n,
+                                 int32_t *minPrice, int32_t *maxPrice) {
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i top = _mm256_set1_epi32(INT_MAX), bottom = _mm256_set1_epi32(INT_MIN);
+    __m256i lo = top, hi = bottom;
+    uint32_t count = 0, i = 0;
+    int32_t out[8];
+
+    for (; i + 8 <= n; i += 8) {
+        uint32_t act = active_bits(active, i, 8);
+        if (act == 0) {
+            continue;
+        }
+        count += (uint32_t)__builtin_popcount(act);
+        __m256i p = _mm256_loadu_si256((const __m256i *)(prices + i));
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)act), lanes),
+                                       lanes);
+        lo = _mm256_min_epi32(lo, _mm256_blendv_epi8(top, p, m));
+        hi = _mm256_max_epi32(hi, _mm256_blendv_epi8(bottom, p, m));
+    }
+
+    _mm256_storeu_si256((__m256i *)out, lo);
+    for (int k = 0; k < 8; k++) if (out[k] < *minPrice) *minPrice = out[k];
+    _mm256_storeu_si256((__m256i *)out, hi);
+    for (int k = 0; k < 8; k++) if (out[k] > *maxPrice) *maxPrice = out[k];
+    return count + price_range_scalar(prices, active, i, n, minPrice, maxPrice);
+}
+#endif //SCAN_X86
+
+//
+//FUNCTION     : scan_under_budget
+//DESCRIPTION  : Finds the active slots priced at or under a budget
+//PARAMETERS   : const int32_t *prices, const uint64_t *active, uint32_t n -
+//              columns and slot count
+//              int32_t budget - limit in cents (inclusive)
+//              uint32_t *slots, uint32_t max - receives up to max slots in
+//              ascending order; NULL to only count
+//RETURNS      : uint32_t - number of matching slots (may exceed max)
+//
+uint32_t scan_under_budget(const int32_t *prices, const uint64_t *active, uint32_t n,
+                           int32_t budget, uint32_t *slots, uint32_t max) {
+    if (selected < 0) {
+        scan_select(-1);
+    }
+    switch (selected) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            return under_budget_avx2(prices, active, n, budget, slots, max);
+        case SCAN_SSE41:
+            return under_budget_sse41(prices, active, n, budget, slots, max);
+#endif
+        default:
+            return under_budget_scalar(prices, active, 0, n, budget, slots, max, 0);
+    }
+}
+
+//
+//FUNCTION     : scan_price_range
+//DESCRIPTION  : Cheapest and most expensive active price, and the number
+//              of active slots
+//PARAMETERS   : const int32_t *prices, const uint64_t *active, uint32_t n -
+//              columns and slot count
+//              int32_t *minPrice, *maxPrice - receive the range in cents
+//              (both 0 when no slot is active)
+//RETURNS      : uint32_t - active slots
+//
+uint32_t scan_price_range(const int32_t *prices, const uint64_t *active, uint32_t n,
+                          int32_t *minPrice, int32_t *maxPrice) {
+    uint32_t count;
+
+    if (selected < 0) {
+        scan_select(-1);
+    }
+    *minPrice = INT_MAX;
+    *maxPrice = INT_MIN;
+    switch (selected) {
+#ifdef SCAN_X86
+        case SCAN_AVX2:
+            count = price_range_avx2(prices, active, n, minPrice, maxPrice);
+            break;
+        case SCAN_SSE41:
+            count = price_range_sse41(prices, active, n, minPrice, maxPrice);
+            break;
+#endif
+        default:
+            count = price_range_scalar(prices, active, 0, n, minPrice, maxPrice);
+            break;
+    }
+    if (count == 0) {
+        *minPrice = *maxPrice = 0;
+    }
+    return count;
+}
@@ -0,0 +1,197 @@
+//
+//FILE               : search.c
+//PROJECT            : SysProg Assign 3
+//PROGRAMMER         : Rodrigo P Gomes
+//FIRST VERSION      : 2025-12-06
+//DESCRIPTION        : Destination prefix, price range and cheapest-K
+//                     queries over the catalog. Writers keep the active
+//                     slots sorted by name and by price inside the segment
+//                     (see catalog_write_end); these functions only binary
+//                     search those orders inside a lock-free read and copy
+//                     the matching trips out.
+//
+
+#include "search.h"
+
+//Which order a span refers to
+#define ORDER_NAME  0
+#define ORDER_PRICE 1
+
+//
+//FUNCTION     : prefix_compare
+//DESCRIPTION  : Compares a destination against a prefix, looking only at
+//              the prefix's length
+//PARAMETERS   : const char *destination, const char *prefix
+//              size_t len - strlen(prefix)
+//RETURNS      : int - <0 if destination sorts before every match, 0 on a
+//              match, >0 after
+//
+static int prefix_compare(const char *destination, const char *prefix, size_t len) {
+    return strncmp(destination, prefix, len < MAX_NAME ? len : MAX_NAME);
+}
+
+//
+//FUNCTION     : name_bound
+//DESCRIPTION  : First position in byName whose destination compares
+//              above (upper) or at-or-above (lower) the prefix
+//PARAMETERS   : const CatalogColumns *cols, const Trip *trips
+//              const char *prefix, size_t len, int upper - 0 or 1
+//RETURNS      : uint32_t - position in [0, sortedCount]
+//
+static uint32_t name_bound(const CatalogColumns *cols, const Trip *trips,
+                           const char *prefix, size_t len, int upper) {
+    uint32_t lo = 0, hi = cols->sortedCount;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t slot = cols->byName[mid];
+        int c = (slot < cols->count) ? prefix_compare(trips[slot].destination, prefix, len) : 1;
+
+        if (c < 0 || (upper && c == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//
+//FUNCTION     : price_bound
+//DESCRIPTION  : First position in byPrice whose price is at or above a
+//              limit
+//PARAMETERS   : const CatalogColumns *cols, int64_t cents - limit
+//RETURNS      : uint32_t - position in [0, sortedCount]
+//
+static uint32_t price_bound(const CatalogColumns *cols, int64_t cents) {
+    uint32_t lo = 0, hi = cols->sortedCount;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t slot = cols->byPrice[mid];
+
+        if (slot < cols->count && cols->prices[slot] < cents) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//
+//FUNCTION     : copy_span
+//DESCRIPTION  : Copies the trips at positions [first, last) of one order
+//PARAMETERS   : const CatalogColumns *cols, const Trip *trips
+//              int order - ORDER_NAME or ORDER_PRICE
+//              uint32_t first, last - span, TripMatch *out, uint32_t max
+//RETURNS      : Nothing
+//
+static void copy_span(const CatalogColumns *cols, const Trip *trips, int order,
+                      uint32_t first, uint32_t last, TripMatch *out, uint32_t max) {
+    const uint32_t *slots = (order == ORDER_NAME) ? cols->byName : cols->byPrice;
+
+    for (uint32_t i = first; i < last && i - first < max; i++) {
+        uint32_t slot = slots[i];
+        if (slot < cols->count) {
+            out[i - first].slot = slot;
+            out[i - first].trip = trips[slot];
+        }
+    }
+}
+
+//
+//FUNCTION     : search_prefix
+//DESCRIPTION  : Active trips whose destination starts with a prefix, in
+//              name order (an empty prefix matches every trip)
+//PARAMETERS   : Catalog *cat - attachment, const char *prefix
+//              TripMatch *out, uint32_t max - receives up to max matches
+//              unsigned int *version - receives the catalog version
+//RETURNS      : uint32_t - number of matches (may exceed max)
+//
+uint32_t search_prefix(Catalog *cat, const char *prefix, TripMatch *out, uint32_t max,
+                       unsigned int *version) {
+    size_t len = strlen(prefix);
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t total = 0;
+
+        if (catalog_columns(cat, &cols) == 0) {
+            Trip *trips = catalog_records(cat, cols.count);
+            if (trips != NULL) {
+                uint32_t first = name_bound(&cols, trips, prefix, len, 0);
+                uint32_t last  = name_bound(&cols, trips, prefix, len, 1);
+                total = last - first;
+                copy_span(&cols, trips, ORDER_NAME, first, last, out, max);
+            }
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            *version = seq;
+            return total;
+        }
+    }
+}
+
+//
+//FUNCTION     : search_price_range
+//DESCRIPTION  : Active trips priced within [loCents, hiCents], cheapest
+//              first
+//PARAMETERS   : Catalog *cat - attachment, int32_t loCents, hiCents
+//              TripMatch *out, uint32_t max - receives up to max matches
+//              unsigned int *version - receives the catalog version
+//RETURNS      : uint32_t - number of matches (may exceed max)
+//
+uint32_t search_price_range(Catalog *cat, int32_t loCents, int32_t hiCents,
+                            TripMatch *out, uint32_t max, unsigned int *version) {
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t total = 0;
+
+        if (catalog_columns(cat, &cols) == 0 && loCents <= hiCents) {
+            Trip *trips = catalog_records(cat, cols.count);
+            if (trips != NULL) {
+                uint32_t first = price_bound(&cols, loCents);
+                uint32_t last  = price_bound(&cols, (int64_t)hiCents + 1);
+                total = last - first;
+                copy_span(&cols, trips, ORDER_PRICE, first, last, out, max);
+            }
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            *version = seq;
+            return total;
+        }
+    }
+}
+
+//
+//FUNCTION     : search_cheapest
+//DESCRIPTION  : The k cheapest active trips, cheapest first
+//PARAMETERS   : Catalog *cat - attachment, uint32_t k
+//              TripMatch *out - room for k matches
+//              unsigned int *version - receives the catalog version
+//RETURNS      : uint32_t - number of matches copied (<= k)
+//
+uint32_t search_cheapest(Catalog *cat, uint32_t k, TripMatch *out, unsigned int *version) {
+    CatalogColumns cols;
+
+    while (1) {
+        unsigned int seq = catalog_read_begin(cat);
+        uint32_t total = 0;
+
+        if (catalog_columns(cat, &cols) == 0) {
+            Trip *trips = catalog_records(cat, cols.count);
+            if (trips != NULL) {
+                total = (cols.sortedCount < k) ? cols.sortedCount : k;
+                copy_span(&cols, trips, ORDER_PRICE, 0, total, out, k);
+            }
+        }
+        if (!catalog_read_retry(cat, seq)) {
+            *version = seq;
+            return total;
+        }
+    }
+}
@@ -5,33 +5,179 @@
 //FIRST VERSION : Nov 19 2025
 //DESCRIPTION   : TCP server that accepts multiple client connections,
 //               receives client data, and displays it.
-//               Uses fork() to handle multiple clients.
+//               Uses a non-blocking epoll event loop so every connected
+//               client is served concurrently. With --workers N it forks
+//               N worker processes, each with its own SO_REUSEPORT
+//               listener pinned to a CPU, sharing one stats segment.
+//               Bookings are priced against the live catalog, read
+//               lock-free; stale quotes are rejected and seats are
+//               reserved per trip with compare-and-swap.
+//               Accepted bookings are written to the booking journal by
+//               an I/O thread per worker (group commit); a client's acks
+//               are sent once its bookings are on disk. On startup the
+//               totals are recovered from the last checkpoint plus the
+//               journal written after it; a checkpoint thread keeps the
+//               checkpoint current.
+//               Rolling 1/5/15 minute rates, revenue and top destinations
+//               are kept in per-worker time buckets and sent to a client
+//               that presses F2.
+//               Screen output is queued to a render thread that redraws
+//               at a fixed frame rate (see display.h); with --headless
+//               there is no screen and the same events go to a binary
+//               log instead (decode it with logdump). Workers cannot
+//               share one ncurses screen, so --workers above 1 needs
+//               --headless.
+//               Connections, bookings, bytes, F1/F2 signals and the
+//               recv-to-accounted and catalog lock latencies are served
+//               in Prometheus format on 127.0.0.1 (see metrics.h).
 //               [NCURSES] Enhanced with ncurses GUI windows.
 //
 
+#define _GNU_SOURCE
 #include "ipc_shared.h"
-#include <ncurses.h>  //[NCURSES]
+#include "protocol.h"
+#include "catalog.h"
+#include "search.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "rates.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "display.h"  //[NCURSES]
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+//Per-connection state kept by the event loop
+typedef struct Connection {
+    int fd;                 //Client socket (non-blocking)
+    int clientNum;          //Client identifier shown on screen
+    int wantWrite;          //EPOLLOUT registered while tx is not drained
+    FrameBuffer rx;         //Received bytes not yet parsed into frames
+    FrameBuffer tx;         //Replies not yet accepted by the socket
+    uint64_t recvNs;        //monotonic_ns() of the last recv (metrics)
+    uint64_t commitSeq;     //Journal records its queued acks wait for
+    int waiting;            //On the commit wait list
+    struct Connection *prevWait, *nextWait;
+} Connection;
+
+//Seats check_catalog took for a booking, given back if it is not recorded
+typedef struct {
+    uint32_t slot;          //0-based trip slot
+    unsigned int version;   //Trip version the seats were taken against
+    int seats;              //0 when nothing was taken
+} SeatHold;
+
+//Revenue counters of one worker, alone on a cache line so workers never
+//write the same line. Only the owning worker writes them.
+typedef struct {
+    _Atomic int64_t cents;          //Revenue, in cents
+    _Atomic int64_t bookings;
+} __attribute__((aligned(64))) StatsShard;
+
+//Metrics of one worker, written only by its event loop (metrics_add,
+//hist_record) and summed by the metrics thread on each scrape
+typedef struct {
+    _Atomic uint64_t accepted;      //Connections
+    _Atomic uint64_t refused;
+    _Atomic uint64_t closed;
+    _Atomic uint64_t bytesIn;
+    _Atomic uint64_t bytesOut;
+    _Atomic uint64_t frames;
+    _Atomic uint64_t bookings;      //Accepted, single and batched
+    _Atomic uint64_t rejected;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t signalF1;
+    _Atomic uint64_t signalF2;
+    Histogram recvToAccounted;      //recv() returned until the booking was accounted, ns
+} __attribute__((aligned(64))) WorkerMetrics;
+
+//Accounting shared by every worker process (anonymous shared mapping
+//created before fork). Revenue is kept in per-worker shards and summed
+//only when someone asks for the totals (stats_totals).
+typedef struct {
+    int64_t baseCents;              //Recovered at startup, before the shards
+    int64_t baseBookings;
+    StatsShard shards[MAX_WORKERS];
+    WorkerMetrics metrics[MAX_WORKERS];
+    _Atomic long long nextBookingNumber;  //Last booking number handed out
+    _Atomic int nextClientNum;      //Client numbers are unique server-wide
+    _Atomic int activeClients;      //Checked against max_clients
+} ServerStats;
 
 //Global variables
-float totalPrice = 0.0;
-int recordCount = 0;
+ServerStats *stats = NULL;
+RateWindows *rates = NULL;              //Rolling windows shared with the workers
+Catalog catalog = { -1, NULL, 0, 0 };  //hdr NULL when shm_manager has not created it
 volatile sig_atomic_t running = 1;
 int server_socket = -1;
+int epoll_fd = -1;
+int max_clients = DEFAULT_MAX_CLIENTS;
+int backlog = DEFAULT_BACKLOG;
+int num_workers = 1;
+int worker_id = 0;
+Journal journal;                        //This worker's journal writer
+int journal_on = 1;                     //--no-journal turns it off
+const char *journal_path = JOURNAL_FILE;
+long commit_delay_us = JOURNAL_DEFAULT_DELAY_US;
+long commit_batch = JOURNAL_DEFAULT_BATCH;
+Connection *commit_waiters = NULL;      //Connections holding acks for the journal
+long checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+int headless = 0;                       //--headless: binary log, no ncurses
+const char *log_path = BINLOG_FILE;
+int metrics_port = METRICS_DEFAULT_PORT;
+Catalog metrics_catalog = { -1, NULL, 0, 0 };  //The metrics thread's own attachment
+BookingTotals totals;                   //Journal folded in up to totals.hdr.journalOffset
+pthread_t checkpoint_thread;
+int checkpoint_running = 0;
 
-//[NCURSES] Global ncurses windows
-WINDOW *display_win, *input_win;
+//Decode area for FRAME_BATCH records (one event loop per process)
+static ClientMessage batch[PROTO_MAX_BATCH];
+static BookingAck batch_rejects[PROTO_MAX_BATCH];
+static int batch_accepted[PROTO_MAX_BATCH];
+static int64_t batch_cents[PROTO_MAX_BATCH];
+static SeatHold batch_holds[PROTO_MAX_BATCH];
+static JournalRecord journal_records[PROTO_MAX_BATCH];
 
 //Function prototypes
 void signal_handler(int signum);
-void display_client(ClientMessage *msg);
-void handle_client(int client_socket, int client_num);
+void account_bookings(int64_t cents, int count);
+void stats_totals(int64_t *cents, int64_t *bookings);
+int validate_booking(const ClientMessage *msg);
+int check_catalog(const ClientMessage *msg, int64_t *cents, int32_t *seatsLeft, SeatHold *hold);
+int handle_client(Connection *conn);
+int process_frame(Connection *conn, const FrameHeader *hdr, const uint8_t *payload);
+int process_batch(Connection *conn, const FrameHeader *hdr, const uint8_t *payload);
+int flush_client(Connection *conn);
+int queue_ack(Connection *conn, const BookingAck *ack);
+int send_replies(Connection *conn);
+int journal_bookings(Connection *conn, const ClientMessage *msgs, const int *index,
+                     const int64_t *cents, int count, uint64_t firstNumber);
+void release_commits(void);
+void wait_list_remove(Connection *conn);
+long recover_totals(void);
+void *run_checkpoints(void *arg);
+void start_checkpoints(void);
+void stop_checkpoints(void);
+void start_metrics(void);
+void write_metrics(MetricsText *out);
+void accept_clients(void);
+void close_client(Connection *conn);
+int set_nonblocking(int fd);
+void parse_arguments(int argc, char *argv[]);
+void raise_fd_limit(int wanted);
+int create_listener(void);
+void pin_to_cpu(int id);
+void run_worker(int id);
 void show_total();
+int send_stats(Connection *conn);
 
-int main(void) {
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    int client_socket;
-    int client_count = 0;
+int main(int argc, char *argv[]) {
+    parse_arguments(argc, argv);
+    raise_fd_limit(max_clients + 16);
 
     //Set up signal handler (Ctrl+C encerra o servidor)
     struct sigaction sa;
@@ -43,21 +189,263 @@ int main(void) {
         perror("sigaction");
         exit(1);
     }
+    signal(SIGPIPE, SIG_IGN);
 
-    //Create socket
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket == -1) {
-        perror("Socket creation failed");
+    //Stats segment shared with the workers
+    stats = mmap(NULL, sizeof(ServerStats), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED) {
+        perror("mmap stats");
+        exit(1);
+    }
+    memset(stats, 0, sizeof(ServerStats));
+    rates = rates_create(num_workers);
+    if (rates == NULL) {
+        perror("mmap rates");
         exit(1);
     }
 
-    //Reuse address
-    int opt = 1;
-    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
-        perror("setsockopt");
-        close(server_socket);
+    //Totals survive restarts through the checkpoint and journal
+    uint64_t recoverStart = monotonic_ns();
+    long replayed = journal_on ? recover_totals() : 0;
+    uint64_t recoverNs = monotonic_ns() - recoverStart;
+
+    //Catalog created by shm_manager (the attachment is inherited by workers)
+    catalog_open(&catalog, CATALOG_SHM_NAME);
+
+    //===NCURSES (single worker; parse_arguments enforces it)===
+    if (!headless) {
+        display_init();
+    } else if (display_init_headless(log_path) == -1) {
+        perror(log_path);
         exit(1);
     }
+    if (catalog.hdr == NULL) {
+        display_printf(display_win, "Catalog not found; prices are not checked against it.\n");
+    } else {
+        TripMatch cheapest;
+        unsigned int version;
+        int32_t minCents, maxCents;
+        uint32_t active = catalog_price_range(&catalog, &minCents, &maxCents);
+
+        display_printf(display_win, "Catalog: %u active trips", active);
+        if (search_cheapest(&catalog, 1, &cheapest, &version) == 1) {
+            display_printf(display_win, ", cheapest %s at $%.2f",
+                           cheapest.trip.destination, cheapest.trip.priceCents / 100.0);
+        }
+        display_printf(display_win, "\n");
+    }
+
+    //Initial messages
+    display_printf(display_win, "Server listening on port %d (%d worker%s, max %d clients)...\n",
+                   SERVER_PORT, num_workers, num_workers == 1 ? "" : "s", max_clients);
+    if (journal_on) {
+        display_printf(display_win, "Journal: %s (group commit after %ld us or %ld bookings)\n",
+                       journal_path, commit_delay_us, commit_batch);
+        if (replayed == -1) {
+            display_printf(display_win, "Unable to recover from %s: %s\n", journal_path, strerror(errno));
+        } else {
+            display_printf(display_win, "Recovered %llu bookings ($%lld.%02lld): %ld replayed after "
+                           "the checkpoint in %.2f ms\n",
+                           (unsigned long long)totals.hdr.recordCount,
+                           (long long)(totals.hdr.totalCents / 100),
+                           (long long)(totals.hdr.totalCents % 100), replayed, recoverNs / 1e6);
+        }
+    }
+    if (metrics_port != 0) {
+        display_printf(display_win, "Metrics: http://127.0.0.1:%d/metrics\n", metrics_port);
+    }
+    display_printf(display_win, "Waiting for client connections...\n\n");
+    display_printf(input_win, "Server running. Use Ctrl+C to stop.\n");
+    display_refresh();
+
+    if (num_workers == 1) {
+        start_checkpoints();
+        start_metrics();
+        run_worker(0);
+    } else {
+        for (int i = 0; i < num_workers; i++) {
+            pid_t pid = fork();
+            if (pid == -1) {
+                display_printf(display_win, "fork failed: %s\n", strerror(errno));
+                display_refresh();
+                running = 0;
+                break;
+            }
+            if (pid == 0) {
+                run_worker(i);
+                exit(0);
+            }
+        }
+
+        //Ctrl+C reaches the whole process group; wait for every worker
+        start_checkpoints();
+        start_metrics();
+        while (wait(NULL) > 0 || errno == EINTR) {
+        }
+    }
+
+    //Every journal is closed now; fold in the rest and checkpoint
+    metrics_stop();
+    stop_checkpoints();
+
+    //Cleanup
+    show_total();
+    display_end();
+    int64_t cents, bookings;
+    stats_totals(&cents, &bookings);
+    printf("Records: %lld | Total: $%lld.%02lld\n", (long long)bookings,
+           (long long)(cents / 100), (long long)(cents % 100));
+    munmap(stats, sizeof(ServerStats));
+    rates_destroy(rates);
+    if (catalog.hdr != NULL) {
+        catalog_close(&catalog);
+    }
+    if (metrics_catalog.hdr != NULL) {
+        catalog_close(&metrics_catalog);
+    }
+    return 0;
+}
+
+//
+//FUNCTION     : run_worker
+//DESCRIPTION  : Opens this worker's listener and runs the event loop until
+//              SIGINT
+//PARAMETERS   : int id - worker number (0 when running a single process)
+//RETURNS      : Nothing
+//
+void run_worker(int id) {
+    struct epoll_event ev, events[MAX_EVENTS];
+
+    worker_id = id;
+    if (num_workers > 1) {
+        pin_to_cpu(id);
+    }
+
+    server_socket = create_listener();
+    if (server_socket == -1) {
+        display_refresh();
+        return;
+    }
+
+    //Event loop setup: the listening socket is registered with a NULL
+    //data pointer, every client socket with its Connection
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        display_printf(display_win, "epoll_create1 failed: %s\n", strerror(errno));
+        display_refresh();
+        close(server_socket);
+        return;
+    }
+
+    ev.events   = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &ev) == -1) {
+        display_printf(display_win, "epoll_ctl failed: %s\n", strerror(errno));
+        display_refresh();
+        close(epoll_fd);
+        close(server_socket);
+        return;
+    }
+
+    //The journal's eventfd is registered with the Journal itself as data
+    if (journal_on) {
+        if (journal_open(&journal, journal_path, commit_delay_us, (uint32_t)commit_batch) == -1) {
+            display_printf(display_win, "Unable to open journal %s: %s\n", journal_path, strerror(errno));
+            display_refresh();
+            close(epoll_fd);
+            close(server_socket);
+            return;
+        }
+        ev.events   = EPOLLIN;
+        ev.data.ptr = &journal;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, journal.eventFd, &ev);
+    }
+
+    //From here on the render thread draws; the loop only queues lines
+    if (display_start(id) == -1) {
+        display_printf(display_win, "Render thread not started (%s); drawing inline\n",
+                       strerror(errno));
+    }
+
+    while (running) {
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (ready == -1) {
+            if (errno == EINTR) {
+                //Interrupted by signal, continue loop to check running flag
+                continue;
+            }
+            display_printf(display_win, "epoll_wait failed: %s\n", strerror(errno));
+            display_refresh();
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            Connection *conn = (Connection *)events[i].data.ptr;
+
+            if (conn == NULL) {
+                accept_clients();
+                continue;
+            }
+            if ((void *)conn == &journal) {
+                release_commits();
+                continue;
+            }
+
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) &&
+                !(events[i].events & EPOLLIN)) {
+                display_printf(display_win, "Client %d connection error\n",
+                               conn->clientNum);
+                close_client(conn);
+                continue;
+            }
+
+            if ((events[i].events & EPOLLOUT) && send_replies(conn) == -1) {
+                close_client(conn);
+                continue;
+            }
+
+            if ((events[i].events & EPOLLIN) && handle_client(conn) == -1) {
+                close_client(conn);
+            }
+        }
+    }
+
+    //Draw what is queued, then commit what was accepted before the shutdown
+    display_stop();
+    if (journal_on) {
+        journal_close(&journal);
+    }
+    close(epoll_fd);
+    close(server_socket);
+}
+
+//
+//FUNCTION     : create_listener
+//DESCRIPTION  : Creates a non-blocking listening socket on SERVER_PORT.
+//              SO_REUSEPORT lets every worker bind its own listener and
+//              the kernel spreads incoming connections across them.
+//PARAMETERS   : None
+//RETURNS      : int - listening socket or -1 on error
+//
+int create_listener(void) {
+    struct sockaddr_in server_addr;
+    int opt = 1;
+
+    //Create socket
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) {
+        display_printf(display_win, "Socket creation failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    //Reuse address and port
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1 ||
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        display_printf(display_win, "setsockopt failed: %s\n", strerror(errno));
+        close(sock);
+        return -1;
+    }
 
     //Configure server address
     memset(&server_addr, 0, sizeof(server_addr));
@@ -66,179 +454,998 @@ int main(void) {
     server_addr.sin_port        = htons(SERVER_PORT);
 
     //Bind
-    if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
-        perror("Bind failed");
-        close(server_socket);
-        exit(1);
+    if (bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+        display_printf(display_win, "Bind failed: %s\n", strerror(errno));
+        close(sock);
+        return -1;
     }
 
     //Listen
-    if (listen(server_socket, BACKLOG) == -1) {
-        perror("Listen failed");
-        close(server_socket);
+    if (listen(sock, backlog) == -1 || set_nonblocking(sock) == -1) {
+        display_printf(display_win, "Listen failed: %s\n", strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+//
+//FUNCTION     : pin_to_cpu
+//DESCRIPTION  : Binds the calling worker to one CPU (round robin)
+//PARAMETERS   : int id - worker number
+//RETURNS      : Nothing (the worker stays unpinned on error)
+//
+void pin_to_cpu(int id) {
+    cpu_set_t set;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus < 1) {
+        return;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(id % cpus, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+//
+//FUNCTION     : signal_handler
+//DESCRIPTION  : Handles SIGINT (Ctrl+C) to shutdown server gracefully.
+//              Only clears the running flag; the event loop wakes up
+//              with EINTR and performs the cleanup.
+//PARAMETERS   : int signum - signal number
+//RETURNS      : Nothing
+//
+void signal_handler(int signum) {
+    if (signum == SIGINT) {
+        running = 0;
+    }
+}
+
+//
+//FUNCTION     : parse_arguments
+//DESCRIPTION  : Reads the runtime limits from the command line
+//              (--max-clients N, --backlog N, --workers N) and the
+//              journal settings (--journal FILE, --no-journal,
+//              --commit-delay US, --commit-batch N, --checkpoint SEC;
+//              0 checkpoints only at shutdown), --headless [--log FILE]
+//              and --metrics-port N (0 turns the endpoint off). More than
+//              one worker requires --headless: each would otherwise draw
+//              its own ncurses screen over the same terminal.
+//PARAMETERS   : int argc, char *argv[] - command line
+//RETURNS      : Nothing (exits on invalid usage)
+//
+void parse_arguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-clients") == 0 && i + 1 < argc) {
+            max_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backlog") == 0 && i + 1 < argc) {
+            backlog = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-journal") == 0) {
+            journal_on = 0;
+        } else if (strcmp(argv[i], "--commit-delay") == 0 && i + 1 < argc) {
+            commit_delay_us = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--commit-batch") == 0 && i + 1 < argc) {
+            commit_batch = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_interval = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--max-clients N] [--backlog N] [--workers N]\n"
+                            "       [--journal FILE | --no-journal] [--commit-delay US]"
+                            " [--commit-batch N] [--checkpoint SEC]\n"
+                            "       [--headless [--log FILE]] [--metrics-port N]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+
+    if (max_clients < 1 || backlog < 1) {
+        fprintf(stderr, "Limits must be positive numbers.\n");
         exit(1);
     }
+    if (num_workers < 1 || num_workers > MAX_WORKERS) {
+        fprintf(stderr, "Workers must be between 1 and %d.\n", MAX_WORKERS);
+        exit(1);
+    }
+    if (num_workers > 1 && !headless) {
+        fprintf(stderr, "--workers %d needs --headless: workers cannot share the screen.\n",
+                num_workers);
+        exit(1);
+    }
+    if (metrics_port < 0 || metrics_port > 65535) {
+        fprintf(stderr, "Metrics port must be between 0 and 65535.\n");
+        exit(1);
+    }
+    if (commit_delay_us < 0 || commit_batch < 1 || checkpoint_interval < 0) {
+        fprintf(stderr, "Commit delay and checkpoint interval must be >= 0 "
+                        "and commit batch >= 1.\n");
+        exit(1);
+    }
+}
 
-    //===NCURSES with no fork===
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    refresh();
+//
+//FUNCTION     : raise_fd_limit
+//DESCRIPTION  : Raises the open file limit so max_clients sockets fit
+//PARAMETERS   : int wanted - number of descriptors needed
+//RETURNS      : Nothing (keeps the current limit if it cannot be raised)
+//
+void raise_fd_limit(int wanted) {
+    struct rlimit rl;
 
-    int display_height = DISPLAY_HEIGHT;
-    int input_height   = INPUT_HEIGHT;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1 || rl.rlim_cur >= (rlim_t)wanted) {
+        return;
+    }
 
-    display_win = newwin(display_height, COLS, 0, 0);
-    input_win   = newwin(input_height,  COLS, display_height, 0);
-    scrollok(display_win, TRUE);
-    box(display_win, 0, 0);
-    box(input_win, 0, 0);
-        
-    keypad(input_win, TRUE);
+    rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= (rlim_t)wanted)
+                      ? (rlim_t)wanted
+                      : rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
 
-    //Initial messages
-    wprintw(display_win, "Server listening on port %d...\n", SERVER_PORT);
-    wprintw(display_win, "Waiting for client connections...\n\n");
-    wprintw(input_win, "Server running. Use Ctrl+C to stop.\n");
-    wrefresh(display_win);
-    wrefresh(input_win);
+//
+//FUNCTION     : set_nonblocking
+//DESCRIPTION  : Puts a descriptor in non-blocking mode
+//PARAMETERS   : int fd - descriptor
+//RETURNS      : int - 0 on success, -1 on error
+//
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
 
-    while (running) {
-        client_len = sizeof(client_addr);
+//
+//FUNCTION     : accept_clients
+//DESCRIPTION  : Accepts every pending connection on the listening socket
+//              and registers it with the event loop
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void accept_clients(void) {
+    struct sockaddr_in client_addr;
+    socklen_t client_len;
+    struct epoll_event ev;
 
-        client_socket = accept(server_socket,
-                               (struct sockaddr *)&client_addr,
-                               &client_len);
+    while (1) {
+        client_len = sizeof(client_addr);
+        int client_socket = accept(server_socket,
+                                   (struct sockaddr *)&client_addr,
+                                   &client_len);
         if (client_socket == -1) {
-            if (errno == EINTR) {
-                //Interrupted by signal, continue loop to check running flag
-                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                display_printf(display_win, "Accept failed: %s\n", strerror(errno));
             }
-            wprintw(display_win, "Accept failed: %s\n", strerror(errno));
-            wrefresh(display_win);
+            return;
+        }
+
+        if (atomic_load(&stats->activeClients) >= max_clients) {
+            metrics_add(&stats->metrics[worker_id].refused, 1);
+            display_printf(display_win, "Connection from %s refused (limit %d reached)\n",
+                           inet_ntoa(client_addr.sin_addr), max_clients);
+            close(client_socket);
             continue;
         }
 
-        client_count++;
-        wprintw(display_win, "Client %d connected from %s\n",
-                client_count,
-                inet_ntoa(client_addr.sin_addr));
-        wrefresh(display_win);
+        Connection *conn = calloc(1, sizeof(Connection));
+        if (conn == NULL || set_nonblocking(client_socket) == -1) {
+            display_printf(display_win, "Unable to set up client connection\n");
+            free(conn);
+            close(client_socket);
+            continue;
+        }
 
-        //Handle client in the main process (no fork)
-        handle_client(client_socket, client_count);
+        conn->fd        = client_socket;
+        conn->clientNum = atomic_fetch_add(&stats->nextClientNum, 1) + 1;
 
-        close(client_socket);
-        wprintw(display_win, "Client %d finished.\n", client_count);
-        wrefresh(display_win);
+        ev.events   = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) == -1) {
+            display_printf(display_win, "epoll_ctl failed: %s\n", strerror(errno));
+            free(conn);
+            close(client_socket);
+            continue;
+        }
+
+        atomic_fetch_add(&stats->activeClients, 1);
+        metrics_add(&stats->metrics[worker_id].accepted, 1);
+        display_connected(worker_id, conn->clientNum, client_addr.sin_addr);
     }
+}
 
-    //Cleanup
-    close(server_socket);
-    endwin();
+//
+//FUNCTION     : close_client
+//DESCRIPTION  : Removes a client from the event loop and frees its state
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : Nothing
+//
+void close_client(Connection *conn) {
+    wait_list_remove(conn);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    proto_buffer_free(&conn->rx);
+    proto_buffer_free(&conn->tx);
+    display_closed(conn->clientNum);
+    atomic_fetch_sub(&stats->activeClients, 1);
+    metrics_add(&stats->metrics[worker_id].closed, 1);
+    free(conn);
+}
+
+//
+//FUNCTION     : flush_client
+//DESCRIPTION  : Sends queued replies and keeps EPOLLOUT registered only
+//              while some are still waiting for socket space
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : int - 0 on success, -1 if the connection failed
+//
+int flush_client(Connection *conn) {
+    struct epoll_event ev;
+    size_t queued = conn->tx.len;
+    int pending = proto_buffer_flush(&conn->tx, conn->fd);
+
+    if (pending == -1) {
+        display_printf(display_win, "Error sending to Client %d\n", conn->clientNum);
+        return -1;
+    }
+    metrics_add(&stats->metrics[worker_id].bytesOut, queued - conn->tx.len);
+
+    if (pending != conn->wantWrite) {
+        ev.events   = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+            return -1;
+        }
+        conn->wantWrite = pending;
+    }
     return 0;
 }
 
+//
+//FUNCTION     : validate_booking
+//DESCRIPTION  : Sanity checks a booking received from a client
+//PARAMETERS   : const ClientMessage *msg - booking
+//RETURNS      : int - 1 if valid, 0 otherwise
+//
+int validate_booking(const ClientMessage *msg) {
+    return msg->firstName[0] != '\0' &&
+           msg->destination[0] != '\0' &&
+           msg->age >= MIN_AGE && msg->age <= MAX_AGE &&
+           msg->numPeople >= MIN_PEOPLE && msg->numPeople <= MAX_PEOPLE &&
+           msg->priceCents > 0;
+}
 
 //
-//FUNCTION     : signal_handler
-//DESCRIPTION  : Handles SIGINT (Ctrl+C) to shutdown server gracefully
-//PARAMETERS   : int signum - signal number
-//RETURNS      : Nothing
+//FUNCTION     : check_catalog
+//DESCRIPTION  : Re-validates a booking against the live catalog, read
+//              lock-free. The trip is found by the quoted slot
+//              (interactive clients) or by destination (CSV uploads). A
+//              quote taken before the trip's last change, or one whose
+//              price does not match, is stale. A valid booking then
+//              reserves its seats on the trip.
+//PARAMETERS   : const ClientMessage *msg - validated booking
+//              int64_t *cents - receives the authoritative total price
+//              int32_t *seatsLeft - receives the seats left on the trip
+//              (-1 when the trip has no seat limit)
+//              SeatHold *hold - receives the seats taken, for
+//              catalog_release if the booking is not recorded
+//RETURNS      : int - ACK_OK, ACK_STALE, ACK_UNAVAILABLE or ACK_SOLD_OUT
 //
-void signal_handler(int signum) {
-    if (signum == SIGINT) {
-        running = 0;
-        printf("\n\nReceived SIGINT (Ctrl+C)...\n");
-        show_total();
+int check_catalog(const ClientMessage *msg, int64_t *cents, int32_t *seatsLeft, SeatHold *hold) {
+    Trip trip;
+    int slot;
 
-        if (server_socket != -1) {
-            close(server_socket);
+    *seatsLeft = -1;
+    hold->seats = 0;
+    if (catalog.hdr == NULL) {
+        *cents = msg->priceCents;
+        return ACK_OK;
+    }
+
+    if (msg->tripId > 0) {
+        slot = msg->tripId;
+        if (!catalog_get_trip(&catalog, (uint32_t)(slot - 1), &trip) ||
+            strncmp(trip.destination, msg->destination, MAX_NAME) != 0) {
+            slot = 0;
         }
+    } else {
+        slot = catalog_find_trip(&catalog, msg->destination, &trip);
+    }
+    if (slot == 0 || !trip.active) {
+        return ACK_UNAVAILABLE;
+    }
+    if (msg->catalogVersion != 0 && trip.version > msg->catalogVersion) {
+        return ACK_STALE;
+    }
 
-        endwin(); //[NCURSES]
-        exit(0);
+    //Quotes are exact totals in cents
+    int64_t total;
+    if (!booking_total(trip.priceCents, msg->numPeople, &total)) {
+        return ACK_INVALID;
     }
+    if (msg->priceCents != total) {
+        return ACK_STALE;
+    }
+
+    //Seats are taken against the version just validated, so a trip
+    //edited in between is reported stale rather than oversold
+    if (trip.seats > 0) {
+        int left;
+        switch (catalog_reserve(&catalog, (uint32_t)(slot - 1), trip.version,
+                                msg->numPeople, &left)) {
+            case RESERVE_SOLD_OUT:
+                *seatsLeft = left;
+                return ACK_SOLD_OUT;
+            case RESERVE_CHANGED:
+                return ACK_STALE;
+        }
+        *seatsLeft = left;
+        hold->slot    = (uint32_t)(slot - 1);
+        hold->version = trip.version;
+        hold->seats   = msg->numPeople;
+    }
+    *cents = total;
+    return ACK_OK;
 }
 
 //
-//FUNCTION     : display_client
-//DESCRIPTION  : Displays client message in one formatted line
-//PARAMETERS   : ClientMessage *msg - client message structure
+//FUNCTION     : account_bookings
+//DESCRIPTION  : Adds bookings to this worker's shard of the totals. The
+//              worker is the shard's only writer, so a plain load and
+//              store is enough (no locked instruction, no shared line).
+//PARAMETERS   : int64_t cents - revenue of the bookings
+//              int count - number of bookings
 //RETURNS      : Nothing
 //
-void display_client(ClientMessage *msg) {
-    //[NCURSES] Use ncurses output
-    wprintw(display_win, "Client%d | %s %s | Age:%d | %s | %s | People:%d | $%.2f\n",
-           msg->clientId,
-           msg->firstName,
-           msg->lastName,
-           msg->age,
-           msg->address,
-           msg->destination,
-           msg->numPeople,
-           msg->tripPrice);
-    wrefresh(display_win);
+void account_bookings(int64_t cents, int count) {
+    StatsShard *shard = &stats->shards[worker_id];
 
-    totalPrice += msg->tripPrice;
-    recordCount++;
+    atomic_store_explicit(&shard->cents,
+                          atomic_load_explicit(&shard->cents, memory_order_relaxed) + cents,
+                          memory_order_relaxed);
+    atomic_store_explicit(&shard->bookings,
+                          atomic_load_explicit(&shard->bookings, memory_order_relaxed) + count,
+                          memory_order_relaxed);
+}
+
+//
+//FUNCTION     : stats_totals
+//DESCRIPTION  : Merges the recovered totals and every worker's shard
+//PARAMETERS   : int64_t *cents - receives the revenue, in cents
+//              int64_t *bookings - receives the bookings
+//RETURNS      : Nothing
+//
+void stats_totals(int64_t *cents, int64_t *bookings) {
+    *cents    = stats->baseCents;
+    *bookings = stats->baseBookings;
+    for (int i = 0; i < num_workers; i++) {
+        *cents    += atomic_load_explicit(&stats->shards[i].cents, memory_order_relaxed);
+        *bookings += atomic_load_explicit(&stats->shards[i].bookings, memory_order_relaxed);
+    }
 }
 
 //
 //FUNCTION     : show_total
-//DESCRIPTION  : Displays summary of total records and price
+//DESCRIPTION  : Displays summary of total records and price across all
+//              workers
 //PARAMETERS   : None
 //RETURNS      : Nothing
 //
 void show_total() {
-    printf("\n=== SUMMARY ===\n");
-    printf("Records: %d | Total: $%.2f\n\n", recordCount, totalPrice);
+    int64_t cents, bookings;
+
+    stats_totals(&cents, &bookings);
+
+    //[NCURSES] Show in ncurses input window
+    display_printf(input_win, "=== SUMMARY ===\n");
+    display_printf(input_win, "Records: %lld | Total: $%lld.%02lld\n", (long long)bookings,
+                   (long long)(cents / 100), (long long)(cents % 100));
+    display_refresh();
+}
+
+//
+//FUNCTION     : send_stats
+//DESCRIPTION  : Queues a FRAME_STATS with the lifetime totals and the
+//              1, 5 and 15 minute windows for a client that pressed F2
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int send_stats(Connection *conn) {
+    static uint8_t reply[PROTO_MAX_STATS];
+    StatsReport report;
+    int64_t cents, bookings;
+
+    memset(&report, 0, sizeof(report));
+    stats_totals(&cents, &bookings);
+    report.bookings = (uint64_t)bookings;
+    report.cents    = cents;
+    if (rates_report(rates, monotonic_ns(), &report) == -1) {
+        display_printf(display_win, "Rolling windows incomplete: out of memory\n");
+    }
 
-    //[NCURSES] Also show in ncurses input window
-    wprintw(input_win, "=== SUMMARY ===\n");
-    wprintw(input_win, "Records: %d | Total: $%.2f\n", recordCount, totalPrice);
-    wrefresh(input_win);
+    int len = proto_encode_stats(&report, reply, sizeof(reply));
+    if (len == -1) {
+        return -1;
+    }
+    return proto_buffer_append(&conn->tx, reply, (size_t)len);
 }
 
 //
 //FUNCTION     : handle_client
-//DESCRIPTION  : Handles communication with a connected client
-//PARAMETERS   : int client_socket - socket descriptor for client
-//              int client_num - client identifier number
-//RETURNS      : Nothing
+//DESCRIPTION  : Pulls everything currently available from a client socket
+//              into its receive buffer and processes every complete frame
+//              in one pass; a partial frame stays buffered for next time
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : int - 0 to keep the connection, -1 to close it
 //
-void handle_client(int client_socket, int client_num) {
-    ClientMessage msg;
+int handle_client(Connection *conn) {
     ssize_t bytes_received;
+    FrameHeader hdr;
+    size_t used = 0;
+    int status;
+    int result = 0;
 
-    while (1) {
-        bytes_received = recv(client_socket, &msg, sizeof(ClientMessage), 0);
+    bytes_received = proto_buffer_fill(&conn->rx, conn->fd);
 
-        if (bytes_received <= 0) {
-            //Client disconnected or error
-            if (bytes_received == 0) {
-                wprintw(display_win, "Client %d disconnected\n", client_num);
-            } else {
-                wprintw(display_win, "Error receiving from Client %d\n", client_num);
-            }
-            wrefresh(display_win);
-            break;
+    if (bytes_received <= 0) {
+        if (bytes_received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;   //Nothing to read yet, wait for the next event
+        }
+        //Client disconnected or error
+        if (bytes_received == 0) {
+            display_printf(display_win, "Client %d disconnected\n", conn->clientNum);
+        } else {
+            display_printf(display_win, "Error receiving from Client %d\n", conn->clientNum);
         }
+        return -1;
+    }
+    conn->recvNs = monotonic_ns();
+    metrics_add(&stats->metrics[worker_id].bytesIn, (uint64_t)bytes_received);
+
+    while ((status = proto_parse_header(conn->rx.data + used,
+                                        conn->rx.len - used, &hdr)) == 1) {
+        const uint8_t *payload = conn->rx.data + used + PROTO_HEADER_SIZE;
+        used += PROTO_HEADER_SIZE + hdr.length;
+        metrics_add(&stats->metrics[worker_id].frames, 1);
 
-        //Check for control signals
-        if (msg.signal == SIGNAL_F1) {
-            wprintw(display_win, "Client %d sent exit signal\n", client_num);
-            wrefresh(display_win);
+        if (process_frame(conn, &hdr, payload) == -1) {
+            result = -1;
             break;
-        } else if (msg.signal == SIGNAL_F2) {
-            wprintw(display_win, "Client %d requested total display\n", client_num);
-            wrefresh(display_win);
-            show_total();
+        }
+    }
+
+    if (status == -1) {
+        display_printf(display_win, "Client %d sent an invalid frame\n", conn->clientNum);
+        result = -1;
+    }
+
+    proto_buffer_consume(&conn->rx, used);
+
+    //Replies produced by this pass go out in one send
+    if (result == 0 && conn->tx.len > 0) {
+        result = send_replies(conn);
+    }
+    return result;
+}
+
+//
+//FUNCTION     : process_frame
+//DESCRIPTION  : Handles one decoded frame from a client
+//PARAMETERS   : Connection *conn - client connection
+//              const FrameHeader *hdr - frame header
+//              const uint8_t *payload - frame payload (hdr->length bytes)
+//RETURNS      : int - 0 to keep the connection, -1 to close it
+//
+int process_frame(Connection *conn, const FrameHeader *hdr, const uint8_t *payload) {
+    WorkerMetrics *m = &stats->metrics[worker_id];
+    ClientMessage msg;
+
+    switch (hdr->type) {
+        case FRAME_SIGNAL:
+            if (hdr->length < 1) {
+                return -1;
+            }
+            //Check for control signals
+            if (payload[0] == SIGNAL_F1) {
+                metrics_add(&m->signalF1, 1);
+                display_printf(display_win, "Client %d sent exit signal\n", conn->clientNum);
+                return -1;
+            } else if (payload[0] == SIGNAL_F2) {
+                metrics_add(&m->signalF2, 1);
+                display_printf(display_win, "Client %d requested total display\n", conn->clientNum);
+                show_total();
+                return send_stats(conn);
+            }
+            return 0;
+
+        case FRAME_BOOKING: {
+            if (proto_decode_booking(payload, hdr->length, &msg) == -1) {
+                display_printf(display_win, "Client %d sent a malformed booking\n", conn->clientNum);
+                return -1;
+            }
+            msg.clientId = conn->clientNum;  //Assign client ID
+
+            BookingAck ack = { msg.requestId, ACK_INVALID, 0, 0, -1 };
+            SeatHold hold = { 0, 0, 0 };
+            if (validate_booking(&msg)) {
+                ack.status = (uint8_t)check_catalog(&msg, &ack.priceCents, &ack.seatsLeft, &hold);
+            }
+
+            //Journaled before anything is accounted: a booking the journal
+            //cannot take is not made at all
+            if (ack.status == ACK_OK) {
+                msg.priceCents = ack.priceCents;
+                ack.bookingNumber = (uint64_t)atomic_fetch_add(&stats->nextBookingNumber, 1) + 1;
+                if (journal_bookings(conn, &msg, NULL, &ack.priceCents, 1,
+                                     ack.bookingNumber) == -1) {
+                    if (hold.seats > 0) {
+                        catalog_release(&catalog, hold.slot, hold.version, hold.seats);
+                    }
+                    ack.status = ACK_NOT_RECORDED;
+                    ack.bookingNumber = 0;
+                    ack.seatsLeft = -1;
+                }
+            }
+            if (ack.status != ACK_OK) {
+                metrics_add(&m->rejected, 1);
+                display_printf(display_win, "Client %d booking rejected: %s\n",
+                               conn->clientNum, proto_status_text(ack.status));
+                ack.priceCents = 0;
+                return queue_ack(conn, &ack);
+            }
+            display_post_client(&msg);
+            account_bookings(ack.priceCents, 1);
+            uint64_t now = monotonic_ns();
+            metrics_add(&m->bookings, 1);
+            hist_record(&m->recvToAccounted, now - conn->recvNs, 1);
+            rates_add(rates, worker_id, now, msg.destination, ack.priceCents);
+            return queue_ack(conn, &ack);
+        }
+
+        case FRAME_BATCH:
+            return process_batch(conn, hdr, payload);
+
+        default:
+            display_printf(display_win, "Client %d sent unknown frame type %d\n",
+                           conn->clientNum, hdr->type);
+            return -1;
+    }
+}
+
+//
+//FUNCTION     : process_batch
+//DESCRIPTION  : Accounts a whole FRAME_BATCH in one pass: the records are
+//              validated and summed locally, the shared totals are updated
+//              once, one summary line is displayed and a single
+//              FRAME_BATCH_ACK is queued for the client
+//              Accepted records get consecutive booking numbers from a
+//              single fetch-and-add and are journaled together before
+//              anything is accounted; if the journal cannot take them,
+//              their seats are given back and they are all rejected.
+//PARAMETERS   : Connection *conn - client connection
+//              const FrameHeader *hdr - frame header
+//              const uint8_t *payload - frame payload
+//RETURNS      : int - 0 to keep the connection, -1 to close it
+//
+int process_batch(Connection *conn, const FrameHeader *hdr, const uint8_t *payload) {
+    static uint8_t reply[PROTO_MAX_BATCH_ACK];
+    BatchAck ack = { 0, 0, 0, 0 };
+    int count = proto_decode_batch(payload, hdr->length, batch, PROTO_MAX_BATCH);
+
+    if (count == -1) {
+        display_printf(display_win, "Client %d sent a malformed batch\n", conn->clientNum);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int64_t cents = 0;
+        int32_t seatsLeft;
+        int status = ACK_INVALID;
+
+        batch[i].clientId = conn->clientNum;
+        if (validate_booking(&batch[i])) {
+            status = check_catalog(&batch[i], &cents, &seatsLeft, &batch_holds[ack.accepted]);
+        }
+        if (status == ACK_OK) {
+            batch_accepted[ack.accepted] = i;
+            batch_cents[ack.accepted]    = cents;
+            ack.accepted++;
+            ack.totalCents += (uint64_t)cents;
         } else {
-            //Normal data message
-            msg.clientId = client_num;  //Assign client ID
-            display_client(&msg);
+            batch_rejects[ack.rejected].requestId = batch[i].requestId;
+            batch_rejects[ack.rejected].status    = (uint8_t)status;
+            ack.rejected++;
+        }
+    }
+
+    if (ack.accepted > 0) {
+        ack.firstBookingNumber =
+            (uint64_t)atomic_fetch_add(&stats->nextBookingNumber, ack.accepted) + 1;
+        if (journal_bookings(conn, batch, batch_accepted, batch_cents, ack.accepted,
+                             ack.firstBookingNumber) == -1) {
+            for (int k = 0; k < ack.accepted; k++) {
+                if (batch_holds[k].seats > 0) {
+                    catalog_release(&catalog, batch_holds[k].slot, batch_holds[k].version,
+                                    batch_holds[k].seats);
+                }
+                batch_rejects[ack.rejected].requestId = batch[batch_accepted[k]].requestId;
+                batch_rejects[ack.rejected].status    = ACK_NOT_RECORDED;
+                ack.rejected++;
+            }
+            ack.accepted = 0;
+            ack.totalCents = 0;
+            ack.firstBookingNumber = 0;
         }
     }
+    account_bookings((int64_t)ack.totalCents, ack.accepted);
+    uint64_t now = monotonic_ns();
+    WorkerMetrics *m = &stats->metrics[worker_id];
+    metrics_add(&m->batches, 1);
+    metrics_add(&m->bookings, ack.accepted);
+    metrics_add(&m->rejected, ack.rejected);
+    if (ack.accepted > 0) {
+        hist_record(&m->recvToAccounted, now - conn->recvNs, ack.accepted);
+    }
+    for (int k = 0; k < ack.accepted; k++) {
+        rates_add(rates, worker_id, now, batch[batch_accepted[k]].destination, batch_cents[k]);
+    }
+    display_batch(conn->clientNum, count, ack.accepted, ack.rejected, (int64_t)ack.totalCents);
+
+    int len = proto_encode_batch_ack(&ack, batch_rejects, reply, sizeof(reply));
+    return proto_buffer_append(&conn->tx, reply, (size_t)len);
+}
+
+//
+//FUNCTION     : queue_ack
+//DESCRIPTION  : Queues a FRAME_ACK; it is sent with the other replies of
+//              the same read pass so pipelined requests share one send
+//PARAMETERS   : Connection *conn - client connection
+//              const BookingAck *ack - booking result
+//RETURNS      : int - 0 on success, -1 if out of memory
+//
+int queue_ack(Connection *conn, const BookingAck *ack) {
+    uint8_t reply[PROTO_MAX_ACK];
+    int len = proto_encode_ack(ack, reply, sizeof(reply));
+
+    return proto_buffer_append(&conn->tx, reply, (size_t)len);
+}
+
+//
+//FUNCTION     : journal_bookings
+//DESCRIPTION  : Queues accepted bookings for the journal, all or none.
+//              Called before they are accounted; the client's acks are
+//              held until the records are committed.
+//PARAMETERS   : Connection *conn - client connection
+//              const ClientMessage *msgs - bookings
+//              const int *index - which msgs to journal (NULL: the first
+//              count), const int64_t *cents - authoritative totals
+//              int count - bookings, uint64_t firstNumber - booking
+//              number of the first (the rest follow consecutively)
+//RETURNS      : int - 0 on success (or journal off), -1 if the journal
+//              is out of memory (nothing was queued)
+//
+int journal_bookings(Connection *conn, const ClientMessage *msgs, const int *index,
+                     const int64_t *cents, int count, uint64_t firstNumber) {
+    struct timespec ts;
+
+    if (!journal_on) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    for (int k = 0; k < count; k++) {
+        const ClientMessage *msg = &msgs[index != NULL ? index[k] : k];
+        JournalRecord *rec = &journal_records[k];
+
+        memset(rec, 0, sizeof(JournalRecord));
+        rec->bookingNumber = firstNumber + (uint64_t)k;
+        rec->timeNs        = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        rec->priceCents    = cents[k];
+        rec->numPeople     = msg->numPeople;
+        rec->clientId      = msg->clientId;
+        memcpy(rec->destination, msg->destination, MAX_NAME);
+    }
+
+    uint64_t seq = journal_append_batch(&journal, journal_records, (uint32_t)count);
+    if (seq == 0) {
+        display_printf(display_win, "Client %d: %d booking%s not journaled (out of memory); "
+                       "rejected\n", conn->clientNum, count, count == 1 ? "" : "s");
+        return -1;
+    }
+    conn->commitSeq = seq;
+    return 0;
+}
+
+//
+//FUNCTION     : send_replies
+//DESCRIPTION  : Sends the queued replies if every booking they
+//              acknowledge is in the journal; otherwise parks the
+//              connection on the commit wait list until it is
+//              (release_commits)
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : int - 0 on success, -1 if the connection failed
+//
+int send_replies(Connection *conn) {
+    if (!journal_on || conn->commitSeq <= journal_durable(&journal)) {
+        return flush_client(conn);
+    }
+    if (conn->waiting) {
+        return 0;
+    }
+
+    //No EPOLLOUT while parked, or the loop would spin on it
+    if (conn->wantWrite) {
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) == -1) {
+            return -1;
+        }
+        conn->wantWrite = 0;
+    }
+    conn->waiting  = 1;
+    conn->prevWait = NULL;
+    conn->nextWait = commit_waiters;
+    if (commit_waiters != NULL) {
+        commit_waiters->prevWait = conn;
+    }
+    commit_waiters = conn;
+    return 0;
+}
+
+//
+//FUNCTION     : wait_list_remove
+//DESCRIPTION  : Takes a connection off the commit wait list
+//PARAMETERS   : Connection *conn - client connection
+//RETURNS      : Nothing
+//
+void wait_list_remove(Connection *conn) {
+    if (!conn->waiting) {
+        return;
+    }
+    if (conn->prevWait != NULL) {
+        conn->prevWait->nextWait = conn->nextWait;
+    } else {
+        commit_waiters = conn->nextWait;
+    }
+    if (conn->nextWait != NULL) {
+        conn->nextWait->prevWait = conn->prevWait;
+    }
+    conn->waiting = 0;
+    conn->prevWait = conn->nextWait = NULL;
+}
+
+//
+//FUNCTION     : release_commits
+//DESCRIPTION  : Runs when the I/O thread finishes a group commit: sends
+//              the replies of every parked connection whose bookings are
+//              now durable
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void release_commits(void) {
+    static int reported = 0;
+    uint64_t count;
+
+    if (read(journal.eventFd, &count, sizeof(count)) == -1) {
+        return;     //Spurious wakeup
+    }
+    int error = atomic_load(&journal.error);
+    if (error != 0 && !reported) {
+        display_printf(display_win, "Journal write failed: %s; acks held until it succeeds\n",
+                       strerror(error));
+        reported = 1;
+    } else if (error == 0 && reported) {
+        display_printf(display_win, "Journal writes resumed\n");
+        reported = 0;
+    }
+
+    uint64_t durable = journal_durable(&journal);
+    Connection *conn = commit_waiters;
+    while (conn != NULL) {
+        Connection *next = conn->nextWait;
+        if (conn->commitSeq <= durable) {
+            wait_list_remove(conn);
+            if (flush_client(conn) == -1) {
+                close_client(conn);
+            }
+        }
+        conn = next;
+    }
+}
+
+//
+//FUNCTION     : recover_totals
+//DESCRIPTION  : Restores the server totals after a restart or crash: maps
+//              the last checkpoint, replays the journal records written
+//              after it (cutting off a torn tail) and saves a fresh
+//              checkpoint if anything was replayed. Runs before any
+//              worker starts.
+//PARAMETERS   : None
+//RETURNS      : long - journal records replayed, -1 on error
+//
+long recover_totals(void) {
+    if (checkpoint_load(&totals, CHECKPOINT_FILE) == -1 && errno != ENOENT) {
+        totals_init(&totals);   //Damaged: rebuild from the whole journal
+    }
+
+    long replayed = journal_replay(&totals, journal_path, 1);
+    if (replayed > 0) {
+        checkpoint_save(&totals, CHECKPOINT_FILE);
+    }
+
+    stats->baseBookings = (int64_t)totals.hdr.recordCount;
+    stats->baseCents    = totals.hdr.totalCents;
+    atomic_store(&stats->nextBookingNumber, (long long)totals.hdr.lastBookingNumber);
+    return replayed;
+}
+
+//
+//FUNCTION     : run_checkpoints
+//DESCRIPTION  : Checkpoint thread: every checkpoint_interval seconds
+//              folds the newly synced journal records into the totals
+//              and saves a checkpoint if there were any
+//PARAMETERS   : void *arg - unused
+//RETURNS      : void * - NULL
+//
+void *run_checkpoints(void *arg) {
+    struct timespec tick = { 0, 100000000 };    //Checks running every 100 ms
+    long ticks = 0;
+
+    (void)arg;
+    while (running) {
+        nanosleep(&tick, NULL);
+        if (++ticks < checkpoint_interval * 10) {
+            continue;
+        }
+        ticks = 0;
+        if (journal_replay(&totals, journal_path, 0) > 0) {
+            checkpoint_save(&totals, CHECKPOINT_FILE);
+        }
+    }
+    return NULL;
+}
+
+//
+//FUNCTION     : start_checkpoints / stop_checkpoints
+//DESCRIPTION  : Starts the checkpoint thread in the main process (after
+//              the workers are forked) / stops it and writes the final
+//              checkpoint once every journal is closed
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void start_checkpoints(void) {
+    sigset_t all, old;
+
+    if (!journal_on || checkpoint_interval == 0) {
+        return;
+    }
+
+    //SIGINT must interrupt the event loop, not this thread
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    checkpoint_running = pthread_create(&checkpoint_thread, NULL, run_checkpoints, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void stop_checkpoints(void) {
+    if (!journal_on) {
+        return;
+    }
+    if (checkpoint_running) {
+        pthread_join(checkpoint_thread, NULL);
+        checkpoint_running = 0;
+    }
+    if (journal_replay(&totals, journal_path, 0) > 0) {
+        checkpoint_save(&totals, CHECKPOINT_FILE);
+    }
+    totals_free(&totals);
+}
+
+//
+//FUNCTION     : start_metrics
+//DESCRIPTION  : Starts the metrics endpoint in the main process (after
+//              the workers are forked). The metrics thread gets its own
+//              catalog attachment so it never remaps the event loop's.
+//PARAMETERS   : None
+//RETURNS      : Nothing (the server runs without metrics on error)
+//
+void start_metrics(void) {
+    if (metrics_port == 0) {
+        return;
+    }
+    if (catalog.hdr != NULL) {
+        catalog_open(&metrics_catalog, CATALOG_SHM_NAME);
+    }
+    if (metrics_start(metrics_port, write_metrics) == -1) {
+        display_printf(display_win, "Metrics endpoint not started on port %d: %s\n",
+                       metrics_port, strerror(errno));
+        display_refresh();
+    }
+}
+
+//
+//FUNCTION     : write_metrics
+//DESCRIPTION  : Fills in one scrape (metrics thread): every worker's
+//              counters summed and histograms merged, the revenue
+//              totals and the catalog writer lock histograms
+//PARAMETERS   : MetricsText *out - scrape text
+//RETURNS      : Nothing
+//
+void write_metrics(MetricsText *out) {
+    static WorkerMetrics sum;
+    static Histogram lockWait, lockHold;
+    int64_t cents, bookings;
+
+    memset(&sum, 0, sizeof(sum));
+    for (int i = 0; i < num_workers; i++) {
+        WorkerMetrics *m = &stats->metrics[i];
+        metrics_add(&sum.accepted, atomic_load_explicit(&m->accepted, memory_order_relaxed));
+        metrics_add(&sum.refused, atomic_load_explicit(&m->refused, memory_order_relaxed));
+        metrics_add(&sum.closed, atomic_load_explicit(&m->closed, memory_order_relaxed));
+        metrics_add(&sum.bytesIn, atomic_load_explicit(&m->bytesIn, memory_order_relaxed));
+        metrics_add(&sum.bytesOut, atomic_load_explicit(&m->bytesOut, memory_order_relaxed));
+        metrics_add(&sum.frames, atomic_load_explicit(&m->frames, memory_order_relaxed));
+        metrics_add(&sum.bookings, atomic_load_explicit(&m->bookings, memory_order_relaxed));
+        metrics_add(&sum.rejected, atomic_load_explicit(&m->rejected, memory_order_relaxed));
+        metrics_add(&sum.batches, atomic_load_explicit(&m->batches, memory_order_relaxed));
+        metrics_add(&sum.signalF1, atomic_load_explicit(&m->signalF1, memory_order_relaxed));
+        metrics_add(&sum.signalF2, atomic_load_explicit(&m->signalF2, memory_order_relaxed));
+        hist_merge(&sum.recvToAccounted, &m->recvToAccounted);
+    }
+
+    metrics_family(out, "sysprog_connections_total", "counter", "Client connections by outcome");
+    metrics_value(out, "sysprog_connections_total", "event=\"accepted\"", sum.accepted);
+    metrics_value(out, "sysprog_connections_total", "event=\"refused\"", sum.refused);
+    metrics_value(out, "sysprog_connections_total", "event=\"closed\"", sum.closed);
+    metrics_family(out, "sysprog_connections_active", "gauge", "Clients connected now");
+    metrics_value(out, "sysprog_connections_active", NULL,
+                  (uint64_t)atomic_load(&stats->activeClients));
+
+    metrics_family(out, "sysprog_bytes_total", "counter", "Bytes received from and sent to clients");
+    metrics_value(out, "sysprog_bytes_total", "direction=\"received\"", sum.bytesIn);
+    metrics_value(out, "sysprog_bytes_total", "direction=\"sent\"", sum.bytesOut);
+    metrics_family(out, "sysprog_frames_total", "counter", "Protocol frames received");
+    metrics_value(out, "sysprog_frames_total", NULL, sum.frames);
+    metrics_family(out, "sysprog_batches_total", "counter", "FRAME_BATCH frames processed");
+    metrics_value(out, "sysprog_batches_total", NULL, sum.batches);
+
+    metrics_family(out, "sysprog_bookings_total", "counter", "Bookings received since start, by result");
+    metrics_value(out, "sysprog_bookings_total", "result=\"accepted\"", sum.bookings);
+    metrics_value(out, "sysprog_bookings_total", "result=\"rejected\"", sum.rejected);
+    metrics_family(out, "sysprog_signals_total", "counter", "Control signals received");
+    metrics_value(out, "sysprog_signals_total", "signal=\"F1\"", sum.signalF1);
+    metrics_value(out, "sysprog_signals_total", "signal=\"F2\"", sum.signalF2);
+
+    stats_totals(&cents, &bookings);
+    metrics_family(out, "sysprog_revenue_cents", "gauge", "Revenue of every booking, recovered ones included");
+    metrics_value(out, "sysprog_revenue_cents", NULL, (uint64_t)cents);
+    metrics_family(out, "sysprog_booking_records", "gauge", "Bookings accounted, recovered ones included");
+    metrics_value(out, "sysprog_booking_records", NULL, (uint64_t)bookings);
+
+    metrics_histogram(out, "sysprog_booking_accounting_seconds",
+                      "Time from recv() to the booking being accounted", &sum.recvToAccounted);
+
+    //Lock histograms live in the catalog segment, written by shm_manager
+    if (metrics_catalog.hdr != NULL && catalog_refresh(&metrics_catalog) != -1) {
+        memset(&lockWait, 0, sizeof(lockWait));
+        memset(&lockHold, 0, sizeof(lockHold));
+        hist_merge(&lockWait, &metrics_catalog.hdr->lockWait);
+        hist_merge(&lockHold, &metrics_catalog.hdr->lockHold);
+        metrics_histogram(out, "sysprog_catalog_lock_wait_seconds",
+                          "Time catalog writers waited for the lock", &lockWait);
+        metrics_histogram(out, "sysprog_catalog_lock_hold_seconds",
+                          "Time catalog writers held the lock", &lockHold);
+    }
 }
@@ -4,37 +4,66 @@
 //PROGRAMMER         : Bibi Murwared Enayat Zada
 //FIRST VERSION      : 2025-11-14
 //DESCRIPTION        : This program manages the shared memory for Assignment 3.
-//                    It creates shared memory and a semaphore, allows reading
-//                    the stored trips, and destroys the shared memory using
-//                    the required rogue write.
+//                    It creates the catalog segment (POSIX shared memory that
+//                    grows as trips are added), allows reading, searching,
+//                    adding, updating and deleting the stored trips (freed
+//                    slots are reused), and destroys the shared memory using
+//                    the required rogue write. Every edit is saved to the
+//                    catalog file, which is restored on the next start if
+//                    the shared memory is gone.
+//                    shm_manager --import trips.csv replaces the whole
+//                    catalog from a CSV file without the menu (--force
+//                    lets a file with no valid trips empty it).
 //
 
 #include "ipc_shared.h"
+#include "catalog.h"
+#include "search.h"
 
 //Global variables
-int shmid = -1;
-int semid = -1;
-SharedMemory *shm = NULL;
+Catalog cat = { -1, NULL, 0, 0 };
+int catalog_known = 0;      //Segment created or found by this program
 
 //Function prototypes
 void display_menu();
 void create_shared_memory();
 void read_shared_memory();
+void search_shared_memory();
+void add_trips();
+void update_trip();
+void delete_trip();
+int open_catalog();
+void save_catalog();
+void restore_catalog();
+int import_catalog(const char *path, int force);
+int read_trip(Trip *trip, int keep);
+int find_trip_slot(Trip *trip);
 void kill_shared_memory();
 void cleanup();
 int validate_destination(char *dest);
 int ask_yes_no(const char *msg);
 
-int main(void) {
+int main(int argc, char *argv[]) {
     int choice;
 
+    if ((argc == 3 || (argc == 4 && strcmp(argv[3], "--force") == 0)) &&
+        strcmp(argv[1], "--import") == 0) {
+        return import_catalog(argv[2], argc == 4) == 0 ? 0 : 1;
+    }
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--import trips.csv [--force]]\n", argv[0]);
+        return 1;
+    }
+
     printf("=== Shared Memory Manager ===\n\n");
 
+    restore_catalog();
+
     while (1) {
         display_menu();
 
         if (scanf("%d", &choice) != 1) {
-            printf("Invalid input! Please enter 1-4.\n");
+            printf("Invalid input! Please enter 1-8.\n");
             while (getchar() != '\n');
             continue;
         }
@@ -48,14 +77,26 @@ int main(void) {
                 read_shared_memory();
                 break;
             case 3:
-                kill_shared_memory();
+                search_shared_memory();
                 break;
             case 4:
+                add_trips();
+                break;
+            case 5:
+                update_trip();
+                break;
+            case 6:
+                delete_trip();
+                break;
+            case 7:
+                kill_shared_memory();
+                break;
+            case 8:
                 cleanup();
                 printf("Exiting...\n");
                 exit(0);
             default:
-                printf("Invalid choice! Please select 1-4.\n");
+                printf("Invalid choice! Please select 1-8.\n");
         }
     }
 
@@ -72,238 +113,557 @@ void display_menu(void) {
     printf("\n=== Shared Memory Manager Menu ===\n");
     printf("1. Create shared memory\n");
     printf("2. Read shared memory\n");
-    printf("3. Kill shared memory with rogue write\n");
-    printf("4. Exit\n");
+    printf("3. Search trips\n");
+    printf("4. Add trips\n");
+    printf("5. Update trip\n");
+    printf("6. Delete trip\n");
+    printf("7. Kill shared memory with rogue write\n");
+    printf("8. Exit\n");
     printf("Enter choice: ");
 }
 
 //
 //FUNCTION     : create_shared_memory
-//DESCRIPTION  : Creates shared memory and semaphore, initializes trips
+//DESCRIPTION  : Creates shared memory and its catalog lock, initializes trips
 //PARAMETERS   : None
 //RETURNS      : Nothing
 //
 void create_shared_memory(void) {
-    if (shmid != -1) {
+    if (cat.hdr != NULL) {
         printf("Shared memory already exists!\n");
         return;
     }
 
-    //Create (or reuse) shared memory
-    shmid = shmget(SHM_KEY, sizeof(SharedMemory), PERMISSIONS | IPC_CREAT);
-    if (shmid == -1) {
-        perror("Unable to create shared memory");
+    //Create (or replace) the catalog segment; the lock lives in its header
+    if (catalog_create(&cat, CATALOG_SHM_NAME, CATALOG_INITIAL_CAPACITY) == -1) {
+        printf("Unable to create shared memory\n");
         return;
     }
+    catalog_known = 1;
+
+    printf("Shared memory and catalog lock created successfully.\n");
+
+    //Ask to add trips (each one is saved to the catalog file)
+    if (ask_yes_no("\nWould you like to add trips now")) {
+        add_trips();
+    } else {
+        save_catalog();
+    }
+    catalog_close(&cat);
+}
 
-    //Attach shared memory
-    shm = (SharedMemory *)shmat(shmid, NULL, 0);
-    if (shm == (void *)-1) {
-        perror("Failed to attach shared memory");
-        shmctl(shmid, IPC_RMID, NULL);
-        shmid = -1;
-        shm = NULL;
+//
+//FUNCTION     : restore_catalog
+//DESCRIPTION  : Recreates the shared memory from the catalog file when the
+//              segment is gone (after a reboot or the rogue write)
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void restore_catalog(void) {
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == 0) {
+        catalog_close(&cat);
         return;
     }
 
-    //Create semaphore or get existing one
-    semid = create_semaphore(SEM_KEY);
-    if (semid == -1) {
-        if (errno == EEXIST) {
-            //Existsing semaphore, try to get it
-            semid = get_semaphore(SEM_KEY);
-            if (semid == -1) {
-                shmdt(shm);
-                shmctl(shmid, IPC_RMID, NULL);
-                shmid = -1;
-                shm = NULL;
-                printf("Failed to get existing semaphore\n");
-                return;
+    uint64_t start = monotonic_ns();
+    if (catalog_restore(&cat, CATALOG_SHM_NAME, CATALOG_FILE) == -1) {
+        if (errno != ENOENT) {
+            printf("Unable to restore the catalog from %s.\n", CATALOG_FILE);
+        }
+        return;
+    }
+    catalog_known = 1;
+    printf("Catalog restored from %s: %u trips in %.2f ms.\n", CATALOG_FILE,
+           cat.hdr->liveCount, (monotonic_ns() - start) / 1e6);
+    catalog_close(&cat);
+}
+
+//
+//FUNCTION     : import_catalog
+//DESCRIPTION  : Replaces the catalog with the trips in a CSV file
+//              (destination,price[,seats] per line). The file is parsed
+//              first, then the new catalog is built in a staging segment
+//              no one else sees, in one write section, and published with
+//              catalog_publish. Readers keep using the old catalog until
+//              the swap and never see a half-loaded one. Rows with a bad
+//              destination or price, and repeated destinations, are
+//              skipped. A file with no valid rows (a header only, or the
+//              wrong file) is refused rather than publishing an empty
+//              catalog, unless forced.
+//PARAMETERS   : const char *path - CSV file
+//              int force - publish even if no trip is valid
+//RETURNS      : int - 0 on success, -1 on error
+//
+int import_catalog(const char *path, int force) {
+    FILE *fp = fopen(path, "r");
+    char line[256];
+    Trip *rows = NULL;
+    uint32_t count = 0, cap = 0, skipped = 0, lineNo = 0;
+
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    //Parse off-line
+    uint64_t start = monotonic_ns();
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        Trip trip;
+
+        lineNo++;
+        if (!parse_trip_csv(line, &trip) || !validate_destination(trip.destination)) {
+            if (lineNo > 1) {
+                skipped++;      //The first line may be a header
             }
+            continue;
+        }
+        if (count == cap) {
+            uint32_t newCap = cap ? cap * 2 : 1024;
+            Trip *grown = realloc(rows, (size_t)newCap * sizeof(Trip));
+            if (grown == NULL) {
+                perror("realloc");
+                free(rows);
+                fclose(fp);
+                return -1;
+            }
+            rows = grown;
+            cap = newCap;
+        }
+        rows[count++] = trip;
+    }
+    fclose(fp);
+    uint64_t parsed = monotonic_ns();
+
+    if (count == 0 && !force) {
+        printf("No valid trips in %s (%u rows skipped); the catalog was not replaced.\n"
+               "Use --import %s --force to empty it.\n", path, skipped, path);
+        free(rows);
+        return -1;
+    }
+
+    //Build the staged catalog at its final size
+    Catalog staged = { -1, NULL, 0, 0 };
+    catalog_remove(CATALOG_STAGING_NAME);
+    if (catalog_create(&staged, CATALOG_STAGING_NAME, count) == -1) {
+        printf("Unable to create the staging catalog!\n");
+        free(rows);
+        return -1;
+    }
+
+    uint32_t added = 0;
+    int failed = 0;
+    unsigned int version = catalog_write_begin(&staged);
+    for (uint32_t i = 0; i < count && !failed; i++) {
+        if (catalog_lookup(&staged, rows[i].destination) != -1) {
+            skipped++;
+        } else if (catalog_insert(&staged, &rows[i], version) == -1) {
+            failed = 1;
         } else {
-            //Erro real
-            shmdt(shm);
-            shmctl(shmid, IPC_RMID, NULL);
-            shmid = -1;
-            shm = NULL;
-            printf("Failed to create semaphore\n");
-            return;
+            added++;
         }
     }
+    catalog_write_end(&staged);
+    free(rows);
+    if (failed) {
+        printf("Unable to build the imported catalog!\n");
+        catalog_close(&staged);
+        catalog_remove(CATALOG_STAGING_NAME);
+        return -1;
+    }
+    uint64_t built = monotonic_ns();
 
-    //Initialize trips
-    sem_lock(semid);
-    shm->tripCount = 0;
-    for (int i = 0; i < MAX_TRIPS; i++) {
-        shm->trips[i].active = 0;
+    if (catalog_publish(&staged, CATALOG_STAGING_NAME, CATALOG_SHM_NAME) == -1) {
+        printf("Unable to publish the imported catalog!\n");
+        catalog_close(&staged);
+        catalog_remove(CATALOG_STAGING_NAME);
+        return -1;
     }
-    sem_unlock(semid);
+    uint64_t published = monotonic_ns();
+
+    cat = staged;
+    save_catalog();
+    printf("Imported %u trips from %s (%u rows skipped): parse %.2f ms, "
+           "build %.2f ms, publish %.3f ms.\n", added, path, skipped,
+           (parsed - start) / 1e6, (built - parsed) / 1e6, (published - built) / 1e6);
+    catalog_close(&cat);
+    return 0;
+}
 
-    printf("Shared memory and semaphore created successfully.\n");
+//
+//FUNCTION     : save_catalog
+//DESCRIPTION  : Writes the catalog to its file after an edit
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void save_catalog(void) {
+    if (catalog_save(&cat, CATALOG_FILE) == -1) {
+        printf("Unable to save the catalog to %s!\n", CATALOG_FILE);
+    }
+}
 
-    //Ask to add trips
-    if (!ask_yes_no("\nWould you like to add trips now")) {
-        shmdt(shm);
-        return;
+//
+//FUNCTION     : open_catalog
+//DESCRIPTION  : Attaches to the catalog unless this program already is
+//PARAMETERS   : None
+//RETURNS      : int - 1 if it was opened here (close it when done),
+//              0 if it was already open, -1 if there is no catalog
+//
+int open_catalog(void) {
+    if (cat.hdr != NULL) {
+        return 0;
     }
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
+        printf("Unable to connect to shared memory.\n");
+        return -1;
+    }
+    catalog_known = 1;
+    return 1;
+}
 
-    while (1) {
-        if (shm->tripCount >= MAX_TRIPS) {
-            printf("Maximum trips reached!\n");
-            break;
+//
+//FUNCTION     : read_trip
+//DESCRIPTION  : Prompts for a destination, a price and a seat count
+//PARAMETERS   : Trip *trip - receives them
+//              int keep - 1 to keep the current value on an empty answer
+//RETURNS      : int - 1 if all are valid, 0 otherwise
+//
+int read_trip(Trip *trip, int keep) {
+    char input[MAX_NAME];
+
+    if (keep) {
+        printf("Enter destination (Enter to keep %s): ", trip->destination);
+    } else {
+        printf("\nEnter destination: ");
+    }
+    if (fgets(input, MAX_NAME, stdin) == NULL) {
+        return 0;
+    }
+    input[strcspn(input, "\n")] = '\0';
+    if (!keep || input[0] != '\0') {
+        if (!validate_destination(input)) {
+            printf("Invalid destination!\n");
+            return 0;
+        }
+        strcpy(trip->destination, input);
+    }
+
+    if (keep) {
+        printf("Enter price (Enter to keep $%.2f): ", trip->priceCents / 100.0);
+    } else {
+        printf("Enter price: ");
+    }
+    if (fgets(input, MAX_NAME, stdin) == NULL) {
+        return 0;
+    }
+    if (!keep || input[0] != '\n') {
+        if (!parse_cents(input, &trip->priceCents) || trip->priceCents <= 0) {
+            printf("Invalid price!\n");
+            return 0;
+        }
+    }
+
+    if (keep) {
+        printf("Enter seats, 0 = unlimited (Enter to keep %d): ", trip->seats);
+    } else {
+        printf("Enter seats (0 = unlimited): ");
+    }
+    if (fgets(input, MAX_NAME, stdin) == NULL) {
+        return 0;
+    }
+    if (!keep || input[0] != '\n') {
+        if (sscanf(input, "%d", &trip->seats) != 1 || trip->seats < 0) {
+            printf("Invalid seat count!\n");
+            return 0;
         }
+    }
+    return 1;
+}
+
+//
+//FUNCTION     : find_trip_slot
+//DESCRIPTION  : Prompts for a destination and looks it up in the catalog
+//PARAMETERS   : Trip *trip - receives the trip
+//RETURNS      : int - 0-based slot, -1 if there is no such trip
+//
+int find_trip_slot(Trip *trip) {
+    char input[MAX_NAME];
+
+    printf("\nEnter destination: ");
+    if (fgets(input, MAX_NAME, stdin) == NULL) {
+        return -1;
+    }
+    input[strcspn(input, "\n")] = '\0';
+
+    int slot = catalog_find_trip(&cat, input, trip);
+    if (slot == 0) {
+        printf("Trip not found!\n");
+        return -1;
+    }
+    return slot - 1;
+}
 
+//
+//FUNCTION     : add_trips
+//DESCRIPTION  : Adds trips until the user stops. Each insert reuses a
+//              deleted slot if there is one.
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void add_trips(void) {
+    int opened = open_catalog();
+    if (opened == -1) {
+        return;
+    }
+
+    while (1) {
         Trip newTrip;
         memset(&newTrip, 0, sizeof(Trip));
 
-        printf("\nEnter destination: ");
-        fgets(newTrip.destination, MAX_NAME, stdin);
-        newTrip.destination[strcspn(newTrip.destination, "\n")] = '\0';
-
-        if (!validate_destination(newTrip.destination)) {
-            printf("Invalid destination!\n");
+        if (!read_trip(&newTrip, 0)) {
             continue;
         }
 
-        printf("Enter price: ");
-        if (scanf("%f", &newTrip.price) != 1 || newTrip.price <= 0) {
-            printf("Invalid price!\n");
-            while (getchar() != '\n'); //clear buffer
+        Trip existing;
+        if (catalog_find_trip(&cat, newTrip.destination, &existing) > 0) {
+            printf("Destination already exists!\n");
             continue;
         }
-        while (getchar() != '\n'); //clear buffer
 
-        sem_lock(semid);
-        int idx = shm->tripCount;
-        shm->trips[idx] = newTrip;
-        shm->trips[idx].active = 1;
-        shm->tripCount++;
-        sem_unlock(semid);
+        //The segment doubles when it is full
+        unsigned int version = catalog_write_begin(&cat);
+        int idx = catalog_insert(&cat, &newTrip, version);
+        catalog_write_end(&cat);
+
+        if (idx == -1) {
+            printf("Unable to grow the catalog!\n");
+            break;
+        }
+        printf("Trip added in slot %d.\n", idx + 1);
+        save_catalog();
 
         if (!ask_yes_no("Add another trip")) {
             break;
         }
     }
 
-    shmdt(shm);
+    if (opened) {
+        catalog_close(&cat);
+    }
 }
 
-
 //
-//FUNCTION     : read_shared_memory
-//DESCRIPTION  : Displays all trips in shared memory
+//FUNCTION     : update_trip
+//DESCRIPTION  : Changes the destination, price and/or seats of a trip.
+//              Seats already sold stay sold.
 //PARAMETERS   : None
 //RETURNS      : Nothing
 //
-void read_shared_memory(void) {
-    shmid = shmget(SHM_KEY, sizeof(SharedMemory), PERMISSIONS);
-    if (shmid == -1) {
-        printf("Unable to connect to shared memory.\n");
+void update_trip(void) {
+    Trip trip, existing;
+
+    if (open_catalog() == -1) {
         return;
     }
 
-    semid = get_semaphore(SEM_KEY);
-    if (semid == -1) {
-        printf("Unable to connect to semaphore.\n");
+    int slot = find_trip_slot(&trip);
+    if (slot != -1 && read_trip(&trip, 1)) {
+        int taken = catalog_find_trip(&cat, trip.destination, &existing);
+        if (taken != 0 && taken != slot + 1) {
+            printf("Destination already exists!\n");
+        } else {
+            unsigned int version = catalog_write_begin(&cat);
+            int rc = catalog_update(&cat, (uint32_t)slot, &trip, version);
+            catalog_write_end(&cat);
+            printf(rc == 0 ? "Trip updated.\n" : "Trip was deleted meanwhile!\n");
+            save_catalog();
+        }
+    }
+
+    catalog_close(&cat);
+}
+
+//
+//FUNCTION     : delete_trip
+//DESCRIPTION  : Deletes a trip; its slot is reused by the next insert
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void delete_trip(void) {
+    Trip trip;
+
+    if (open_catalog() == -1) {
         return;
     }
 
-    shm = (SharedMemory *)shmat(shmid, NULL, 0);
-    if (shm == (void *)-1) {
-        printf("Unable to attach to shared memory.\n");
+    int slot = find_trip_slot(&trip);
+    if (slot != -1) {
+        unsigned int version = catalog_write_begin(&cat);
+        int rc = catalog_delete(&cat, (uint32_t)slot, version);
+        catalog_write_end(&cat);
+        printf(rc == 0 ? "Trip deleted.\n" : "Trip was deleted meanwhile!\n");
+        save_catalog();
+    }
+
+    catalog_close(&cat);
+}
+
+
+//
+//FUNCTION     : read_shared_memory
+//DESCRIPTION  : Displays the live trips in shared memory
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void read_shared_memory(void) {
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
+        printf("Unable to connect to shared memory.\n");
         return;
     }
+    catalog_known = 1;
 
-    sem_lock(semid);
+    //Copy the live trips without locking, then print the copy
+    TripMatch *trips = NULL;
+    uint32_t bufCap = 0, tripCount = 0;
+    catalog_snapshot(&cat, &trips, &bufCap, &tripCount);
 
     printf("\n=== Available Trips ===\n");
-    printf("Total trips: %d\n", shm->tripCount);
+    printf("Total trips: %u (%u slots, capacity %u)\n", tripCount,
+           cat.hdr->tripCount, cat.hdr->capacity);
 
-    if (shm->tripCount == 0) {
+    if (tripCount == 0) {
         printf("No trips available.\n");
     } else {
-        for (int i = 0; i < shm->tripCount; i++) {
-            if (shm->trips[i].active) {
-                printf("%d. %s - $%.2f\n", i + 1,
-                       shm->trips[i].destination,
-                       shm->trips[i].price);
+        for (uint32_t i = 0; i < tripCount; i++) {
+            printf("%u. %s - $%.2f", trips[i].slot + 1,
+                   trips[i].trip.destination,
+                   trips[i].trip.priceCents / 100.0);
+            if (trips[i].trip.seats > 0) {
+                printf(" (%u/%d seats left)", (uint32_t)trips[i].trip.inventory,
+                       trips[i].trip.seats);
             }
+            printf("\n");
         }
     }
 
-    sem_unlock(semid);
-    shmdt(shm);
-    shm = NULL;
+    //Summary straight from the price column (SIMD scan)
+    int32_t minCents, maxCents;
+    uint32_t active = catalog_price_range(&cat, &minCents, &maxCents);
+    printf("Active trips: %u | Cheapest: $%.2f | Most expensive: $%.2f\n",
+           active, minCents / 100.0, maxCents / 100.0);
+
+    free(trips);
+    catalog_close(&cat);
 }
 
 //
-//FUNCTION     : kill_shared_memory
-//DESCRIPTION  : Performs rogue write and deletes shared memory
+//FUNCTION     : search_shared_memory
+//DESCRIPTION  : Searches the trips by destination prefix, by price range
+//              or for the cheapest ones, using the catalog's sorted orders
 //PARAMETERS   : None
 //RETURNS      : Nothing
 //
-void kill_shared_memory(void) {
-    if (shmid == -1) {
-        shmid = shmget(SHM_KEY, sizeof(SharedMemory), PERMISSIONS);
-        if (shmid == -1) {
-            printf("Shared memory not found!\n");
-            return;
-        }
+void search_shared_memory(void) {
+    char input[MAX_NAME];
+    TripMatch matches[SEARCH_RESULTS];
+    unsigned int version;
+    uint32_t total;
+    int64_t lo, hi;
+    char *dash;
+
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
+        printf("Unable to connect to shared memory.\n");
+        return;
     }
+    catalog_known = 1;
 
-    shm = (SharedMemory *)shmat(shmid, NULL, 0);
-    if (shm == (void *)-1) {
-        printf("Unable to attach to shared memory.\n");
+    printf("\nSearch by destination prefix, by price as min-max,\n");
+    printf("or press Enter for the %d cheapest: ", SEARCH_RESULTS);
+    if (fgets(input, sizeof(input), stdin) == NULL) {
+        catalog_close(&cat);
         return;
     }
+    input[strcspn(input, "\n")] = '\0';
+
+    //Destinations are letters and spaces, so a '-' means a price range
+    dash = strchr(input, '-');
+    if (input[0] == '\0') {
+        total = search_cheapest(&cat, SEARCH_RESULTS, matches, &version);
+    } else if (dash != NULL) {
+        *dash = '\0';
+        if (!parse_cents(input, &lo) || !parse_cents(dash + 1, &hi) || hi > INT32_MAX) {
+            printf("Use min-max, e.g. 100-500!\n");
+            catalog_close(&cat);
+            return;
+        }
+        total = search_price_range(&cat, (int32_t)lo, (int32_t)hi,
+                                   matches, SEARCH_RESULTS, &version);
+    } else {
+        total = search_prefix(&cat, input, matches, SEARCH_RESULTS, &version);
+    }
 
-    if (semid == -1) {
-        semid = get_semaphore(SEM_KEY);
+    printf("\n=== Search Results ===\n");
+    printf("Matches: %u (catalog version %u)\n", total, version);
+    for (uint32_t i = 0; i < total && i < SEARCH_RESULTS; i++) {
+        printf("%u. %s - $%.2f", matches[i].slot + 1,
+               matches[i].trip.destination,
+               matches[i].trip.priceCents / 100.0);
+        if (matches[i].trip.seats > 0) {
+            printf(" (%u/%d seats left)", (uint32_t)matches[i].trip.inventory,
+                   matches[i].trip.seats);
+        }
+        printf("\n");
+    }
+    if (total > SEARCH_RESULTS) {
+        printf("... %u more\n", total - SEARCH_RESULTS);
     }
 
-    if (semid != -1) {
-        sem_lock(semid);
+    catalog_close(&cat);
+}
+
+//
+//FUNCTION     : kill_shared_memory
+//DESCRIPTION  : Performs rogue write and deletes shared memory
+//PARAMETERS   : None
+//RETURNS      : Nothing
+//
+void kill_shared_memory(void) {
+    if (catalog_open(&cat, CATALOG_SHM_NAME) == -1) {
+        printf("Shared memory not found!\n");
+        return;
     }
+    catalog_known = 1;
+
+    catalog_write_lock(&cat);
 
     printf("\nAttempting rogue write to kill shared memory...\n");
 
     //Attempt to write to out-of-range memory address
-    char *rogue_ptr = (char *)shm + sizeof(SharedMemory) + 1000;
+    char *rogue_ptr = (char *)cat.hdr + cat.mapSize + 1000;
     printf("Writing to address: %p (out of bounds)\n", (void *)rogue_ptr);
 
     *rogue_ptr = 'X';
 
-    if (semid != -1) {
-        sem_unlock(semid);
-    }
+    catalog_unlock(&cat);
 
     printf("Rogue write completed.\n");
 
-    shmdt(shm);
     cleanup();
-    shmid = -1;
-    shm = NULL;
-    semid = -1;
+    catalog_known = 0;
 }
 
 //
 //FUNCTION     : cleanup
-//DESCRIPTION  : Removes shared memory and semaphore
+//DESCRIPTION  : Removes shared memory (and the catalog lock inside it)
 //PARAMETERS   : None
 //RETURNS      : Nothing
 //
 void cleanup(void) {
-    if (shm != NULL) {
-        shmdt(shm);
+    if (cat.hdr != NULL) {
+        catalog_close(&cat);
     }
-    if (shmid != -1) {
-        shmctl(shmid, IPC_RMID, NULL);
+    if (catalog_known && catalog_remove(CATALOG_SHM_NAME) == 0) {
         printf("Shared memory removed.\n");
     }
-    if (semid != -1) {
-        remove_semaphore(semid);
-        printf("Semaphore removed.\n");
-    }
 }
 
 //